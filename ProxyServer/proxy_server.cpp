@@ -16,7 +16,7 @@ ProxyServer::ProxyServer(const std::string& masterServerHost, int masterServerPo
     setupForwarding();
 
     // 定义读请求路径
-    readPaths_ = {"/search"};
+    readPaths_ = {"/search", "/rangeSearch"};
 
     // 定义写请求路径
     writePaths_ = {"/upsert"};
@@ -74,6 +74,12 @@ void ProxyServer::setupForwarding() {
         forwardRequest(req, res, "/search");
     });
 
+    // 对 /rangeSearch 路径的POST请求进行转发
+    httpServer_.Post("/rangeSearch", [this](const httplib::Request& req, httplib::Response& res) {
+        GlobalLogger->info("Forwarding POST /rangeSearch");
+        forwardRequest(req, res, "/rangeSearch");
+    });
+
     // 添加新路由以返回拓扑信息
     httpServer_.Get("/topology", [this](const httplib::Request&, httplib::Response& res) {
         this->handleTopologyRequest(res);
@@ -104,17 +110,20 @@ void ProxyServer::forwardRequest(const httplib::Request& req, httplib::Response&
 }
 
 void ProxyServer::broadcastRequestToAllPartitions(const httplib::Request& req, httplib::Response& res, const std::string& path) {
-    // 解析请求以获取 k 的值
+    // 解析请求以获取 k 的值，范围检索使用 maxResults（默认 1000）作为合并后的结果数上限
     rapidjson::Document doc;
     doc.Parse(req.body.c_str());
-    if (doc.HasParseError() || !doc.HasMember("k") || !doc["k"].IsInt()) {
+    int k = 0;
+    if (path == "/rangeSearch" && !doc.HasParseError() && doc.IsObject()) {
+        k = (doc.HasMember("maxResults") && doc["maxResults"].IsInt()) ? doc["maxResults"].GetInt() : 1000;
+    } else if (doc.HasParseError() || !doc.HasMember("k") || !doc["k"].IsInt()) {
         res.status = 400;
         res.set_content("Invalid request: missing or invalid 'k'", "text/plain");
         return;
+    } else {
+        k = doc["k"].GetInt();
     }
 
-    int k = doc["k"].GetInt();
-
     int activePartitionIndex = activePartitionIndex_.load();
     const auto& partitionConfig = nodePartitions_[activePartitionIndex];
     std::vector<std::future<httplib::Response>> futures;
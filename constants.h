@@ -9,16 +9,59 @@
 #define REQUEST_K "k"
 #define REQUEST_ID "id"
 #define REQUEST_INDEX_TYPE "indexType"
+#define REQUEST_NPROBE "nprobe" // IVF 类索引的检索参数
+#define REQUEST_SEARCH_LIST "searchList" // DISK_GRAPH 索引的候选列表长度
+#define REQUEST_BEAM_WIDTH "beamWidth" // DISK_GRAPH 索引每轮读取的节点数
+#define REQUEST_REORDER_STRATEGY "strategy" // 图重排策略：BFS 或 RCM
+#define REQUEST_RERANK "rerank" // 重排倍数，先取 k * rerank 个候选再用原始向量精确重排
+#define REQUEST_FILTER_MODE "filterMode" // HNSW 过滤检索方式，"acorn" 表示对选择性很高的过滤条件使用两跳遍历
+#define REQUEST_EF "ef" // HNSW 类索引本次检索的 ef
+#define REQUEST_RECALL_TARGET "recallTarget" // 目标召回率，按校准得到的 ef-召回率曲线选择 ef
+#define REQUEST_SAMPLES "samples" // 校准时抽样的查询数
+#define REQUEST_EF_VALUES "efValues" // 校准时测量的 ef 列表
+#define REQUEST_ADAPTIVE "adaptive" // 使用校准时学习到的耐心值提前终止 HNSW 检索
+#define REQUEST_MAX_DISTANCE_COMPUTATIONS "maxDistanceComputations" // HNSW 检索每个查询的距离计算次数上限
+#define REQUEST_RADIUS "radius" // 范围检索的距离阈值，与检索结果中距离的含义相同
+#define REQUEST_MAX_RESULTS "maxResults" // 范围检索最多返回的向量数
+#define REQUEST_MAX_SIM "maxSim" // MULTI_VECTOR 索引的延迟交互检索，vectors 为一个查询的所有 token 向量
+#define REQUEST_CANDIDATES "candidates" // 延迟交互检索时每个查询 token 取的候选文档数，多字段检索时每个字段取的候选数
+#define REQUEST_FIELD "field" // 检索的具名向量字段
+#define REQUEST_FIELDS "fields" // 多检索器检索，名称到 {vectors, weight, indexType} 的对象，名称为具名向量字段或用 indexType 指定索引
+#define REQUEST_WEIGHT "weight"
+#define REQUEST_FUSION "fusion" // 多个检索器的融合方式：weighted（默认）或 rrf
+#define REQUEST_RRF_K "rrfK" // 倒数排名融合的平滑常数，默认 60
+#define REQUEST_INDICES "indices" // 稀疏向量的维度
+#define REQUEST_VALUES "values" // 稀疏向量的权重
 
 #define RESPONSE_RETCODE "retCode" // 添加宏定义
 #define RESPONSE_RETCODE_SUCCESS 0
 #define RESPONSE_RETCODE_ERROR -1
 
 #define RESPONSE_ERROR_MSG "errorMsg" // 添加宏定义
+#define RESPONSE_CURVE "curve" // ef-召回率曲线
+#define RESPONSE_EF "ef"
+#define RESPONSE_RECALL "recall"
+#define RESPONSE_PATIENCE "patience"
+#define RESPONSE_STATS "stats" // 每个查询的终止统计
+#define RESPONSE_HOPS "hops"
+#define RESPONSE_DISTANCE_COMPUTATIONS "distanceComputations"
+#define RESPONSE_TERMINATION "termination" // 终止原因：converged、patience 或 budget
 
 #define RESPONSE_CONTENT_TYPE_JSON "application/json"
 
 #define INDEX_TYPE_FLAT "FLAT" // 添加宏定义
 #define INDEX_TYPE_HNSW "HNSW" // 添加宏定义
+#define INDEX_TYPE_FAISS_FACTORY "FAISS_FACTORY" // 添加宏定义
+#define INDEX_TYPE_DISK_GRAPH "DISK_GRAPH" // 添加宏定义
+#define INDEX_TYPE_SHARDED_HNSW "SHARDED_HNSW"
+#define INDEX_TYPE_MULTI_VECTOR "MULTI_VECTOR" // 一个文档 ID 下保存多个向量，检索返回不同的文档
+#define INDEX_TYPE_SPARSE "SPARSE" // 稀疏向量倒排索引，只能用于具名向量字段
+
+#define FUSION_RRF "rrf"
+
+#define DATA_TYPE_FLOAT32 "FLOAT32" // 向量存储精度
+#define DATA_TYPE_FLOAT16 "FLOAT16"
+#define DATA_TYPE_BFLOAT16 "BFLOAT16"
+#define DATA_TYPE_BINARY "BINARY"
 
 // 其他字符串常量...
\ No newline at end of file
@@ -0,0 +1,764 @@
+#include "disk_graph_index.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    const uint64_t DISK_GRAPH_MAGIC = 0x5844474b53494456ULL; // "VDISKGDX"
+    const uint32_t DISK_GRAPH_VERSION = 1;
+    const uint64_t SNAPSHOT_MAGIC = 0x50414e5347444456ULL;
+    const size_t PQ_NBITS = 8;
+    const size_t PQ_MAX_TRAIN = 100000; // PQ 训练最多使用的样本数
+
+    void preadAll(int fd, void* buf, size_t size, uint64_t offset) {
+        char* p = static_cast<char*>(buf);
+        while (size > 0) {
+            ssize_t n = pread(fd, p, size, offset);
+            if (n <= 0) {
+                throw std::runtime_error("Failed to read disk graph file");
+            }
+            p += n;
+            size -= n;
+            offset += n;
+        }
+    }
+
+    // 选择 PQ 子空间数：每个子空间约 4 维，且必须整除维度
+    size_t choosePQM(size_t dim) {
+        size_t m = std::max<size_t>(1, dim / 4);
+        while (dim % m != 0) {
+            --m;
+        }
+        return m;
+    }
+
+    struct FreeDeleter {
+        void operator()(void* p) const { free(p); }
+    };
+
+    // beam 中各节点扇区的一次并行读取，调用线程和线程池中的线程按下标领取节点
+    struct BeamRead {
+        int fd;
+        char* bufs;
+        size_t read_size;
+        const std::vector<uint64_t>* offsets;
+        std::atomic<size_t> next{0};
+        size_t helpers = 0; // 尚未结束的线程池任务数，由 mutex 保护
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+
+        void run() {
+            size_t i;
+            while ((i = next.fetch_add(1)) < offsets->size()) {
+                try {
+                    preadAll(fd, bufs + i * read_size, read_size, (*offsets)[i]);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+    };
+
+    // 所有检索共享的读线程池，使 beam 内的多个扇区读取同时在盘上排队
+    class BeamReadPool {
+    public:
+        static BeamReadPool& instance() {
+            static BeamReadPool pool;
+            return pool;
+        }
+
+        // 并行读取 offsets 处的扇区到 bufs，全部读完后返回，读取失败时抛出异常
+        void read(int fd, char* bufs, size_t read_size, const std::vector<uint64_t>& offsets) {
+            BeamRead batch;
+            batch.fd = fd;
+            batch.bufs = bufs;
+            batch.read_size = read_size;
+            batch.offsets = &offsets;
+            batch.helpers = std::min(offsets.size() - 1, workers.size());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < batch.helpers; ++i) {
+                    queue.push_back(&batch);
+                }
+            }
+            if (batch.helpers == 1) {
+                cv.notify_one();
+            } else if (batch.helpers > 1) {
+                cv.notify_all();
+            }
+            batch.run();
+
+            // batch 位于调用栈上，必须等所有领取过它的线程退出后才能返回
+            std::unique_lock<std::mutex> lock(batch.mutex);
+            batch.done.wait(lock, [&] { return batch.helpers == 0; });
+            if (batch.error) {
+                std::rethrow_exception(batch.error);
+            }
+        }
+
+        ~BeamReadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+    private:
+        BeamReadPool() {
+            size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < num_threads; ++i) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        void work() {
+            while (true) {
+                BeamRead* batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return stop || !queue.empty(); });
+                    if (queue.empty()) {
+                        return;
+                    }
+                    batch = queue.front();
+                    queue.pop_front();
+                }
+                batch->run();
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (--batch->helpers == 0) {
+                    batch->done.notify_one();
+                }
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<BeamRead*> queue;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop = false;
+    };
+
+    // 构建图时使用的空间：节点为 PQ 编码，距离为两个编码对应中心之间的对称距离（SDC），
+    // 构建期间内存中只保存 PQ 编码和图结构，不保存原始向量
+    class PQSymmetricSpace : public hnswlib::SpaceInterface<float> {
+    public:
+        PQSymmetricSpace(const faiss::ProductQuantizer& pq, IndexFactory::MetricType metric) {
+            param.M = pq.M;
+            param.ksub = pq.ksub;
+            code_size = pq.code_size;
+            table.resize(pq.M * pq.ksub * pq.ksub);
+            for (size_t m = 0; m < pq.M; ++m) {
+                for (size_t i = 0; i < pq.ksub; ++i) {
+                    const float* a = pq.centroids.data() + (m * pq.ksub + i) * pq.dsub;
+                    for (size_t j = 0; j < pq.ksub; ++j) {
+                        const float* b = pq.centroids.data() + (m * pq.ksub + j) * pq.dsub;
+                        float d = 0;
+                        for (size_t t = 0; t < pq.dsub; ++t) {
+                            d += metric == IndexFactory::MetricType::L2 ? (a[t] - b[t]) * (a[t] - b[t]) : -a[t] * b[t];
+                        }
+                        table[(m * pq.ksub + i) * pq.ksub + j] = d;
+                    }
+                }
+            }
+            param.table = table.data();
+        }
+
+        size_t get_data_size() override { return code_size; }
+        hnswlib::DISTFUNC<float> get_dist_func() override { return distance; }
+        void* get_dist_func_param() override { return &param; }
+
+    private:
+        struct Param {
+            size_t M;
+            size_t ksub;
+            const float* table;
+        };
+
+        static float distance(const void* a, const void* b, const void* param_ptr) {
+            const Param* p = static_cast<const Param*>(param_ptr);
+            const uint8_t* ca = static_cast<const uint8_t*>(a);
+            const uint8_t* cb = static_cast<const uint8_t*>(b);
+            float d = 0;
+            for (size_t m = 0; m < p->M; ++m) {
+                d += p->table[(m * p->ksub + ca[m]) * p->ksub + cb[m]];
+            }
+            return d;
+        }
+
+        Param param;
+        size_t code_size;
+        std::vector<float> table;
+    };
+}
+
+DiskGraphIndex::DiskGraphIndex(int dim, IndexFactory::MetricType metric, const std::string& disk_path, int max_degree, int ef_construction)
+    : dim(dim), metric(metric), disk_path(disk_path), max_degree(max_degree), ef_construction(ef_construction), fd(-1) {
+    if (metric == IndexFactory::MetricType::L2) {
+        space = new hnswlib::L2Space(dim);
+    } else {
+        space = new hnswlib::InnerProductSpace(dim);
+    }
+    dist_func = space->get_dist_func();
+    dist_func_param = space->get_dist_func_param();
+    memset(&header, 0, sizeof(header));
+
+    std::lock_guard<std::mutex> build_lock(build_mutex);
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    openDiskFile();
+}
+
+DiskGraphIndex::~DiskGraphIndex() {
+    closeDiskFile();
+    delete space;
+}
+
+void DiskGraphIndex::openDiskFile() {
+    closeDiskFile();
+    fd = open(disk_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        GlobalLogger->info("Disk graph file {} not found, waiting for build", disk_path);
+        return;
+    }
+
+    preadAll(fd, &header, sizeof(header), 0);
+    if (header.magic != DISK_GRAPH_MAGIC || header.version != DISK_GRAPH_VERSION) {
+        closeDiskFile();
+        throw std::runtime_error("Invalid disk graph file: " + disk_path);
+    }
+    if (header.dim != static_cast<uint32_t>(dim)) {
+        closeDiskFile();
+        throw std::runtime_error("Disk graph dimension mismatch: " + disk_path);
+    }
+
+    // 标签、PQ 码本和 PQ 编码常驻内存，原始向量和邻接表留在磁盘上
+    uint64_t n = header.num_nodes;
+    uint64_t offset = header.tail_offset;
+    labels.resize(n);
+    preadAll(fd, labels.data(), n * sizeof(uint64_t), offset);
+    offset += n * sizeof(uint64_t);
+
+    pq = faiss::ProductQuantizer(dim, header.pq_m, header.pq_nbits);
+    preadAll(fd, pq.centroids.data(), pq.centroids.size() * sizeof(float), offset);
+    offset += pq.centroids.size() * sizeof(float);
+
+    pq_codes.resize(n * pq.code_size);
+    preadAll(fd, pq_codes.data(), pq_codes.size(), offset);
+
+    label_to_node.clear();
+    for (uint64_t i = 0; i < n; ++i) {
+        label_to_node[labels[i]] = i;
+    }
+    GlobalLogger->info("Disk graph opened: {} nodes, {} bytes per node, pq_m {}", n, header.node_size, header.pq_m);
+}
+
+void DiskGraphIndex::closeDiskFile() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    memset(&header, 0, sizeof(header));
+    labels.clear();
+    label_to_node.clear();
+    pq_codes.clear();
+}
+
+uint64_t DiskGraphIndex::nodeOffset(uint64_t node) const {
+    uint64_t sector = header.nodes_per_sector > 0 ? node / header.nodes_per_sector : node * header.sectors_per_node;
+    return (1 + sector) * SECTOR_SIZE;
+}
+
+size_t DiskGraphIndex::nodeReadSize() const {
+    return header.sectors_per_node * SECTOR_SIZE;
+}
+
+const char* DiskGraphIndex::nodeInSector(const char* sector_buf, uint64_t node) const {
+    if (header.nodes_per_sector > 0) {
+        return sector_buf + (node % header.nodes_per_sector) * header.node_size;
+    }
+    return sector_buf;
+}
+
+void DiskGraphIndex::readNodeVector(uint64_t node, float* vec) const {
+    std::vector<char> buf(nodeReadSize());
+    preadAll(fd, buf.data(), buf.size(), nodeOffset(node));
+    memcpy(vec, nodeInSector(buf.data(), node), dim * sizeof(float));
+}
+
+void DiskGraphIndex::insert_vectors(const std::vector<float>& data, uint64_t label) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    ++write_seq;
+    auto it = pending_slots.find(label);
+    if (it != pending_slots.end()) {
+        std::copy(data.begin(), data.end(), pending_vectors.begin() + it->second * dim);
+        pending_seq[it->second] = write_seq;
+        return;
+    }
+    pending_slots[label] = pending_labels.size();
+    pending_labels.push_back(label);
+    pending_seq.push_back(write_seq);
+    pending_vectors.insert(pending_vectors.end(), data.begin(), data.end());
+}
+
+void DiskGraphIndex::remove_vectors(const std::vector<long>& ids) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    ++write_seq;
+    for (long id : ids) {
+        uint64_t label = static_cast<uint64_t>(id);
+        auto it = pending_slots.find(label);
+        if (it != pending_slots.end()) {
+            erasePendingSlot(it->second);
+        }
+        // 磁盘上的节点只做删除标记，下次 build 时真正移除；构建期间删除的标签可能出现在新的磁盘图中，同样记录
+        if (label_to_node.count(label) || building) {
+            deleted_labels[label] = write_seq;
+        }
+    }
+}
+
+void DiskGraphIndex::erasePendingSlot(size_t slot) {
+    // 用最后一个向量填补空位，增量没有顺序要求
+    size_t last = pending_labels.size() - 1;
+    pending_slots.erase(pending_labels[slot]);
+    if (slot != last) {
+        pending_labels[slot] = pending_labels[last];
+        pending_seq[slot] = pending_seq[last];
+        std::copy(pending_vectors.begin() + last * dim, pending_vectors.begin() + (last + 1) * dim, pending_vectors.begin() + slot * dim);
+        pending_slots[pending_labels[slot]] = slot;
+    }
+    pending_labels.pop_back();
+    pending_seq.pop_back();
+    pending_vectors.resize(last * dim);
+}
+
+size_t DiskGraphIndex::pending_size() const {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    return pending_labels.size();
+}
+
+std::pair<std::vector<long>, std::vector<float>> DiskGraphIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int search_list, int beam_width) {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    const float* q = query.data();
+    auto allowed = [&](uint64_t label) {
+        return !deleted_labels.count(label) && (bitmap == nullptr || roaring_bitmap_contains(bitmap, static_cast<uint32_t>(label)));
+    };
+
+    std::vector<std::pair<float, uint64_t>> results;
+    if (fd >= 0 && header.num_nodes > 0) {
+        // PQ 距离表，内积取负使得距离越小越相似
+        size_t ksub = pq.ksub;
+        std::vector<float> table(pq.M * ksub);
+        if (metric == IndexFactory::MetricType::L2) {
+            pq.compute_distance_table(q, table.data());
+        } else {
+            pq.compute_inner_prod_table(q, table.data());
+            for (float& t : table) {
+                t = -t;
+            }
+        }
+        auto pq_distance = [&](uint64_t node) {
+            const uint8_t* code = pq_codes.data() + node * pq.code_size;
+            float d = 0;
+            for (size_t m = 0; m < pq.M; ++m) {
+                d += table[m * ksub + code[m]];
+            }
+            return d;
+        };
+
+        struct Candidate {
+            float dist;
+            uint64_t node;
+            bool expanded;
+            bool operator<(const Candidate& other) const { return dist < other.dist; }
+        };
+        size_t list_size = std::max(search_list, k);
+        std::vector<Candidate> retset;
+        std::unordered_set<uint64_t> visited;
+        retset.push_back({pq_distance(header.entry_point), header.entry_point, false});
+        visited.insert(header.entry_point);
+
+        size_t read_size = nodeReadSize();
+        beam_width = std::max(1, beam_width);
+        void* raw = nullptr;
+        if (posix_memalign(&raw, SECTOR_SIZE, read_size * beam_width) != 0) {
+            throw std::bad_alloc();
+        }
+        std::unique_ptr<char, FreeDeleter> sector_bufs(static_cast<char*>(raw));
+
+        std::vector<uint64_t> frontier;
+        std::vector<uint64_t> offsets;
+        while (true) {
+            // 每轮扩展 beam_width 个最近的未扩展候选
+            frontier.clear();
+            for (auto& c : retset) {
+                if (!c.expanded) {
+                    c.expanded = true;
+                    frontier.push_back(c.node);
+                    if (frontier.size() == static_cast<size_t>(beam_width)) {
+                        break;
+                    }
+                }
+            }
+            if (frontier.empty()) {
+                break;
+            }
+
+            // 整个 beam 的扇区并行读取，一轮的延迟约为一次磁盘读取
+            offsets.clear();
+            for (uint64_t node : frontier) {
+                offsets.push_back(nodeOffset(node));
+            }
+            if (offsets.size() == 1) {
+                preadAll(fd, sector_bufs.get(), read_size, offsets[0]);
+            } else {
+                BeamReadPool::instance().read(fd, sector_bufs.get(), read_size, offsets);
+            }
+
+            for (size_t i = 0; i < frontier.size(); ++i) {
+                uint64_t node = frontier[i];
+                const char* node_buf = nodeInSector(sector_bufs.get() + i * read_size, node);
+
+                // 扩展节点时已读到原始向量，直接计算精确距离用于重排
+                const float* vec = reinterpret_cast<const float*>(node_buf);
+                if (allowed(labels[node])) {
+                    results.emplace_back(dist_func(q, vec, dist_func_param), labels[node]);
+                }
+
+                uint32_t degree = *reinterpret_cast<const uint32_t*>(node_buf + dim * sizeof(float));
+                const uint32_t* neighbors = reinterpret_cast<const uint32_t*>(node_buf + dim * sizeof(float) + sizeof(uint32_t));
+                for (uint32_t j = 0; j < degree; ++j) {
+                    uint64_t neighbor = neighbors[j];
+                    if (!visited.insert(neighbor).second) {
+                        continue;
+                    }
+                    float d = pq_distance(neighbor);
+                    if (retset.size() >= list_size && d >= retset.back().dist) {
+                        continue;
+                    }
+                    Candidate c{d, neighbor, false};
+                    retset.insert(std::upper_bound(retset.begin(), retset.end(), c), c);
+                    if (retset.size() > list_size) {
+                        retset.pop_back();
+                    }
+                }
+            }
+        }
+    }
+
+    // 内存增量部分暴力检索
+    for (size_t i = 0; i < pending_labels.size(); ++i) {
+        if (bitmap == nullptr || roaring_bitmap_contains(bitmap, static_cast<uint32_t>(pending_labels[i]))) {
+            results.emplace_back(dist_func(q, pending_vectors.data() + i * dim, dist_func_param), pending_labels[i]);
+        }
+    }
+
+    size_t top = std::min(results.size(), static_cast<size_t>(k));
+    std::partial_sort(results.begin(), results.begin() + top, results.end());
+
+    // 与 HNSWLibIndex 一致，按距离从远到近返回
+    std::vector<long> indices;
+    std::vector<float> distances;
+    for (size_t i = top; i > 0; --i) {
+        indices.push_back(static_cast<long>(results[i - 1].second));
+        distances.push_back(results[i - 1].first);
+    }
+    return {indices, distances};
+}
+
+void DiskGraphIndex::build() {
+    std::lock_guard<std::mutex> build_lock(build_mutex);
+
+    // 1. 短暂持有写锁，记录构建起点的内存增量和需要保留的磁盘节点，之后的写入照常进行
+    std::vector<uint64_t> disk_nodes;
+    std::vector<uint64_t> build_labels;
+    std::vector<float> build_vectors;
+    uint64_t build_seq;
+    {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        building = true;
+        build_seq = write_seq;
+        for (uint64_t node = 0; node < header.num_nodes; ++node) {
+            if (!deleted_labels.count(labels[node]) && !pending_slots.count(labels[node])) {
+                disk_nodes.push_back(node);
+            }
+        }
+        build_labels = pending_labels;
+        build_vectors = pending_vectors;
+    }
+
+    try {
+        size_t n = disk_nodes.size() + build_labels.size();
+        if (n < (1u << PQ_NBITS)) {
+            throw std::runtime_error("DiskGraphIndex build requires at least 256 vectors");
+        }
+        GlobalLogger->info("Building disk graph with {} vectors", n);
+
+        // 按新节点号读取原始向量：先是保留的磁盘节点，再是内存增量。
+        // 磁盘文件只由 build 替换，持有 build_mutex 时可以不加读写锁读取
+        std::vector<uint64_t> new_labels(n);
+        for (size_t i = 0; i < disk_nodes.size(); ++i) {
+            new_labels[i] = labels[disk_nodes[i]];
+        }
+        std::copy(build_labels.begin(), build_labels.end(), new_labels.begin() + disk_nodes.size());
+        auto fetch = [&](size_t node, float* vec) {
+            if (node < disk_nodes.size()) {
+                readNodeVector(disk_nodes[node], vec);
+            } else {
+                const float* src = build_vectors.data() + (node - disk_nodes.size()) * dim;
+                std::copy(src, src + dim, vec);
+            }
+        };
+
+        // 2. 用均匀抽样的向量训练 PQ，再分块读取并编码所有向量
+        faiss::ProductQuantizer new_pq(dim, choosePQM(dim), PQ_NBITS);
+        size_t n_train = std::min(n, PQ_MAX_TRAIN);
+        std::vector<float> train_vectors(n_train * dim);
+        for (size_t i = 0; i < n_train; ++i) {
+            fetch(i * n / n_train, train_vectors.data() + i * dim);
+        }
+        new_pq.train(n_train, train_vectors.data());
+        std::vector<float>().swap(train_vectors);
+
+        const size_t chunk_size = 4096;
+        std::vector<uint8_t> codes(n * new_pq.code_size);
+        std::vector<float> chunk(chunk_size * dim);
+        for (size_t first = 0; first < n; first += chunk_size) {
+            size_t count = std::min(chunk_size, n - first);
+            for (size_t i = 0; i < count; ++i) {
+                fetch(first + i, chunk.data() + i * dim);
+            }
+            new_pq.compute_codes(chunk.data(), codes.data() + first * new_pq.code_size, count);
+        }
+
+        // 3. 在 PQ 编码上用 hnswlib 并行构建图，只保留第 0 层作为磁盘图
+        PQSymmetricSpace build_space(new_pq, metric);
+        hnswlib::HierarchicalNSW<float> graph(&build_space, n, max_degree / 2, ef_construction);
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&]() {
+                size_t i;
+                while ((i = next++) < n) {
+                    graph.addPoint(codes.data() + i * new_pq.code_size, i);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // 4. 按扇区写入节点：向量 + 邻居数 + 邻居列表
+        DiskHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = DISK_GRAPH_MAGIC;
+        h.version = DISK_GRAPH_VERSION;
+        h.dim = dim;
+        h.metric = static_cast<uint32_t>(metric);
+        h.max_degree = graph.maxM0_;
+        h.num_nodes = n;
+        h.entry_point = graph.getExternalLabel(graph.enterpoint_node_);
+        h.node_size = dim * sizeof(float) + sizeof(uint32_t) + h.max_degree * sizeof(uint32_t);
+        if (h.node_size <= SECTOR_SIZE) {
+            h.nodes_per_sector = SECTOR_SIZE / h.node_size;
+            h.sectors_per_node = 1;
+        } else {
+            h.nodes_per_sector = 0;
+            h.sectors_per_node = (h.node_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        }
+        uint64_t num_sectors = h.nodes_per_sector > 0 ? (n + h.nodes_per_sector - 1) / h.nodes_per_sector : n * h.sectors_per_node;
+        h.tail_offset = (1 + num_sectors) * SECTOR_SIZE;
+        h.pq_m = new_pq.M;
+        h.pq_nbits = new_pq.nbits;
+
+        // 内部 ID 与插入顺序不同，需要映射回节点号
+        std::vector<hnswlib::tableint> internal_of(n);
+        for (hnswlib::tableint internal = 0; internal < n; ++internal) {
+            internal_of[graph.getExternalLabel(internal)] = internal;
+        }
+
+        std::string tmp_path = disk_path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to create disk graph file: " + tmp_path);
+        }
+        std::vector<char> sector(SECTOR_SIZE, 0);
+        memcpy(sector.data(), &h, sizeof(h));
+        out.write(sector.data(), SECTOR_SIZE);
+
+        size_t nodes_per_block = h.nodes_per_sector > 0 ? h.nodes_per_sector : 1;
+        std::vector<char> block(h.sectors_per_node * SECTOR_SIZE);
+        for (uint64_t first = 0; first < n; first += nodes_per_block) {
+            std::fill(block.begin(), block.end(), 0);
+            for (uint64_t node = first; node < std::min<uint64_t>(n, first + nodes_per_block); ++node) {
+                char* p = block.data() + (node - first) * h.node_size;
+                fetch(node, reinterpret_cast<float*>(p));
+
+                hnswlib::linklistsizeint* ll = graph.get_linklist0(internal_of[node]);
+                uint32_t degree = graph.getListCount(ll);
+                hnswlib::tableint* neighbors = reinterpret_cast<hnswlib::tableint*>(ll + 1);
+                memcpy(p + dim * sizeof(float), &degree, sizeof(uint32_t));
+                uint32_t* dst = reinterpret_cast<uint32_t*>(p + dim * sizeof(float) + sizeof(uint32_t));
+                for (uint32_t j = 0; j < degree; ++j) {
+                    dst[j] = static_cast<uint32_t>(graph.getExternalLabel(neighbors[j]));
+                }
+            }
+            out.write(block.data(), block.size());
+        }
+
+        out.write(reinterpret_cast<const char*>(new_labels.data()), n * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(new_pq.centroids.data()), new_pq.centroids.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(codes.data()), codes.size());
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write disk graph file: " + tmp_path);
+        }
+
+        // 5. 替换文件并准备新的内存数据，旧文件描述符在切换前仍可用于检索
+        if (std::rename(tmp_path.c_str(), disk_path.c_str()) != 0) {
+            throw std::runtime_error("Failed to replace disk graph file: " + disk_path);
+        }
+        int new_fd = open(disk_path.c_str(), O_RDONLY);
+        if (new_fd < 0) {
+            throw std::runtime_error("Failed to open disk graph file: " + disk_path);
+        }
+        std::unordered_map<uint64_t, uint64_t> new_label_to_node;
+        for (uint64_t i = 0; i < n; ++i) {
+            new_label_to_node[new_labels[i]] = i;
+        }
+
+        // 6. 短暂持有写锁切换到新的磁盘图，构建开始后的写入和删除保留下来
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        closeDiskFile();
+        fd = new_fd;
+        header = h;
+        labels.swap(new_labels);
+        label_to_node.swap(new_label_to_node);
+        pq = new_pq;
+        pq_codes.swap(codes);
+        for (size_t slot = pending_labels.size(); slot-- > 0;) {
+            if (pending_seq[slot] <= build_seq) {
+                erasePendingSlot(slot);
+            }
+        }
+        for (auto it = deleted_labels.begin(); it != deleted_labels.end();) {
+            if (it->second <= build_seq || !label_to_node.count(it->first)) {
+                it = deleted_labels.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // 构建开始后重新写入的标签以增量为准
+        for (uint64_t label : pending_labels) {
+            if (label_to_node.count(label)) {
+                deleted_labels[label] = write_seq;
+            }
+        }
+        building = false;
+        GlobalLogger->info("Disk graph rebuilt: {} nodes, {} vectors still pending", n, pending_labels.size());
+    } catch (...) {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        building = false;
+        throw;
+    }
+}
+
+void DiskGraphIndex::saveIndex(const std::string& file_path) {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    std::ofstream out(file_path, std::ios::binary);
+    if (!out) {
+        GlobalLogger->error("Failed to open file for writing: {}", file_path);
+        return;
+    }
+
+    // 磁盘图数据不重写，快照只保存文件引用、删除标记和内存增量
+    uint64_t path_len = disk_path.size();
+    out.write(reinterpret_cast<const char*>(&SNAPSHOT_MAGIC), sizeof(SNAPSHOT_MAGIC));
+    out.write(reinterpret_cast<const char*>(&path_len), sizeof(path_len));
+    out.write(disk_path.data(), path_len);
+
+    std::vector<uint64_t> deleted;
+    for (const auto& entry : deleted_labels) {
+        deleted.push_back(entry.first);
+    }
+    uint64_t num_deleted = deleted.size();
+    out.write(reinterpret_cast<const char*>(&num_deleted), sizeof(num_deleted));
+    out.write(reinterpret_cast<const char*>(deleted.data()), num_deleted * sizeof(uint64_t));
+
+    uint64_t num_pending = pending_labels.size();
+    out.write(reinterpret_cast<const char*>(&num_pending), sizeof(num_pending));
+    out.write(reinterpret_cast<const char*>(pending_labels.data()), num_pending * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(pending_vectors.data()), pending_vectors.size() * sizeof(float));
+}
+
+void DiskGraphIndex::loadIndex(const std::string& file_path) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in.good()) {
+        GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
+        return;
+    }
+
+    uint64_t magic = 0, path_len = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (magic != SNAPSHOT_MAGIC) {
+        GlobalLogger->error("Invalid disk graph snapshot: {}", file_path);
+        return;
+    }
+    in.read(reinterpret_cast<char*>(&path_len), sizeof(path_len));
+    std::string snapshot_disk_path(path_len, '\0');
+    in.read(&snapshot_disk_path[0], path_len);
+    if (snapshot_disk_path != disk_path) {
+        GlobalLogger->warn("Disk graph snapshot references {}, configured path is {}", snapshot_disk_path, disk_path);
+    }
+
+    std::lock_guard<std::mutex> build_lock(build_mutex);
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    openDiskFile();
+
+    uint64_t num_deleted = 0;
+    in.read(reinterpret_cast<char*>(&num_deleted), sizeof(num_deleted));
+    std::vector<uint64_t> deleted(num_deleted);
+    in.read(reinterpret_cast<char*>(deleted.data()), num_deleted * sizeof(uint64_t));
+    deleted_labels.clear();
+    for (uint64_t label : deleted) {
+        deleted_labels[label] = 0;
+    }
+
+    uint64_t num_pending = 0;
+    in.read(reinterpret_cast<char*>(&num_pending), sizeof(num_pending));
+    pending_labels.resize(num_pending);
+    pending_vectors.resize(num_pending * dim);
+    in.read(reinterpret_cast<char*>(pending_labels.data()), num_pending * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(pending_vectors.data()), pending_vectors.size() * sizeof(float));
+    pending_seq.assign(num_pending, 0);
+    pending_slots.clear();
+    for (size_t slot = 0; slot < num_pending; ++slot) {
+        pending_slots[pending_labels[slot]] = slot;
+    }
+
+    // 快照之后磁盘图可能已重建，内存增量中的标签以增量为准
+    for (uint64_t label : pending_labels) {
+        if (label_to_node.count(label)) {
+            deleted_labels[label] = 0;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "hnswlib/hnswlib.h"
+#include "index_factory.h"
+#include "roaring/roaring.h"
+#include <faiss/impl/ProductQuantizer.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
+#include <mutex>
+
+// 磁盘图索引（DiskANN 风格）：PQ 压缩向量常驻内存用于路由，
+// 原始向量和邻接表按 4KB 扇区对齐存放在 SSD 上，检索时按 beam 读取并用原始向量重排
+class DiskGraphIndex {
+public:
+    static const size_t SECTOR_SIZE = 4096;
+
+    DiskGraphIndex(int dim, IndexFactory::MetricType metric, const std::string& disk_path, int max_degree = 64, int ef_construction = 200);
+    ~DiskGraphIndex();
+
+    void insert_vectors(const std::vector<float>& data, uint64_t label); // 新向量先写入内存增量，build 时合并到磁盘
+    void remove_vectors(const std::vector<long>& ids);
+    std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int search_list = 100, int beam_width = 4);
+    void build(); // 将磁盘上的向量和内存增量合并，重建磁盘图；构建期间可继续读写，完成后短暂加写锁切换
+    size_t pending_size() const;
+    void saveIndex(const std::string& file_path); // 快照只记录磁盘文件引用、删除标记和内存增量
+    void loadIndex(const std::string& file_path);
+
+private:
+    struct DiskHeader {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t dim;
+        uint32_t metric;
+        uint32_t max_degree;
+        uint64_t num_nodes;
+        uint64_t entry_point;
+        uint64_t node_size; // 向量 + 邻居数 + 邻居列表
+        uint64_t nodes_per_sector; // 为 0 表示单个节点跨多个扇区
+        uint64_t sectors_per_node;
+        uint64_t tail_offset; // 标签、PQ 码本和 PQ 编码的起始位置
+        uint32_t pq_m;
+        uint32_t pq_nbits;
+    };
+
+    void openDiskFile(); // 打开磁盘文件并加载标签和 PQ 数据，调用方需持有写锁
+    void closeDiskFile();
+    uint64_t nodeOffset(uint64_t node) const; // 节点所在扇区的文件偏移
+    size_t nodeReadSize() const;
+    const char* nodeInSector(const char* sector_buf, uint64_t node) const;
+    void readNodeVector(uint64_t node, float* vec) const;
+    void erasePendingSlot(size_t slot); // 删除内存增量中的一个向量，调用方需持有写锁
+
+    int dim;
+    IndexFactory::MetricType metric;
+    std::string disk_path;
+    int max_degree;
+    int ef_construction;
+    hnswlib::SpaceInterface<float>* space;
+    hnswlib::DISTFUNC<float> dist_func;
+    void* dist_func_param;
+
+    int fd;
+    DiskHeader header;
+    std::vector<uint64_t> labels; // 节点号 -> 标签
+    std::unordered_map<uint64_t, uint64_t> label_to_node;
+    faiss::ProductQuantizer pq;
+    std::vector<uint8_t> pq_codes;
+    std::unordered_map<uint64_t, uint64_t> deleted_labels; // 已从磁盘图中删除的标签 -> 删除时的写入序号
+
+    std::vector<float> pending_vectors; // 尚未合并到磁盘的增量向量
+    std::vector<uint64_t> pending_labels;
+    std::vector<uint64_t> pending_seq; // 每个增量向量最后写入时的序号
+    std::unordered_map<uint64_t, size_t> pending_slots; // 标签 -> 增量中的位置
+    uint64_t write_seq = 0; // 每次写入或删除递增，build 据此区分构建开始后的修改
+    bool building = false;
+
+    mutable std::shared_mutex rw_mutex;
+    std::mutex build_mutex; // 串行化 build 和 loadIndex，构建期间磁盘文件不会被替换
+};
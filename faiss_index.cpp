@@ -1,11 +1,22 @@
 #include "faiss_index.h"
+#include "layered_invlists.h"
+#include "index_factory.h"
 #include "logger.h"
 #include "constants.h"
 #include <faiss/IndexIDMap.h>
+#include <faiss/IndexBinaryHNSW.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexPreTransform.h>
 #include <faiss/IndexFlat.h>
 #include <faiss/index_io.h> // 更正头文件
+#include <faiss/IndexIVF.h>
+#include <faiss/IVFlib.h> // 包含 IVFlib.h 以使用 try_extract_index_ivf
+#include <faiss/invlists/OnDiskInvertedLists.h>
+#include <faiss/impl/AuxIndexStructures.h> // 包含 AuxIndexStructures.h 以使用 RangeSearchResult
+#include <cstdio>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <fstream> // 包含 <fstream> 以使用 std::ifstream
 
 
@@ -20,37 +31,358 @@ bool RoaringBitmapIDSelector::is_member(int64_t id) const{
     return is_member;
 }
 
-FaissIndex::FaissIndex(faiss::Index* index) : index(index) {}
+namespace {
+    // IndexBinaryIDMap 包装的实际索引
+    const faiss::IndexBinary* binaryIndexOf(const faiss::IndexBinary* binary_index) {
+        auto id_map = dynamic_cast<const faiss::IndexBinaryIDMap*>(binary_index);
+        return id_map != nullptr ? id_map->index : binary_index;
+    }
+
+    // IndexIDMap 和 IndexPreTransform 包装的 HNSW 索引，没有时返回 nullptr
+    const faiss::IndexHNSW* tryExtractIndexHNSW(const faiss::Index* index) {
+        while (index != nullptr) {
+            if (auto hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+                return hnsw;
+            } else if (auto id_map = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+                index = id_map->index;
+            } else if (auto pre_transform = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+                index = pre_transform->index;
+            } else {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // 按索引类型选择检索参数：IVF 和 HNSW 索引只接受各自的参数类型，传入基类参数时 faiss 抛出异常
+    struct FaissSearchParams {
+        faiss::SearchParameters plain;
+        faiss::SearchParametersIVF ivf;
+        faiss::SearchParametersHNSW hnsw;
+
+        // 没有过滤条件的非 IVF 索引返回 nullptr；IVF 索引未指定 nprobe 时使用索引自身的 nprobe
+        const faiss::SearchParameters* get(const faiss::Index* index, faiss::IDSelector* sel, int nprobe) {
+            if (const faiss::IndexIVF* ivf_index = faiss::ivflib::try_extract_index_ivf(index)) {
+                ivf.nprobe = nprobe > 0 ? static_cast<size_t>(nprobe) : ivf_index->nprobe;
+                ivf.sel = sel;
+                return &ivf;
+            }
+            if (sel == nullptr) {
+                return nullptr;
+            }
+            if (const faiss::IndexHNSW* hnsw_index = tryExtractIndexHNSW(index)) {
+                hnsw.efSearch = hnsw_index->hnsw.efSearch;
+                hnsw.sel = sel;
+                return &hnsw;
+            }
+            plain.sel = sel;
+            return &plain;
+        }
+    };
+}
+
+FaissIndex::FaissIndex(faiss::Index* index) : index(index), trained_(index->is_trained) {
+    registerLayeredInvertedListsIOHook(); // 加载使用分层磁盘倒排表的快照前需要注册
+}
+
+FaissIndex::FaissIndex(faiss::IndexBinary* binary_index) : index(nullptr), binary_index(binary_index), trained_(binary_index->is_trained) {}
+
+FaissIndex::~FaissIndex() {
+    if (train_thread_.joinable()) {
+        train_thread_.join();
+    }
+}
+
+std::vector<uint8_t> FaissIndex::toBinaryCodes(const std::vector<float>& data) const {
+    size_t code_size = static_cast<size_t>(binary_index->code_size);
+    if (data.empty() || data.size() % code_size != 0) {
+        throw std::invalid_argument("Binary vector must contain dim / 8 byte values");
+    }
+    std::vector<uint8_t> codes(data.size());
+    IndexFactory::toBinaryCodes(data.data(), data.size(), codes.data());
+    return codes;
+}
 
 void FaissIndex::insert_vectors(const std::vector<float>& data, uint64_t label) {
     long id = static_cast<long>(label);
+    if (binary_index != nullptr) { // 二值索引不需要训练
+        std::vector<uint8_t> codes = toBinaryCodes(data);
+        std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+        binary_index->add_with_ids(1, codes.data(), &id);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(train_mutex_);
+        if (!trained_) {
+            // 索引尚未训练，先缓存向量，达到阈值后在后台线程训练，不阻塞写入线程
+            pending_vectors_.insert(pending_vectors_.end(), data.begin(), data.end());
+            pending_ids_.push_back(id);
+            if (train_threshold_ > 0 && pending_ids_.size() >= train_threshold_ && !training_.exchange(true)) {
+                if (train_thread_.joinable()) { // 上一次训练失败的线程已经结束
+                    train_thread_.join();
+                }
+                train_thread_ = std::thread([this] {
+                    try {
+                        trainPending();
+                    } catch (const std::exception& e) {
+                        GlobalLogger->error("Background training of faiss index failed: {}", e.what());
+                    }
+                    training_ = false;
+                });
+            }
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
     index->add_with_ids(1, data.data(), &id);
 }
 
 void FaissIndex::remove_vectors(const std::vector<long>& ids) {
-    faiss::IndexIDMap* id_map = dynamic_cast<faiss::IndexIDMap*>(index);
-    if (id_map) {
+    if (binary_index != nullptr) {
         faiss::IDSelectorBatch selector(ids.size(), ids.data());
-        id_map->remove_ids(selector);
-    } else {
-        throw std::runtime_error("Underlying Faiss index is not an IndexIDMap");
+        std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+        if (dynamic_cast<const faiss::IndexBinaryHNSW*>(binaryIndexOf(binary_index)) != nullptr) {
+            throw std::invalid_argument("Binary HNSW index does not support removing vectors");
+        }
+        binary_index->remove_ids(selector);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(train_mutex_);
+        if (!trained_) {
+            // 索引尚未训练，直接从训练缓存中删除
+            int dim = index->d;
+            size_t kept = 0;
+            for (size_t i = 0; i < pending_ids_.size(); ++i) {
+                if (std::find(ids.begin(), ids.end(), pending_ids_[i]) != ids.end()) {
+                    continue;
+                }
+                if (kept != i) {
+                    pending_ids_[kept] = pending_ids_[i];
+                    std::copy(pending_vectors_.begin() + i * dim, pending_vectors_.begin() + (i + 1) * dim, pending_vectors_.begin() + kept * dim);
+                }
+                ++kept;
+            }
+            pending_ids_.resize(kept);
+            pending_vectors_.resize(kept * dim);
+            return;
+        }
+    }
+    // IndexIDMap、IndexIVF 等均实现了 remove_ids，不支持删除的索引由 faiss 抛出异常
+    faiss::IDSelectorBatch selector(ids.size(), ids.data());
+    std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+    faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(index);
+    if (LayeredInvertedLists* layered = ivf != nullptr ? dynamic_cast<LayeredInvertedLists*>(ivf->invlists) : nullptr) {
+        // faiss 删除时在列表内原地交换，先将涉及的列表复制出冻结层
+        if (faiss::IndexIDMap* id_map = dynamic_cast<faiss::IndexIDMap*>(index)) {
+            layered->makeWritable(faiss::IDSelectorTranslated(id_map->id_map, &selector));
+        } else {
+            layered->makeWritable(selector);
+        }
     }
+    index->remove_ids(selector);
 }
 
-std::pair<std::vector<long>, std::vector<float>> FaissIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap) {
+void FaissIndex::train() {
+    if (training_.exchange(true)) {
+        throw std::runtime_error("Faiss index is already being trained");
+    }
+    try {
+        trainPending();
+    } catch (...) {
+        training_ = false;
+        throw;
+    }
+    training_ = false;
+}
+
+void FaissIndex::setTrainThreshold(size_t train_threshold) {
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    train_threshold_ = train_threshold;
+}
+
+void FaissIndex::trainPending() {
+    // 复制一份训练样本，训练期间写入的向量继续进入缓存，训练完成后一起写入
+    std::vector<float> samples;
+    {
+        std::lock_guard<std::mutex> lock(train_mutex_);
+        if (trained_) {
+            GlobalLogger->warn("Faiss index is already trained, skipping training");
+            return;
+        }
+        if (pending_ids_.empty()) {
+            throw std::runtime_error("No buffered vectors to train the index with");
+        }
+        samples = pending_vectors_;
+    }
+    size_t n = samples.size() / index->d;
+
+    // 训练完成前检索直接返回错误，不会等待这里的独占锁
+    std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+    GlobalLogger->info("Training faiss index with {} buffered vectors", n);
+    index->train(n, samples.data());
+
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    // 训练完成后才能确定倒排表结构，此时切换到磁盘倒排表
+    if (!ondisk_invlists_path_.empty()) {
+        moveInvlistsToDisk();
+    }
+
+    // 批量写入缓存的向量
+    index->add_with_ids(pending_ids_.size(), pending_vectors_.data(), pending_ids_.data());
+    std::vector<float>().swap(pending_vectors_);
+    std::vector<long>().swap(pending_ids_);
+    trained_ = true;
+    applyMemoryPolicy();
+    GlobalLogger->info("Faiss index trained, ntotal: {}", index->ntotal);
+}
+
+void FaissIndex::setOnDiskInvlistsPath(const std::string& path) {
+    std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    ondisk_invlists_path_ = path;
+    if (index != nullptr && trained_) {
+        moveInvlistsToDisk();
+    }
+}
+
+void FaissIndex::moveInvlistsToDisk() {
+    faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(index);
+    if (ivf == nullptr) {
+        GlobalLogger->warn("On-disk inverted lists require an IVF index, keeping lists in memory");
+        return;
+    }
+    if (LayeredInvertedLists* layered = dynamic_cast<LayeredInvertedLists*>(ivf->invlists)) {
+        layered->setPathPrefix(ondisk_invlists_path_); // 已有的层文件保持不变，之后新建的层使用新路径
+        return;
+    }
+
+    // 倒排表通过 mmap 映射到磁盘文件，聚类中心仍保存在内存中
+    LayeredInvertedLists* layered = new LayeredInvertedLists(ivf->nlist, ivf->code_size, ondisk_invlists_path_);
+    if (faiss::OnDiskInvertedLists* snapshot = dynamic_cast<faiss::OnDiskInvertedLists*>(ivf->invlists)) {
+        // 旧格式快照的倒排表文件直接作为冻结层引用
+        layered->adoptFrozenLayer(snapshot);
+        ivf->own_invlists = false;
+    } else if (ivf->ntotal > 0) {
+        // 将内存中已有的倒排表迁移到磁盘
+        layered->copyFrom(ivf->invlists);
+    }
+    ivf->replace_invlists(layered, true);
+    GlobalLogger->info("IVF inverted lists moved to disk: {}", ondisk_invlists_path_);
+}
+
+void FaissIndex::attachSnapshotInvlists() {
+    if (!ondisk_invlists_path_.empty()) {
+        moveInvlistsToDisk(); // 快照的倒排表文件已冻结，之后的写入进入新的层文件
+        return;
+    }
+    faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(index);
+    faiss::InvertedLists* snapshot = ivf != nullptr ? ivf->invlists : nullptr;
+    if (dynamic_cast<LayeredInvertedLists*>(snapshot) == nullptr && dynamic_cast<faiss::OnDiskInvertedLists*>(snapshot) == nullptr) {
+        return;
+    }
+    // 未配置磁盘倒排表时复制到内存中
+    faiss::ArrayInvertedLists* lists = new faiss::ArrayInvertedLists(ivf->nlist, ivf->code_size);
+    for (size_t list_no = 0; list_no < ivf->nlist; ++list_no) {
+        faiss::InvertedLists::ScopedIds ids(snapshot, list_no);
+        faiss::InvertedLists::ScopedCodes codes(snapshot, list_no);
+        lists->add_entries(list_no, snapshot->list_size(list_no), ids.get(), codes.get());
+    }
+    ivf->replace_invlists(lists, true);
+    GlobalLogger->info("IVF inverted lists copied from snapshot into memory");
+}
+
+void FaissIndex::writeIndexSnapshot(const std::string& file_path) {
+    faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(index);
+    LayeredInvertedLists* layered = ivf != nullptr ? dynamic_cast<LayeredInvertedLists*>(ivf->invlists) : nullptr;
+    if (layered == nullptr) {
+        faiss::write_index(index, file_path.c_str());
+        return;
+    }
+
+    // 冻结当前各层后只写入文件名和各列表的位置，之后的写入先把列表复制到新的层，快照引用的文件不再改变。
+    // 写入临时索引文件后重命名，快照整体原子切换
+    layered->freeze();
+    std::string tmp_path = file_path + ".tmp";
+    faiss::write_index(index, tmp_path.c_str());
+    if (std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        throw std::runtime_error("Failed to rename " + tmp_path + " to " + file_path);
+    }
+    layered->commitSnapshot(); // 新快照生效后删除只被上一次快照引用的层文件
+}
+
+void FaissIndex::setMemoryPolicy(const hnswlib::MemoryPolicy& policy) {
+    std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    memory_policy_ = policy;
+    policy_codes_ = nullptr;
+    applyMemoryPolicy();
+}
+
+void FaissIndex::applyMemoryPolicy() {
+    if (memory_policy_.isDefault() || index == nullptr) { // 二值索引保持默认分配
+        return;
+    }
+    // FLAT 和标量量化索引的编码存放在 IndexFlatCodes::codes 中，其余索引保持默认分配
+    faiss::Index* inner = index;
+    if (faiss::IndexIDMap* id_map = dynamic_cast<faiss::IndexIDMap*>(index)) {
+        inner = id_map->index;
+    }
+    faiss::IndexFlatCodes* flat = dynamic_cast<faiss::IndexFlatCodes*>(inner);
+    if (flat == nullptr || flat->codes.size() == 0 || flat->codes.data() == policy_codes_) {
+        return;
+    }
+    // 已写入的页会被迁移到目标节点；之后写入导致编码缓冲区扩容时新缓冲区按默认方式分配，直到下次加载或训练
+    policy_codes_ = flat->codes.data();
+    hnswlib::applyMemoryPolicy(const_cast<uint8_t*>(policy_codes_), flat->codes.size(), memory_policy_);
+}
+
+bool FaissIndex::is_trained() const {
+    return trained_;
+}
+
+bool FaissIndex::is_binary() const {
+    return binary_index != nullptr;
+}
+
+bool FaissIndex::supports_remove() const {
+    std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+    return binary_index == nullptr || dynamic_cast<const faiss::IndexBinaryHNSW*>(binaryIndexOf(binary_index)) == nullptr;
+}
+
+size_t FaissIndex::pending_size() const {
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    return pending_ids_.size();
+}
+
+std::pair<std::vector<long>, std::vector<float>> FaissIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int nprobe) {
+    // 索引尚未训练时无法检索，返回错误而不是空结果
+    if (!trained_) {
+        throw std::runtime_error("Faiss index is not trained yet, " + std::to_string(pending_size()) + " vectors pending");
+    }
+    std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+    if (binary_index != nullptr) {
+        // 汉明距离为整数，转换为 float 与其他索引的结果格式一致
+        std::vector<uint8_t> codes = toBinaryCodes(query);
+        size_t num_queries = codes.size() / binary_index->code_size;
+        std::vector<long> indices(num_queries * k, -1);
+        std::vector<int32_t> hamming(num_queries * k);
+        faiss::SearchParameters search_params;
+        RoaringBitmapIDSelector selector(bitmap);
+        search_params.sel = &selector;
+        // IndexBinaryHNSW 等不支持检索参数的索引只在有过滤条件时由 faiss 抛出异常
+        binary_index->search(num_queries, codes.data(), k, hamming.data(), indices.data(), bitmap != nullptr ? &search_params : nullptr);
+        return {indices, std::vector<float>(hamming.begin(), hamming.end())};
+    }
     int dim = index->d;
     int num_queries = query.size() / dim;
-    std::vector<long> indices(num_queries * k);
+    std::vector<long> indices(num_queries * k, -1);
     std::vector<float> distances(num_queries * k);
 
-    // 如果传入了 bitmap 参数，则使用 RoaringBitmapIDSelector 初始化 faiss::SearchParameters 对象
-    faiss::SearchParameters search_params;
+    // 如果传入了 bitmap 参数，则使用 RoaringBitmapIDSelector 过滤；对于 IVF 类索引按请求设置 nprobe
     RoaringBitmapIDSelector selector(bitmap);
-    if (bitmap != nullptr) {
-        search_params.sel = &selector;
-    }
-
-    index->search(num_queries, query.data(), k, distances.data(), indices.data(), &search_params); // 将 search_params 传入 search 方法
+    FaissSearchParams search_params;
+    index->search(num_queries, query.data(), k, distances.data(), indices.data(), search_params.get(index, bitmap != nullptr ? &selector : nullptr, nprobe));
 
     GlobalLogger->debug("Retrieved values:");
     for (size_t i = 0; i < indices.size(); ++i) {
@@ -63,18 +395,125 @@ std::pair<std::vector<long>, std::vector<float>> FaissIndex::search_vectors(cons
     return {indices, distances};
 }
 
+std::pair<std::vector<long>, std::vector<float>> FaissIndex::range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap, size_t max_results, int nprobe) {
+    std::vector<long> indices;
+    std::vector<float> distances;
+    if (!trained_) {
+        throw std::runtime_error("Faiss index is not trained yet, " + std::to_string(pending_size()) + " vectors pending");
+    }
+    std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+    if (binary_index != nullptr) {
+        // 返回汉明距离小于 radius 的向量
+        faiss::SearchParameters search_params;
+        RoaringBitmapIDSelector selector(bitmap);
+        search_params.sel = &selector;
+        faiss::RangeSearchResult result(1);
+        binary_index->range_search(1, toBinaryCodes(query).data(), static_cast<int>(radius), &result, bitmap != nullptr ? &search_params : nullptr);
+
+        std::vector<std::pair<float, long>> found;
+        for (size_t i = result.lims[0]; i < result.lims[1]; ++i) {
+            found.emplace_back(result.distances[i], result.labels[i]);
+        }
+        std::sort(found.begin(), found.end());
+        if (found.size() > max_results) {
+            found.resize(max_results);
+        }
+        for (const auto& item : found) {
+            indices.push_back(item.second);
+            distances.push_back(item.first);
+        }
+        return {indices, distances};
+    }
+
+    // 与 search_vectors 相同，按需设置过滤器和 nprobe
+    RoaringBitmapIDSelector selector(bitmap);
+    FaissSearchParams search_params;
+
+    // L2 返回距离小于 radius 的向量，内积返回相似度大于 radius 的向量
+    faiss::RangeSearchResult result(1);
+    index->range_search(1, query.data(), radius, &result, search_params.get(index, bitmap != nullptr ? &selector : nullptr, nprobe));
+
+    std::vector<std::pair<float, long>> found;
+    for (size_t i = result.lims[0]; i < result.lims[1]; ++i) {
+        found.emplace_back(result.distances[i], result.labels[i]);
+    }
+    bool larger_is_closer = index->metric_type == faiss::METRIC_INNER_PRODUCT;
+    std::sort(found.begin(), found.end(), [larger_is_closer](const std::pair<float, long>& a, const std::pair<float, long>& b) {
+        return larger_is_closer ? a.first > b.first : a.first < b.first;
+    });
+    if (found.size() > max_results) {
+        found.resize(max_results);
+    }
+    for (const auto& item : found) {
+        indices.push_back(item.second);
+        distances.push_back(item.first);
+    }
+    return {indices, distances};
+}
+
 void FaissIndex::saveIndex(const std::string& file_path) { // 添加 saveIndex 方法实现
-    faiss::write_index(index, file_path.c_str());
+    if (binary_index != nullptr) { // 二值索引没有训练缓存
+        std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+        faiss::write_index_binary(binary_index, file_path.c_str());
+        return;
+    }
+    // 快照与检索共享索引，磁盘倒排表只记录文件引用，不复制数据
+    std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+    std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
+    writeIndexSnapshot(file_path);
+
+    // 将尚未训练的缓存向量保存到 .pending 文件
+    std::string pending_path = file_path + ".pending";
+    std::lock_guard<std::mutex> lock(train_mutex_);
+    if (pending_ids_.empty()) {
+        std::remove(pending_path.c_str());
+        return;
+    }
+    std::ofstream out(pending_path, std::ios::binary);
+    uint64_t n = pending_ids_.size();
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char*>(pending_ids_.data()), n * sizeof(long));
+    out.write(reinterpret_cast<const char*>(pending_vectors_.data()), pending_vectors_.size() * sizeof(float));
 }
 
 void FaissIndex::loadIndex(const std::string& file_path) { // 添加 loadIndex 方法实现
     std::ifstream file(file_path); // 尝试打开文件
     if (file.good()) { // 检查文件是否存在
         file.close();
+        std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+        std::lock_guard<std::mutex> lock(train_mutex_);
+        if (binary_index != nullptr) {
+            delete binary_index;
+            binary_index = faiss::read_index_binary(file_path.c_str());
+            trained_ = binary_index->is_trained;
+            return;
+        }
         if (index != nullptr) {
             delete index;
         }
         index = faiss::read_index(file_path.c_str());
+        trained_ = index->is_trained;
+        policy_codes_ = nullptr;
+        applyMemoryPolicy();
+
+        // 快照的倒排表文件保持不变，之后的写入进入新的层文件
+        if (index->is_trained) {
+            attachSnapshotInvlists();
+        }
+
+        // 恢复尚未训练的缓存向量
+        pending_ids_.clear();
+        pending_vectors_.clear();
+        std::ifstream in(file_path + ".pending", std::ios::binary);
+        if (in.good()) {
+            uint64_t n = 0;
+            in.read(reinterpret_cast<char*>(&n), sizeof(n));
+            pending_ids_.resize(n);
+            pending_vectors_.resize(n * index->d);
+            in.read(reinterpret_cast<char*>(pending_ids_.data()), n * sizeof(long));
+            in.read(reinterpret_cast<char*>(pending_vectors_.data()), pending_vectors_.size() * sizeof(float));
+            GlobalLogger->info("Loaded {} pending vectors from {}", n, file_path + ".pending");
+        }
     } else {
         GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
     }
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <faiss/Index.h>
+#include <faiss/IndexBinary.h>
 #include <faiss/utils/utils.h>
 #include "faiss/impl/IDSelector.h"
 #include "roaring/roaring.h"
+#include "hnswlib/memory_policy.h"
 #include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
 
 // 定义 RoaringBitmapIDSelector 结构体
 struct RoaringBitmapIDSelector : faiss::IDSelector {
@@ -20,12 +26,43 @@ struct RoaringBitmapIDSelector : faiss::IDSelector {
 class FaissIndex {
 public:
     FaissIndex(faiss::Index* index);
+    FaissIndex(faiss::IndexBinary* binary_index); // 二值索引，每个向量输入 d / 8 个字节值，距离为汉明距离
+    ~FaissIndex(); // 等待后台训练结束
     void insert_vectors(const std::vector<float>& data, uint64_t label);
     void remove_vectors(const std::vector<long>& ids);
-    std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr);
+    std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int nprobe = 0); // 添加 nprobe 参数，仅对 IVF 类索引生效；索引尚未训练时抛出异常
+    std::pair<std::vector<long>, std::vector<float>> range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap = nullptr, size_t max_results = 1000, int nprobe = 0); // 返回与查询向量距离在 radius 内的向量，按距离排序，最多 max_results 个
+    void train(); // 使用缓存的向量同步训练索引，然后批量写入；已有训练在进行时抛出异常
+    void setTrainThreshold(size_t train_threshold); // 缓存的向量数达到阈值后在后台线程自动训练，0 表示只通过 /admin/train 训练
+    bool is_trained() const; // 添加 is_trained 方法声明
+    bool is_binary() const; // 是否为二值索引，二值索引的距离总是汉明距离
+    bool supports_remove() const; // 是否支持删除向量，IndexBinaryHNSW 不支持，已存在的 ID 无法更新
+    size_t pending_size() const; // 返回等待训练的向量数
+    void setOnDiskInvlistsPath(const std::string& path); // 设置 IVF 倒排表的磁盘文件路径，训练后倒排表存放在该文件中
+    void setMemoryPolicy(const hnswlib::MemoryPolicy& policy); // 设置扁平编码缓冲区的大页和 NUMA 策略，在设置、加载和训练时生效
     void saveIndex(const std::string& file_path); // 添加 saveIndex 方法声明
     void loadIndex(const std::string& file_path); // 将返回类型更改为 faiss::Index*
 
 private:
+    void trainPending(); // 训练并写入缓存的向量，调用方需先将 training_ 置为 true
+    void moveInvlistsToDisk(); // 将 IVF 倒排表替换为 LayeredInvertedLists，调用方需独占 index_mutex_
+    void attachSnapshotInvlists(); // 加载快照后，配置了磁盘倒排表时直接引用快照的倒排表文件，否则复制到内存
+    void writeIndexSnapshot(const std::string& file_path); // 写入索引，磁盘倒排表只记录文件引用，调用方需持有 snapshot_mutex_
+    void applyMemoryPolicy(); // 对当前编码缓冲区应用内存策略，只在设置策略、加载和训练时调用，调用方需独占 index_mutex_ 并持有 train_mutex_
+    std::vector<uint8_t> toBinaryCodes(const std::vector<float>& data) const; // 字节值转换为二值索引的编码，长度必须是编码大小的整数倍
+
     faiss::Index* index;
+    faiss::IndexBinary* binary_index = nullptr; // 非空时为二值索引，index 为空
+    size_t train_threshold_ = 0;
+    std::atomic<bool> trained_; // 在 train_mutex_ 内修改，检索时不加锁读取
+    std::atomic<bool> training_{false};
+    std::thread train_thread_; // 自动训练的后台线程
+    std::vector<float> pending_vectors_; // 训练前缓存的向量
+    std::vector<long> pending_ids_; // 训练前缓存的向量 ID
+    std::string ondisk_invlists_path_; // 为空时倒排表保存在内存中，否则作为各层倒排表文件的路径前缀
+    hnswlib::MemoryPolicy memory_policy_;
+    const uint8_t* policy_codes_ = nullptr; // 最近一次应用内存策略的编码缓冲区
+    mutable std::mutex train_mutex_; // 保护训练缓存、trained_ 的修改和磁盘倒排表路径
+    mutable std::shared_mutex index_mutex_; // 检索共享；写入、删除、训练和加载独占，检索时索引不会被修改或替换。与 train_mutex_ 同时持有时先获取 index_mutex_
+    std::mutex snapshot_mutex_; // 串行化快照写入，在共享持有 index_mutex_ 之后获取
 };
\ No newline at end of file
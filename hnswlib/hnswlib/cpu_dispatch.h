@@ -0,0 +1,421 @@
+#pragma once
+#include "hnswlib.h"
+
+// Runtime CPU dispatch for the distance kernels.
+// The USE_AVX/USE_AVX512 kernels are only compiled when the whole build targets
+// those instruction sets. The kernels below carry per-function target attributes
+// instead, so a binary built for baseline x86-64 still runs AVX2+FMA, AVX-512 or
+// AVX-512 VNNI code on hosts that support it. The level is detected from CPUID
+// once and the spaces pick their kernel from it at construction time.
+
+#if defined(USE_SSE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HNSWLIB_RUNTIME_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace hnswlib {
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE = 1,
+    SIMD_AVX2 = 2,          // AVX2 + FMA
+    SIMD_AVX512 = 3,        // AVX-512F
+    SIMD_AVX512_VNNI = 4    // AVX-512F + BW + VL + VNNI, used by the int8 kernel
+};
+
+static inline const char *
+simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE: return "SSE";
+        case SIMD_AVX2: return "AVX2+FMA";
+        case SIMD_AVX512: return "AVX-512";
+        case SIMD_AVX512_VNNI: return "AVX-512 VNNI";
+        default: return "scalar";
+    }
+}
+
+static SimdLevel
+detectSimdLevel() {
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    if (!AVX2Capable())
+        return SIMD_SSE;
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000001, 0);
+    if ((cpuInfo[2] & ((int)1 << 12)) == 0)  // FMA3
+        return SIMD_SSE;
+    if (!AVX512Capable())
+        return SIMD_AVX2;
+    cpuid(cpuInfo, 0x00000007, 0);
+    bool avx512bw = (cpuInfo[1] & ((int)1 << 30)) != 0;
+    bool avx512vl = (cpuInfo[1] & ((int)1 << 31)) != 0;
+    bool avx512vnni = (cpuInfo[2] & ((int)1 << 11)) != 0;
+    return avx512bw && avx512vl && avx512vnni ? SIMD_AVX512_VNNI : SIMD_AVX512;
+#elif defined(USE_AVX512)
+    return AVX512Capable() ? SIMD_AVX512 : AVXCapable() ? SIMD_AVX2 : SIMD_SSE;
+#elif defined(USE_AVX)
+    return AVXCapable() ? SIMD_AVX2 : SIMD_SSE;
+#elif defined(USE_SSE)
+    return SIMD_SSE;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+// Best instruction set usable by the distance kernels on this host
+static SimdLevel
+getSimdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+
+__attribute__((target("avx2,fma"))) static inline float
+reduceAddAVX2(__m256 sum) {
+    __m128 sum128 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    sum128 = _mm_add_ps(sum128, _mm_movehl_ps(sum128, sum128));
+    sum128 = _mm_add_ss(sum128, _mm_shuffle_ps(sum128, sum128, 1));
+    return _mm_cvtss_f32(sum128);
+}
+
+__attribute__((target("avx2,fma"))) static float
+L2SqrDispatchAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= qty; i += 16) {
+        __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8));
+        sum0 = _mm256_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+    }
+    if (i + 8 <= qty) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        sum0 = _mm256_fmadd_ps(diff, diff, sum0);
+        i += 8;
+    }
+    float res = reduceAddAVX2(_mm256_add_ps(sum0, sum1));
+    for (; i < qty; i++) {
+        float t = pVect1[i] - pVect2[i];
+        res += t * t;
+    }
+    return res;
+}
+
+__attribute__((target("avx2,fma"))) static float
+InnerProductDispatchAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= qty; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8), sum1);
+    }
+    if (i + 8 <= qty) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i), sum0);
+        i += 8;
+    }
+    float res = reduceAddAVX2(_mm256_add_ps(sum0, sum1));
+    for (; i < qty; i++) {
+        res += pVect1[i] * pVect2[i];
+    }
+    return res;
+}
+
+__attribute__((target("avx2,fma"))) static float
+InnerProductDistanceDispatchAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductDispatchAVX2(pVect1v, pVect2v, qty_ptr);
+}
+
+// The tail is handled with a masked load, so any dimension stays in vector code
+__attribute__((target("avx512f"))) static float
+L2SqrDispatchAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= qty; i += 32) {
+        __m512 diff0 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i));
+        __m512 diff1 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16));
+        sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+    }
+    for (; i < qty; i += 16) {
+        __mmask16 mask = qty - i >= 16 ? (__mmask16) 0xFFFF : (__mmask16) ((1u << (qty - i)) - 1);
+        __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, pVect1 + i), _mm512_maskz_loadu_ps(mask, pVect2 + i));
+        sum0 = _mm512_fmadd_ps(diff, diff, sum0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f"))) static float
+InnerProductDispatchAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= qty; i += 32) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16), sum1);
+    }
+    for (; i < qty; i += 16) {
+        __mmask16 mask = qty - i >= 16 ? (__mmask16) 0xFFFF : (__mmask16) ((1u << (qty - i)) - 1);
+        sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, pVect1 + i), _mm512_maskz_loadu_ps(mask, pVect2 + i), sum0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f"))) static float
+InnerProductDistanceDispatchAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductDispatchAVX512(pVect1v, pVect2v, qty_ptr);
+}
+
+// 8-bit kernels for L2SpaceI: bytes are widened to 16 bits and the squared
+// differences are accumulated in 32-bit lanes
+__attribute__((target("avx2"))) static int
+L2SqrIDispatchAVX2(const void *__restrict pVect1v, const void *__restrict pVect2v, const void *__restrict qty_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= qty; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m256i diff = _mm256_sub_epi16(va, vb);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff, diff));
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    int res = _mm_cvtsi128_si32(sum128);
+    for (; i < qty; i++) {
+        int t = (int) a[i] - (int) b[i];
+        res += t * t;
+    }
+    return res;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static int
+L2SqrIDispatchAVX512VNNI(const void *__restrict pVect1v, const void *__restrict pVect2v, const void *__restrict qty_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty; i += 32) {
+        __mmask32 mask = qty - i >= 32 ? (__mmask32) 0xFFFFFFFF : (__mmask32) ((1u << (qty - i)) - 1);
+        __m512i va = _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, a + i));
+        __m512i vb = _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, b + i));
+        __m512i diff = _mm512_sub_epi16(va, vb);
+        sum = _mm512_dpwssd_epi32(sum, diff, diff);
+    }
+    return _mm512_reduce_add_epi32(sum);
+}
+
+// Kernels for the production dimensions. DIM is a compile-time constant, so
+// there is no residual handling and the trip count is known to the compiler.
+// Four independent accumulators hide the add/FMA latency; forcing a full unroll
+// was measured slower for the larger dimensions because of the code size.
+#define HNSWLIB_FIXED_DIMS(KERNEL, dim) \
+    switch (dim) { \
+        case 128: return KERNEL<128>; \
+        case 384: return KERNEL<384>; \
+        case 768: return KERNEL<768>; \
+        case 1024: return KERNEL<1024>; \
+        case 1536: return KERNEL<1536>; \
+        default: break; \
+    }
+
+template <size_t DIM>
+static float
+L2SqrFixedSSE(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 16) {
+        __m128 diff0 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i), _mm_loadu_ps(pVect2 + i));
+        __m128 diff1 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 4), _mm_loadu_ps(pVect2 + i + 4));
+        __m128 diff2 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 8), _mm_loadu_ps(pVect2 + i + 8));
+        __m128 diff3 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 12), _mm_loadu_ps(pVect2 + i + 12));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(diff0, diff0));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(diff1, diff1));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(diff2, diff2));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(diff3, diff3));
+    }
+    float PORTABLE_ALIGN32 TmpRes[4];
+    _mm_store_ps(TmpRes, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+}
+
+template <size_t DIM>
+static float
+InnerProductDistanceFixedSSE(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 16) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(pVect1 + i), _mm_loadu_ps(pVect2 + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 4), _mm_loadu_ps(pVect2 + i + 4)));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 8), _mm_loadu_ps(pVect2 + i + 8)));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 12), _mm_loadu_ps(pVect2 + i + 12)));
+    }
+    float PORTABLE_ALIGN32 TmpRes[4];
+    _mm_store_ps(TmpRes, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+    return 1.0f - (TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3]);
+}
+
+template <size_t DIM>
+__attribute__((target("avx2,fma"))) static float
+L2SqrFixedAVX2(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 32) {
+        __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8));
+        __m256 diff2 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 16), _mm256_loadu_ps(pVect2 + i + 16));
+        __m256 diff3 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 24), _mm256_loadu_ps(pVect2 + i + 24));
+        sum0 = _mm256_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+        sum2 = _mm256_fmadd_ps(diff2, diff2, sum2);
+        sum3 = _mm256_fmadd_ps(diff3, diff3, sum3);
+    }
+    return reduceAddAVX2(_mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+}
+
+template <size_t DIM>
+__attribute__((target("avx2,fma"))) static float
+InnerProductDistanceFixedAVX2(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 32) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i + 16), _mm256_loadu_ps(pVect2 + i + 16), sum2);
+        sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i + 24), _mm256_loadu_ps(pVect2 + i + 24), sum3);
+    }
+    return 1.0f - reduceAddAVX2(_mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+}
+
+template <size_t DIM>
+__attribute__((target("avx512f"))) static float
+L2SqrFixedAVX512(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    __m512 sum3 = _mm512_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 64) {
+        __m512 diff0 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i));
+        __m512 diff1 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16));
+        __m512 diff2 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 32), _mm512_loadu_ps(pVect2 + i + 32));
+        __m512 diff3 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 48), _mm512_loadu_ps(pVect2 + i + 48));
+        sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+        sum2 = _mm512_fmadd_ps(diff2, diff2, sum2);
+        sum3 = _mm512_fmadd_ps(diff3, diff3, sum3);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum0, sum1), _mm512_add_ps(sum2, sum3)));
+}
+
+template <size_t DIM>
+__attribute__((target("avx512f"))) static float
+InnerProductDistanceFixedAVX512(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    __m512 sum3 = _mm512_setzero_ps();
+    for (size_t i = 0; i < DIM; i += 64) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16), sum1);
+        sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 32), _mm512_loadu_ps(pVect2 + i + 32), sum2);
+        sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 48), _mm512_loadu_ps(pVect2 + i + 48), sum3);
+    }
+    return 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum0, sum1), _mm512_add_ps(sum2, sum3)));
+}
+
+#endif
+
+// Kernel for the given level, or nullptr when the space should keep its
+// compile-time selection. Dimensions with a specialized kernel get it at
+// every level from SSE up.
+static DISTFUNC<float>
+dispatchL2Sqr(SimdLevel level, size_t dim = 0) {
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    if (level >= SIMD_AVX512) {
+        HNSWLIB_FIXED_DIMS(L2SqrFixedAVX512, dim)
+        return L2SqrDispatchAVX512;
+    }
+    if (level >= SIMD_AVX2) {
+        HNSWLIB_FIXED_DIMS(L2SqrFixedAVX2, dim)
+        return L2SqrDispatchAVX2;
+    }
+    if (level >= SIMD_SSE) {
+        HNSWLIB_FIXED_DIMS(L2SqrFixedSSE, dim)
+    }
+#endif
+    return nullptr;
+}
+
+static DISTFUNC<float>
+dispatchInnerProductDistance(SimdLevel level, size_t dim = 0) {
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    if (level >= SIMD_AVX512) {
+        HNSWLIB_FIXED_DIMS(InnerProductDistanceFixedAVX512, dim)
+        return InnerProductDistanceDispatchAVX512;
+    }
+    if (level >= SIMD_AVX2) {
+        HNSWLIB_FIXED_DIMS(InnerProductDistanceFixedAVX2, dim)
+        return InnerProductDistanceDispatchAVX2;
+    }
+    if (level >= SIMD_SSE) {
+        HNSWLIB_FIXED_DIMS(InnerProductDistanceFixedSSE, dim)
+    }
+#endif
+    return nullptr;
+}
+
+static DISTFUNC<int>
+dispatchL2SqrI(SimdLevel level) {
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    if (level >= SIMD_AVX512_VNNI)
+        return L2SqrIDispatchAVX512VNNI;
+    if (level >= SIMD_AVX2)
+        return L2SqrIDispatchAVX2;
+#endif
+    return nullptr;
+}
+
+}  // namespace hnswlib
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "visited_list_pool.h"
+#include "spin_lock.h"
+#include "label_map.h"
+#include "memory_policy.h"
 #include "hnswlib.h"
 #include <atomic>
 #include <random>
@@ -9,11 +12,37 @@
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HNSWLIB_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace hnswlib {
 typedef unsigned int tableint;
 typedef unsigned int linklistsizeint;
 
+// Page cache warmup performed by loadIndexMapped
+enum MmapWarmup {
+    MMAP_WARMUP_NONE = 0,      // pages are faulted in lazily by searches
+    MMAP_WARMUP_WILLNEED = 1,  // asynchronous readahead with madvise(MADV_WILLNEED)
+    MMAP_WARMUP_POPULATE = 2   // synchronous prefault with MAP_POPULATE
+};
+
+// Node orderings used by reorderGraph
+enum GraphReorder {
+    REORDER_BFS = 0,  // breadth-first order from the entry point
+    REORDER_RCM = 1   // reverse Cuthill-McKee, lower bandwidth of the level 0 adjacency
+};
+
+static const uint64_t MAPPED_INDEX_MAGIC = 0x50414d4d57534e48ULL;  // "HNSWMMAP"
+static const uint64_t MAPPED_INDEX_VERSION = 1;
+static const size_t MAPPED_INDEX_ALIGNMENT = 4096;
+
 template<typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
@@ -35,12 +64,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     int maxlevel_{0};
 
     std::unique_ptr<VisitedListPool> visited_list_pool_{nullptr};
+    bool compact_visited_lists_{false};  // hash-set visited lists instead of max_elements_ sized arrays
 
     // Locks operations with element by label value
     mutable std::vector<std::mutex> label_op_locks_;
 
     std::mutex global;
-    std::vector<std::mutex> link_list_locks_;
+    std::vector<SpinLock> link_list_locks_;
+    std::atomic<int> active_writers_{0};  // number of addPoint calls in progress
+    std::atomic<bool> single_writer_{false};  // set by setSingleWriter, addPoint calls never overlap
 
     tableint enterpoint_node_{0};
 
@@ -49,6 +81,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     char *data_level0_memory_{nullptr};
     char **linkLists_{nullptr};
+    size_t level0_mapped_size_{0};  // size of the mapping behind data_level0_memory_, 0 if malloc'ed
+    MemoryPolicy memory_policy_;  // huge pages and NUMA placement of the base layer
+    char *links_arena_{nullptr};  // mapped upper level links of a loadIndexMapped index
+    size_t links_arena_size_{0};
     std::vector<int> element_levels_;  // keeps level of each element
 
     size_t data_size_{0};
@@ -56,8 +92,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     DISTFUNC<dist_t> fstdistfunc_;
     void *dist_func_param_{nullptr};
 
-    mutable std::mutex label_lookup_lock;  // lock for label_lookup_
-    std::unordered_map<labeltype, tableint> label_lookup_;
+    mutable std::mutex label_lookup_lock;  // serializes writers of label_lookup_, lookups are lock-free
+    LabelMap<labeltype, tableint> label_lookup_;
 
     std::default_random_engine level_generator_;
     std::default_random_engine update_probability_generator_;
@@ -123,13 +159,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         label_offset_ = size_links_level0_ + data_size_;
         offsetLevel0_ = 0;
 
-        data_level0_memory_ = (char *) malloc(max_elements_ * size_data_per_element_);
+        data_level0_memory_ = allocateLevel0Memory(max_elements_ * size_data_per_element_, level0_mapped_size_);
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory");
 
         cur_element_count = 0;
 
-        visited_list_pool_ = std::unique_ptr<VisitedListPool>(new VisitedListPool(1, max_elements));
+        visited_list_pool_ = std::unique_ptr<VisitedListPool>(new VisitedListPool(1, max_elements, compact_visited_lists_));
 
         // initializations for special treatment of the first node
         enterpoint_node_ = -1;
@@ -149,14 +185,20 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
     void clear() {
-        free(data_level0_memory_);
+        freeLevel0Memory();
         data_level0_memory_ = nullptr;
         for (tableint i = 0; i < cur_element_count; i++) {
-            if (element_levels_[i] > 0)
+            if (element_levels_[i] > 0 && !isInLinksArena(linkLists_[i]))
                 free(linkLists_[i]);
         }
         free(linkLists_);
         linkLists_ = nullptr;
+#ifdef HNSWLIB_USE_MMAP
+        if (links_arena_ != nullptr)
+            munmap(links_arena_, links_arena_size_);
+#endif
+        links_arena_ = nullptr;
+        links_arena_size_ = 0;
         cur_element_count = 0;
         visited_list_pool_.reset(nullptr);
     }
@@ -175,6 +217,29 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Compact visited lists keep the ids visited by a query in a small hash set, so their
+    * memory depends on the search size rather than on max_elements_. Slower per visit,
+    * meant for very large indexes with many search threads.
+    * Must not be called concurrently with searches or inserts.
+    */
+    /*
+    * In single writer mode the caller promises that addPoint is never called from two threads
+    * at once, so the insertion search reads link lists without taking their locks. Searches may
+    * still run concurrently, they never modify links. Switch the mode only while no addPoint is
+    * running; an addPoint that overlaps another one in this mode throws instead of racing.
+    */
+    void setSingleWriter(bool single_writer) {
+        single_writer_ = single_writer;
+    }
+
+
+    void setCompactVisitedLists(bool compact) {
+        compact_visited_lists_ = compact;
+        visited_list_pool_.reset(new VisitedListPool(1, max_elements_, compact));
+    }
+
+
     inline std::mutex& getLabelOpMutex(labeltype label) const {
         // calculate hash
         size_t lock_id = label & (MAX_LABEL_OPERATION_LOCKS - 1);
@@ -224,9 +289,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayer(tableint ep_id, const void *data_point, int layer) {
+        const bool lock_links = !single_writer_.load(std::memory_order_acquire);
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
-        vl_type *visited_array = vl->mass;
-        vl_type visited_array_tag = vl->curV;
+        vl_type *visited_array = vl->mass;  // nullptr for compact visited lists, used for prefetching only
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidateSet;
@@ -241,7 +306,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             lowerBound = std::numeric_limits<dist_t>::max();
             candidateSet.emplace(-lowerBound, ep_id);
         }
-        visited_array[ep_id] = visited_array_tag;
+        vl->visit(ep_id);
 
         while (!candidateSet.empty()) {
             std::pair<dist_t, tableint> curr_el_pair = candidateSet.top();
@@ -252,7 +317,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             tableint curNodeNum = curr_el_pair.second;
 
-            std::unique_lock <std::mutex> lock(link_list_locks_[curNodeNum]);
+            // In single writer mode nobody else modifies the links
+            std::unique_lock <SpinLock> lock(link_list_locks_[curNodeNum], std::defer_lock);
+            if (lock_links)
+                lock.lock();
 
             int *data;  // = (int *)(linkList0_ + curNodeNum * size_links_per_element0_);
             if (layer == 0) {
@@ -264,8 +332,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             size_t size = getListCount((linklistsizeint*)data);
             tableint *datal = (tableint *) (data + 1);
 #ifdef USE_SSE
-            _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
-            _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
+            if (visited_array) {
+                _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
+                _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
+            }
             _mm_prefetch(getDataByInternalId(*datal), _MM_HINT_T0);
             _mm_prefetch(getDataByInternalId(*(datal + 1)), _MM_HINT_T0);
 #endif
@@ -274,11 +344,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 tableint candidate_id = *(datal + j);
 //                    if (candidate_id == 0) continue;
 #ifdef USE_SSE
-                _mm_prefetch((char *) (visited_array + *(datal + j + 1)), _MM_HINT_T0);
+                if (visited_array)
+                    _mm_prefetch((char *) (visited_array + *(datal + j + 1)), _MM_HINT_T0);
                 _mm_prefetch(getDataByInternalId(*(datal + j + 1)), _MM_HINT_T0);
 #endif
-                if (visited_array[candidate_id] == visited_array_tag) continue;
-                visited_array[candidate_id] = visited_array_tag;
+                if (!vl->visit(candidate_id)) continue;
                 char *currObj1 = (getDataByInternalId(candidate_id));
 
                 dist_t dist1 = fstdistfunc_(data_point, currObj1, dist_func_param_);
@@ -315,8 +385,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         BaseFilterFunctor* isIdAllowed = nullptr,
         BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
-        vl_type *visited_array = vl->mass;
-        vl_type visited_array_tag = vl->curV;
+        vl_type *visited_array = vl->mass;  // nullptr for compact visited lists, used for prefetching only
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
@@ -337,7 +406,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             candidate_set.emplace(-lowerBound, ep_id);
         }
 
-        visited_array[ep_id] = visited_array_tag;
+        vl->visit(ep_id);
 
         while (!candidate_set.empty()) {
             std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
@@ -368,8 +437,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
 
 #ifdef USE_SSE
-            _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
-            _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
+            if (visited_array) {
+                _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
+                _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
+            }
             _mm_prefetch(data_level0_memory_ + (*(data + 1)) * size_data_per_element_ + offsetData_, _MM_HINT_T0);
             _mm_prefetch((char *) (data + 2), _MM_HINT_T0);
 #endif
@@ -378,12 +449,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 int candidate_id = *(data + j);
 //                    if (candidate_id == 0) continue;
 #ifdef USE_SSE
-                _mm_prefetch((char *) (visited_array + *(data + j + 1)), _MM_HINT_T0);
+                if (visited_array)
+                    _mm_prefetch((char *) (visited_array + *(data + j + 1)), _MM_HINT_T0);
                 _mm_prefetch(data_level0_memory_ + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
                                 _MM_HINT_T0);  ////////////
 #endif
-                if (!(visited_array[candidate_id] == visited_array_tag)) {
-                    visited_array[candidate_id] = visited_array_tag;
+                if (vl->visit(candidate_id)) {
 
                     char *currObj1 = (getDataByInternalId(candidate_id));
                     dist_t dist = fstdistfunc_(data_point, currObj1, dist_func_param_);
@@ -526,7 +597,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         {
             // lock only during the update
             // because during the addition the lock for cur_c is already acquired
-            std::unique_lock <std::mutex> lock(link_list_locks_[cur_c], std::defer_lock);
+            std::unique_lock <SpinLock> lock(link_list_locks_[cur_c], std::defer_lock);
             if (isUpdate) {
                 lock.lock();
             }
@@ -552,7 +623,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-            std::unique_lock <std::mutex> lock(link_list_locks_[selectedNeighbors[idx]]);
+            std::unique_lock <SpinLock> lock(link_list_locks_[selectedNeighbors[idx]]);
 
             linklistsizeint *ll_other;
             if (level == 0)
@@ -634,17 +705,30 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (new_max_elements < cur_element_count)
             throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
 
-        visited_list_pool_.reset(new VisitedListPool(1, new_max_elements));
+        visited_list_pool_.reset(new VisitedListPool(1, new_max_elements, compact_visited_lists_));
 
         element_levels_.resize(new_max_elements);
 
-        std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
+        std::vector<SpinLock>(new_max_elements).swap(link_list_locks_);
+        label_lookup_.release_retired();
 
         // Reallocate base layer
-        char * data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
-        if (data_level0_memory_new == nullptr)
-            throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
-        data_level0_memory_ = data_level0_memory_new;
+        if (level0_mapped_size_ == 0 && memory_policy_.isDefault()) {
+            char * data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
+            if (data_level0_memory_new == nullptr)
+                throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
+            data_level0_memory_ = data_level0_memory_new;
+        } else {
+            // A mapped base layer cannot be realloc'ed, copy it to a new allocation
+            size_t mapped_size_new;
+            char * data_level0_memory_new = allocateLevel0Memory(new_max_elements * size_data_per_element_, mapped_size_new);
+            if (data_level0_memory_new == nullptr)
+                throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
+            memcpy(data_level0_memory_new, data_level0_memory_, cur_element_count * size_data_per_element_);
+            freeLevel0Memory();
+            data_level0_memory_ = data_level0_memory_new;
+            level0_mapped_size_ = mapped_size_new;
+        }
 
         // Reallocate all other layers
         char ** linkLists_new = (char **) realloc(linkLists_, sizeof(void *) * new_max_elements);
@@ -774,7 +858,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         input.seekg(pos, input.beg);
 
-        data_level0_memory_ = (char *) malloc(max_elements * size_data_per_element_);
+        data_level0_memory_ = allocateLevel0Memory(max_elements * size_data_per_element_, level0_mapped_size_);
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
         input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
@@ -782,10 +866,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
 
         size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
+        std::vector<SpinLock>(max_elements).swap(link_list_locks_);
         std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
 
-        visited_list_pool_.reset(new VisitedListPool(1, max_elements));
+        visited_list_pool_.reset(new VisitedListPool(1, max_elements, compact_visited_lists_));
 
         linkLists_ = (char **) malloc(sizeof(void *) * max_elements);
         if (linkLists_ == nullptr)
@@ -793,8 +877,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         element_levels_ = std::vector<int>(max_elements);
         revSize_ = 1.0 / mult_;
         ef_ = 10;
+        label_lookup_.reserve(cur_element_count);
         for (size_t i = 0; i < cur_element_count; i++) {
-            label_lookup_[getExternalLabel(i)] = i;
+            label_lookup_.insert_or_assign(getExternalLabel(i), i);
             unsigned int linkListSize;
             readBinaryPOD(input, linkListSize);
             if (linkListSize == 0) {
@@ -822,18 +907,480 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    bool isInLinksArena(const char *ptr) const {
+        return links_arena_ != nullptr && ptr >= links_arena_ && ptr < links_arena_ + links_arena_size_;
+    }
+
+
+    char *allocateLevel0Memory(size_t size, size_t &mapped_size) const {
+        return (char *) allocateLargeBuffer(size, memory_policy_, mapped_size);
+    }
+
+
+    /*
+    * Places the base layer on huge pages and/or a NUMA node. The current base layer is
+    * moved to a new allocation, later allocations (resizeIndex, loadIndex) follow the policy.
+    * loadIndexMapped applies it to the mapping in place instead.
+    * Not thread safe: no other operation may run on the index meanwhile.
+    */
+    void setMemoryPolicy(const MemoryPolicy &policy) {
+        if (!policy.isValid())
+            throw std::runtime_error("setMemoryPolicy: NUMA node must be in [0, " + std::to_string(MAX_NUMA_NODES) + ")");
+        memory_policy_ = policy;
+        if (data_level0_memory_ == nullptr)
+            return;
+        size_t mapped_size_new;
+        char *data_level0_memory_new = allocateLevel0Memory(max_elements_ * size_data_per_element_, mapped_size_new);
+        if (data_level0_memory_new == nullptr)
+            throw std::runtime_error("Not enough memory: setMemoryPolicy failed to allocate base layer");
+        memcpy(data_level0_memory_new, data_level0_memory_, cur_element_count * size_data_per_element_);
+        freeLevel0Memory();
+        data_level0_memory_ = data_level0_memory_new;
+        level0_mapped_size_ = mapped_size_new;
+    }
+
+
+    void freeLevel0Memory() {
+#ifdef HNSWLIB_USE_MMAP
+        if (level0_mapped_size_ != 0) {
+            munmap(data_level0_memory_, level0_mapped_size_);
+            level0_mapped_size_ = 0;
+            return;
+        }
+#endif
+        free(data_level0_memory_);
+    }
+
+
+    static bool isMappedIndexFile(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        uint64_t magic = 0;
+        if (!input.is_open())
+            return false;
+        readBinaryPOD(input, magic);
+        return input.good() && magic == MAPPED_INDEX_MAGIC;
+    }
+
+
+    /*
+    * Saves the index in a format that loadIndexMapped can mmap directly:
+    * a header page, the page-aligned level 0 block, the element levels, labels and
+    * deleted ids, and all upper level links in one page-aligned arena.
+    * The file is written next to location and renamed over it, so an index that is
+    * currently mapped from location stays valid.
+    */
+    void saveIndexMapped(const std::string &location) {
+        size_t element_count = cur_element_count;
+        uint64_t num_deleted = 0;
+        uint64_t arena_size = 0;
+        for (size_t i = 0; i < element_count; i++) {
+            if (isMarkedDeleted(i))
+                num_deleted++;
+            arena_size += element_levels_[i] > 0 ? size_links_per_element_ * element_levels_[i] : 0;
+        }
+
+        uint64_t level0_offset = MAPPED_INDEX_ALIGNMENT;
+        uint64_t levels_offset = level0_offset + element_count * size_data_per_element_;
+        uint64_t labels_offset = levels_offset + element_count * sizeof(int);
+        uint64_t deleted_offset = labels_offset + element_count * sizeof(labeltype);
+        uint64_t arena_offset = deleted_offset + num_deleted * sizeof(tableint);
+        arena_offset = (arena_offset + MAPPED_INDEX_ALIGNMENT - 1) / MAPPED_INDEX_ALIGNMENT * MAPPED_INDEX_ALIGNMENT;
+
+        std::string tmp_location = location + ".tmp";
+        std::ofstream output(tmp_location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        writeBinaryPOD(output, MAPPED_INDEX_MAGIC);
+        writeBinaryPOD(output, MAPPED_INDEX_VERSION);
+        writeBinaryPOD(output, offsetLevel0_);
+        writeBinaryPOD(output, max_elements_);
+        writeBinaryPOD(output, element_count);
+        writeBinaryPOD(output, size_data_per_element_);
+        writeBinaryPOD(output, label_offset_);
+        writeBinaryPOD(output, offsetData_);
+        writeBinaryPOD(output, maxlevel_);
+        writeBinaryPOD(output, enterpoint_node_);
+        writeBinaryPOD(output, maxM_);
+        writeBinaryPOD(output, maxM0_);
+        writeBinaryPOD(output, M_);
+        writeBinaryPOD(output, mult_);
+        writeBinaryPOD(output, ef_construction_);
+        writeBinaryPOD(output, level0_offset);
+        writeBinaryPOD(output, levels_offset);
+        writeBinaryPOD(output, labels_offset);
+        writeBinaryPOD(output, deleted_offset);
+        writeBinaryPOD(output, num_deleted);
+        writeBinaryPOD(output, arena_offset);
+        writeBinaryPOD(output, arena_size);
+
+        std::vector<char> padding(MAPPED_INDEX_ALIGNMENT, 0);
+        output.write(padding.data(), level0_offset - output.tellp());
+        output.write(data_level0_memory_, element_count * size_data_per_element_);
+        output.write((char *) element_levels_.data(), element_count * sizeof(int));
+        for (size_t i = 0; i < element_count; i++) {
+            labeltype label = getExternalLabel(i);
+            writeBinaryPOD(output, label);
+        }
+        for (size_t i = 0; i < element_count; i++) {
+            if (isMarkedDeleted(i)) {
+                tableint id = i;
+                writeBinaryPOD(output, id);
+            }
+        }
+        output.write(padding.data(), arena_offset - output.tellp());
+        for (size_t i = 0; i < element_count; i++) {
+            if (element_levels_[i] > 0)
+                output.write(linkLists_[i], size_links_per_element_ * element_levels_[i]);
+        }
+        output.close();
+        if (!output)
+            throw std::runtime_error("Failed to write index file");
+
+        if (rename(tmp_location.c_str(), location.c_str()) != 0)
+            throw std::runtime_error("Failed to rename index file");
+    }
+
+
+    /*
+    * Loads an index written by saveIndexMapped without reading it through a stream.
+    * The level 0 block is mapped copy-on-write into a region reserved for max_elements,
+    * so the index stays writable and new elements go after the mapped ones. Upper level
+    * links point into a single mapped arena. Only levels, labels and deleted ids are read.
+    * The memory policy is applied to the reserved region in place, keeping the startup
+    * cost: pages still shared with the page cache keep their placement and page size,
+    * the policy takes effect as they are copied on write and for new elements.
+    */
+    void loadIndexMapped(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i = 0,
+                         MmapWarmup warmup = MMAP_WARMUP_NONE) {
+#ifdef HNSWLIB_USE_MMAP
+        // The file and the mappings are released on every error path; the index is only
+        // modified once the whole file has been mapped, read and validated
+        struct FileGuard {
+            int fd;
+            ~FileGuard() { if (fd >= 0) close(fd); }
+        };
+        struct MappingGuard {
+            void *addr{nullptr};
+            size_t size{0};
+            ~MappingGuard() { if (addr != nullptr) munmap(addr, size); }
+            void *release() { void *mapped = addr; addr = nullptr; return mapped; }
+        };
+
+        FileGuard file{open(location.c_str(), O_RDONLY)};
+        if (file.fd < 0)
+            throw std::runtime_error("Cannot open file");
+        struct stat st;
+        if (fstat(file.fd, &st) != 0)
+            throw std::runtime_error("Cannot stat file");
+
+        std::ifstream input(location, std::ios::binary);
+        uint64_t magic, version;
+        uint64_t level0_offset, levels_offset, labels_offset, deleted_offset, num_deleted, arena_offset, arena_size;
+        size_t offset_level0, stored_max_elements, element_count, size_data_per_element, label_offset, offset_data;
+        size_t max_m, max_m0, m, ef_construction;
+        int max_level;
+        tableint enterpoint_node;
+        double mult;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, version);
+        if (magic != MAPPED_INDEX_MAGIC || version != MAPPED_INDEX_VERSION)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        readBinaryPOD(input, offset_level0);
+        readBinaryPOD(input, stored_max_elements);
+        readBinaryPOD(input, element_count);
+        readBinaryPOD(input, size_data_per_element);
+        readBinaryPOD(input, label_offset);
+        readBinaryPOD(input, offset_data);
+        readBinaryPOD(input, max_level);
+        readBinaryPOD(input, enterpoint_node);
+        readBinaryPOD(input, max_m);
+        readBinaryPOD(input, max_m0);
+        readBinaryPOD(input, m);
+        readBinaryPOD(input, mult);
+        readBinaryPOD(input, ef_construction);
+        readBinaryPOD(input, level0_offset);
+        readBinaryPOD(input, levels_offset);
+        readBinaryPOD(input, labels_offset);
+        readBinaryPOD(input, deleted_offset);
+        readBinaryPOD(input, num_deleted);
+        readBinaryPOD(input, arena_offset);
+        readBinaryPOD(input, arena_size);
+        if (!input || arena_offset + arena_size != (uint64_t) st.st_size || stored_max_elements < element_count)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        size_t max_elements = max_elements_i;
+        if (max_elements < element_count)
+            max_elements = stored_max_elements;
+        size_t size_links_per_element = max_m * sizeof(tableint) + sizeof(linklistsizeint);
+
+        // Levels, labels and deleted ids, checked against the size of the links arena
+        std::vector<int> element_levels(max_elements);
+        input.seekg(levels_offset, input.beg);
+        input.read((char *) element_levels.data(), element_count * sizeof(int));
+        std::vector<labeltype> labels(element_count);
+        input.seekg(labels_offset, input.beg);
+        input.read((char *) labels.data(), element_count * sizeof(labeltype));
+        std::vector<tableint> deleted(num_deleted);
+        input.seekg(deleted_offset, input.beg);
+        input.read((char *) deleted.data(), num_deleted * sizeof(tableint));
+        if (!input)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        uint64_t arena_pos = 0;
+        for (size_t i = 0; i < element_count; i++) {
+            if (element_levels[i] < 0)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            arena_pos += size_links_per_element * element_levels[i];
+        }
+        if (arena_pos != arena_size)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        int map_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (warmup == MMAP_WARMUP_POPULATE)
+            map_flags |= MAP_POPULATE;
+#endif
+
+        // Reserve the whole base layer, then map the stored elements over its beginning
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t level0_size = element_count * size_data_per_element;
+        size_t reserved_size = std::max(max_elements * size_data_per_element, (size_t) 1);
+        reserved_size = (reserved_size + page_size - 1) / page_size * page_size;
+        MappingGuard level0;
+        level0.addr = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (level0.addr == MAP_FAILED) {
+            level0.addr = nullptr;
+            throw std::runtime_error("Not enough memory: loadIndexMapped failed to reserve level0");
+        }
+        level0.size = reserved_size;
+        if (level0_size > 0 &&
+            mmap(level0.addr, level0_size, PROT_READ | PROT_WRITE, map_flags | MAP_FIXED, file.fd, level0_offset) == MAP_FAILED)
+            throw std::runtime_error("loadIndexMapped failed to map level0");
+
+        MappingGuard arena;
+        if (arena_size > 0) {
+            arena.addr = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE, map_flags, file.fd, arena_offset);
+            if (arena.addr == MAP_FAILED) {
+                arena.addr = nullptr;
+                throw std::runtime_error("loadIndexMapped failed to map upper level links");
+            }
+            arena.size = arena_size;
+        }
+
+        char **link_lists = (char **) malloc(sizeof(void *) * max_elements);
+        if (link_lists == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndexMapped failed to allocate linklists");
+        arena_pos = 0;
+        for (size_t i = 0; i < element_count; i++) {
+            if (element_levels[i] > 0) {
+                link_lists[i] = (char *) arena.addr + arena_pos;
+                arena_pos += size_links_per_element * element_levels[i];
+            } else {
+                link_lists[i] = nullptr;
+            }
+        }
+
+        // Everything is in place, replace the current contents of the index
+        clear();
+        label_lookup_.clear();
+        deleted_elements.clear();
+        offsetLevel0_ = offset_level0;
+        max_elements_ = max_elements;
+        size_data_per_element_ = size_data_per_element;
+        label_offset_ = label_offset;
+        offsetData_ = offset_data;
+        maxlevel_ = max_level;
+        enterpoint_node_ = enterpoint_node;
+        maxM_ = max_m;
+        maxM0_ = max_m0;
+        M_ = m;
+        mult_ = mult;
+        ef_construction_ = ef_construction;
+
+        data_size_ = s->get_data_size();
+        fstdistfunc_ = s->get_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        size_links_per_element_ = size_links_per_element;
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+
+        level0_mapped_size_ = level0.size;
+        data_level0_memory_ = (char *) level0.release();
+        applyMemoryPolicy(data_level0_memory_, reserved_size, memory_policy_);
+        links_arena_size_ = arena.size;
+        links_arena_ = (char *) arena.release();
+        linkLists_ = link_lists;
+        element_levels_.swap(element_levels);
+
+        if (warmup == MMAP_WARMUP_WILLNEED) {
+            if (level0_size > 0)
+                madvise(data_level0_memory_, level0_size, MADV_WILLNEED);
+            if (links_arena_ != nullptr)
+                madvise(links_arena_, links_arena_size_, MADV_WILLNEED);
+        }
+
+        std::vector<SpinLock>(max_elements).swap(link_list_locks_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        visited_list_pool_.reset(new VisitedListPool(1, max_elements, compact_visited_lists_));
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+
+        // Labels and deleted ids are stored separately so that the base layer is not touched here
+        label_lookup_.reserve(element_count);
+        for (size_t i = 0; i < element_count; i++) {
+            label_lookup_.insert_or_assign(labels[i], i);
+        }
+        num_deleted_ = num_deleted;
+        if (allow_replace_deleted_)
+            deleted_elements.insert(deleted.begin(), deleted.end());
+
+        cur_element_count = element_count;
+#else
+        throw std::runtime_error("loadIndexMapped is not supported on this platform");
+#endif
+    }
+
+
+    /*
+    * Computes a cache friendly order of the elements from the level 0 graph.
+    * Returns new_id[old_internal_id].
+    */
+    std::vector<tableint> computeGraphOrder(GraphReorder strategy) const {
+        size_t element_count = cur_element_count;
+        std::vector<tableint> order;
+        order.reserve(element_count);
+        std::vector<bool> visited(element_count, false);
+
+        auto degree = [this](tableint id) {
+            return getListCount(get_linklist0(id));
+        };
+
+        // Components are visited from the entry point first, then from any element left over
+        std::vector<tableint> starts;
+        if (element_count > 0 && enterpoint_node_ < element_count)
+            starts.push_back(enterpoint_node_);
+        if (strategy == REORDER_RCM) {
+            // RCM starts every component from a low degree element
+            std::vector<tableint> by_degree(element_count);
+            for (tableint i = 0; i < element_count; i++) by_degree[i] = i;
+            std::stable_sort(by_degree.begin(), by_degree.end(), [&](tableint a, tableint b) {
+                return degree(a) < degree(b);
+            });
+            starts.insert(starts.end(), by_degree.begin(), by_degree.end());
+        } else {
+            for (tableint i = 0; i < element_count; i++) starts.push_back(i);
+        }
+
+        std::vector<tableint> neighbors;
+        for (tableint start : starts) {
+            if (visited[start])
+                continue;
+            visited[start] = true;
+            size_t head = order.size();
+            order.push_back(start);
+            while (head < order.size()) {
+                tableint cur = order[head++];
+                linklistsizeint *ll = get_linklist0(cur);
+                tableint *data = (tableint *) (ll + 1);
+                neighbors.assign(data, data + getListCount(ll));
+                if (strategy == REORDER_RCM) {
+                    std::stable_sort(neighbors.begin(), neighbors.end(), [&](tableint a, tableint b) {
+                        return degree(a) < degree(b);
+                    });
+                }
+                for (tableint neighbor : neighbors) {
+                    if (!visited[neighbor]) {
+                        visited[neighbor] = true;
+                        order.push_back(neighbor);
+                    }
+                }
+            }
+        }
+        if (strategy == REORDER_RCM)
+            std::reverse(order.begin(), order.end());
+
+        std::vector<tableint> new_id(element_count);
+        for (size_t i = 0; i < element_count; i++) {
+            new_id[order[i]] = i;
+        }
+        return new_id;
+    }
+
+
+    /*
+    * Permutes internal ids so that graph neighbors are stored close to each other,
+    * rewriting the base layer, the upper level links and label_lookup_.
+    * The new layout is what saveIndex / saveIndexMapped persist.
+    * Not thread safe: no other operation may run on the index during the reorder.
+    * Returns new_id[old_internal_id].
+    */
+    std::vector<tableint> reorderGraph(GraphReorder strategy = REORDER_BFS) {
+        std::vector<tableint> new_id = computeGraphOrder(strategy);
+        size_t element_count = cur_element_count;
+
+        size_t mapped_size_new;
+        char *data_level0_memory_new = allocateLevel0Memory(max_elements_ * size_data_per_element_, mapped_size_new);
+        if (data_level0_memory_new == nullptr)
+            throw std::runtime_error("Not enough memory: reorderGraph failed to allocate base layer");
+        char **linkLists_new = (char **) malloc(sizeof(void *) * max_elements_);
+        if (linkLists_new == nullptr) {
+            freeLargeBuffer(data_level0_memory_new, mapped_size_new);
+            throw std::runtime_error("Not enough memory: reorderGraph failed to allocate linklists");
+        }
+        std::vector<int> element_levels_new(max_elements_);
+
+        for (tableint old_id = 0; old_id < element_count; old_id++) {
+            tableint id = new_id[old_id];
+            memcpy(data_level0_memory_new + id * size_data_per_element_,
+                   data_level0_memory_ + old_id * size_data_per_element_, size_data_per_element_);
+            linklistsizeint *ll = get_linklist0(id, data_level0_memory_new);
+            tableint *data = (tableint *) (ll + 1);
+            for (size_t j = 0; j < getListCount(ll); j++) {
+                data[j] = new_id[data[j]];
+            }
+
+            linkLists_new[id] = linkLists_[old_id];
+            element_levels_new[id] = element_levels_[old_id];
+            for (int level = 1; level <= element_levels_[old_id]; level++) {
+                ll = get_linklist(old_id, level);
+                data = (tableint *) (ll + 1);
+                for (size_t j = 0; j < getListCount(ll); j++) {
+                    data[j] = new_id[data[j]];
+                }
+            }
+        }
+
+        freeLevel0Memory();
+        data_level0_memory_ = data_level0_memory_new;
+        level0_mapped_size_ = mapped_size_new;
+        free(linkLists_);
+        linkLists_ = linkLists_new;
+        element_levels_.swap(element_levels_new);
+        if (element_count > 0)
+            enterpoint_node_ = new_id[enterpoint_node_];
+
+        for (auto item : label_lookup_) {
+            label_lookup_.insert_or_assign(item.first, new_id[item.second]);
+        }
+        std::unordered_set<tableint> deleted_elements_new;
+        for (tableint id : deleted_elements) {
+            deleted_elements_new.insert(new_id[id]);
+        }
+        deleted_elements.swap(deleted_elements_new);
+        return new_id;
+    }
+
+
     template<typename data_t>
     std::vector<data_t> getDataByLabel(labeltype label) const {
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
-        
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end() || isMarkedDeleted(search->second)) {
             throw std::runtime_error("Label not found");
         }
         tableint internalId = search->second;
-        lock_table.unlock();
 
         char* data_ptrv = getDataByInternalId(internalId);
         size_t dim = *((size_t *) dist_func_param_);
@@ -854,13 +1401,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end()) {
             throw std::runtime_error("Label not found");
         }
         tableint internalId = search->second;
-        lock_table.unlock();
 
         markDeletedInternal(internalId);
     }
@@ -896,13 +1441,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end()) {
             throw std::runtime_error("Label not found");
         }
         tableint internalId = search->second;
-        lock_table.unlock();
 
         unmarkDeletedInternal(internalId);
     }
@@ -951,11 +1494,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * Adds point. Updates the point if it is already in the index.
     * If replacement of deleted elements is enabled: replaces previously deleted point if any, updating it with new point
     */
+    struct ActiveWriterGuard {
+        std::atomic<int> &counter;
+        ActiveWriterGuard(std::atomic<int> &c, bool single_writer) : counter(c) {
+            if (counter.fetch_add(1, std::memory_order_acq_rel) != 0 && single_writer) {
+                counter.fetch_sub(1, std::memory_order_acq_rel);
+                throw std::runtime_error("Concurrent addPoint calls in single writer mode");
+            }
+        }
+        ~ActiveWriterGuard() { counter.fetch_sub(1, std::memory_order_acq_rel); }
+    };
+
+
     void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
         if ((allow_replace_deleted_ == false) && (replace_deleted == true)) {
             throw std::runtime_error("Replacement of deleted elements is disabled in constructor");
         }
 
+        ActiveWriterGuard writer_guard(active_writers_, single_writer_.load(std::memory_order_acquire));
+
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
         if (!replace_deleted) {
@@ -983,7 +1540,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             std::unique_lock <std::mutex> lock_table(label_lookup_lock);
             label_lookup_.erase(label_replaced);
-            label_lookup_[label] = internal_id_replaced;
+            label_lookup_.insert_or_assign(label, internal_id_replaced);
             lock_table.unlock();
 
             unmarkDeletedInternal(internal_id_replaced);
@@ -1053,7 +1610,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 getNeighborsByHeuristic2(candidates, layer == 0 ? maxM0_ : maxM_);
 
                 {
-                    std::unique_lock <std::mutex> lock(link_list_locks_[neigh]);
+                    std::unique_lock <SpinLock> lock(link_list_locks_[neigh]);
                     linklistsizeint *ll_cur;
                     ll_cur = get_linklist_at_level(neigh, layer);
                     size_t candSize = candidates.size();
@@ -1085,7 +1642,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 while (changed) {
                     changed = false;
                     unsigned int *data;
-                    std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                    std::unique_lock <SpinLock> lock(link_list_locks_[currObj]);
                     data = get_linklist_at_level(currObj, level);
                     int size = getListCount(data);
                     tableint *datal = (tableint *) (data + 1);
@@ -1140,7 +1697,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     std::vector<tableint> getConnectionsWithLock(tableint internalId, int level) {
-        std::unique_lock <std::mutex> lock(link_list_locks_[internalId]);
+        std::unique_lock <SpinLock> lock(link_list_locks_[internalId]);
         unsigned int *data = get_linklist_at_level(internalId, level);
         int size = getListCount(data);
         std::vector<tableint> result(size);
@@ -1180,10 +1737,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             cur_c = cur_element_count;
             cur_element_count++;
-            label_lookup_[label] = cur_c;
+            label_lookup_.insert_or_assign(label, cur_c);
         }
 
-        std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
+        std::unique_lock <SpinLock> lock_el(link_list_locks_[cur_c]);
         int curlevel = getRandomLevel(mult_);
         if (level > 0)
             curlevel = level;
@@ -1218,14 +1775,14 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     while (changed) {
                         changed = false;
                         unsigned int *data;
-                        std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                        std::unique_lock <SpinLock> lock(link_list_locks_[currObj]);
                         data = get_linklist(currObj, level);
                         int size = getListCount(data);
 
                         tableint *datal = (tableint *) (data + 1);
                         for (int i = 0; i < size; i++) {
                             tableint cand = datal[i];
-                            if (cand < 0 || cand > max_elements_)
+                            if (cand > max_elements_)
                                 throw std::runtime_error("cand error");
                             dist_t d = fstdistfunc_(data_point, getDataByInternalId(cand), dist_func_param_);
                             if (d < curdist) {
@@ -1269,9 +1826,179 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        return searchKnn(query_data, k, isIdAllowed, ef_);
+    }
+
+
+    /*
+    * Same as searchKnn, with the size of the dynamic candidate list given by the caller
+    * instead of setEf. Concurrent searches can use different ef values this way.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed, size_t ef) const {
+        std::priority_queue<std::pair<dist_t, labeltype >> result;
+        if (cur_element_count == 0) return result;
+
+        tableint currObj = searchUpperLayers(query_data);
+
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        bool bare_bone_search = !num_deleted_ && !isIdAllowed;
+        if (bare_bone_search) {
+            top_candidates = searchBaseLayerST<true>(
+                    currObj, query_data, std::max(ef, k), isIdAllowed);
+        } else {
+            top_candidates = searchBaseLayerST<false>(
+                    currObj, query_data, std::max(ef, k), isIdAllowed);
+        }
+
+        while (top_candidates.size() > k) {
+            top_candidates.pop();
+        }
+        while (top_candidates.size() > 0) {
+            std::pair<dist_t, tableint> rez = top_candidates.top();
+            result.push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
+            top_candidates.pop();
+        }
+        return result;
+    }
+
+
+    /*
+    * Search for restrictive filters, in the spirit of ACORN-1. searchKnn only moves through
+    * graph neighbors and gets stuck when most of them fail the filter. Here only elements
+    * that pass the filter (and are not deleted) enter the queues, and when a neighbor of an
+    * expanded element fails the filter its own neighbors are examined instead (two-hop
+    * expansion). entry_labels are extra entry points, normally sampled from the filter set,
+    * so that the search starts inside the filter set even if there is none of it around the
+    * entry point found on the upper layers. ef = 0 uses the value set by setEf.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnFiltered(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed,
+                      const std::vector<labeltype> &entry_labels = std::vector<labeltype>(), size_t ef = 0) const {
         std::priority_queue<std::pair<dist_t, labeltype >> result;
         if (cur_element_count == 0) return result;
 
+        std::vector<tableint> entry_points(1, searchUpperLayers(query_data));
+        for (labeltype label : entry_labels) {
+            auto search = label_lookup_.find(label);
+            if (search != label_lookup_.end())
+                entry_points.push_back(search->second);
+        }
+
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates =
+            searchBaseLayerFiltered(entry_points, query_data, std::max(ef ? ef : ef_, k), isIdAllowed);
+
+        while (top_candidates.size() > k) {
+            top_candidates.pop();
+        }
+        while (top_candidates.size() > 0) {
+            std::pair<dist_t, tableint> rez = top_candidates.top();
+            result.push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
+            top_candidates.pop();
+        }
+        return result;
+    }
+
+
+    bool isAllowed(tableint internal_id, BaseFilterFunctor* isIdAllowed) const {
+        return !isMarkedDeleted(internal_id) && (!isIdAllowed || (*isIdAllowed)(getExternalLabel(internal_id)));
+    }
+
+
+    // Base layer search of searchKnnFiltered. The expansion of one element is capped at
+    // maxM0_ new elements, like the neighbor list truncation of ACORN. The elements passed
+    // through on the way are not capped: with a cap the third hop only reached the lists of
+    // the first few second-hop elements, and below 0.5% selectivity recall stalled around
+    // 0.7-0.8 whatever the ef.
+    std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+    searchBaseLayerFiltered(
+        const std::vector<tableint> &entry_points,
+        const void *data_point,
+        size_t ef,
+        BaseFilterFunctor* isIdAllowed) const {
+        VisitedList *vl = visited_list_pool_->getFreeVisitedList();
+
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
+        dist_t lowerBound = std::numeric_limits<dist_t>::max();
+
+        for (tableint ep_id : entry_points) {
+            if (!vl->visit(ep_id))
+                continue;
+            dist_t dist = fstdistfunc_(data_point, getDataByInternalId(ep_id), dist_func_param_);
+            // The entry point of the upper layers is expanded even if it fails the filter
+            candidate_set.emplace(-dist, ep_id);
+            if (isAllowed(ep_id, isIdAllowed)) {
+                top_candidates.emplace(dist, ep_id);
+                if (top_candidates.size() > ef)
+                    top_candidates.pop();
+                lowerBound = top_candidates.top().first;
+            }
+        }
+
+        std::vector<tableint> expansion, pass_through, next_pass_through;
+        expansion.reserve(maxM0_);
+        while (!candidate_set.empty()) {
+            std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
+            if (-current_node_pair.first > lowerBound && top_candidates.size() == ef) {
+                break;
+            }
+            candidate_set.pop();
+
+            // Elements that pass the filter are collected hop by hop, moving through the ones
+            // that fail it. A third hop is only taken when two hops found fewer than maxM_
+            // elements, which happens for very selective filters; it ends as soon as maxM0_
+            // elements are found.
+            expansion.clear();
+            pass_through.assign(1, current_node_pair.second);
+            for (size_t hop = 0; hop < 3 && !pass_through.empty(); hop++) {
+                next_pass_through.clear();
+                for (size_t p = 0; p < pass_through.size() && expansion.size() < maxM0_; p++) {
+                    // Elements outside the filter set are marked once their neighbors are examined
+                    if (hop > 0 && !vl->visit(pass_through[p]))
+                        continue;
+                    linklistsizeint *data = get_linklist0(pass_through[p]);
+                    size_t size = getListCount(data);
+                    tableint *links = (tableint *) (data + 1);
+                    for (size_t j = 0; j < size && expansion.size() < maxM0_; j++) {
+                        tableint neighbor = links[j];
+                        if (isAllowed(neighbor, isIdAllowed)) {
+                            if (vl->visit(neighbor))
+                                expansion.push_back(neighbor);
+                        } else if (hop < 2) {
+                            next_pass_through.push_back(neighbor);
+                        }
+                    }
+                }
+                if (hop >= 1 && expansion.size() >= maxM_)
+                    break;
+                pass_through.swap(next_pass_through);
+            }
+
+            for (size_t j = 0; j < expansion.size(); j++) {
+                tableint candidate_id = expansion[j];
+#ifdef USE_SSE
+                if (j + 1 < expansion.size())
+                    _mm_prefetch(getDataByInternalId(expansion[j + 1]), _MM_HINT_T0);
+#endif
+                dist_t dist = fstdistfunc_(data_point, getDataByInternalId(candidate_id), dist_func_param_);
+                if (top_candidates.size() < ef || lowerBound > dist) {
+                    candidate_set.emplace(-dist, candidate_id);
+                    top_candidates.emplace(dist, candidate_id);
+                    if (top_candidates.size() > ef)
+                        top_candidates.pop();
+                    lowerBound = top_candidates.top().first;
+                }
+            }
+        }
+
+        visited_list_pool_->releaseVisitedList(vl);
+        return top_candidates;
+    }
+
+
+    // Greedy descent from the entry point to the closest element on level 1
+    tableint searchUpperLayers(const void *query_data) const {
         tableint currObj = enterpoint_node_;
         dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
 
@@ -1289,7 +2016,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
                     tableint cand = datal[i];
-                    if (cand < 0 || cand > max_elements_)
+                    if (cand > max_elements_)
                         throw std::runtime_error("cand error");
                     dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
 
@@ -1301,26 +2028,163 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 }
             }
         }
+        return currObj;
+    }
+
 
+    // Base layer search of one query in searchKnnBatch
+    struct BatchSearchState {
+        size_t query_id{0};
+        const void *query{nullptr};
+        VisitedList *vl{nullptr};
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
+        dist_t lowerBound{0};
+        std::vector<tableint> neighbors;  // unvisited neighbors of the last expanded node, distances pending
+        bool active{false};
+    };
+
+
+    /*
+    * Searches num_queries queries stored one after another (data_size_ bytes each, in the
+    * format of the index) and returns for each the same result as searchKnn.
+    * The base layer searches of up to `window` queries advance in lockstep. A step of a
+    * query either expands its closest candidate, prefetching the vectors of the unvisited
+    * neighbors, or computes the distances to the neighbors prefetched by its previous step
+    * and prefetches the next link list. Between two steps of a query the other queries run,
+    * which hides the latency of the dependent memory accesses of each hop.
+    * ef = 0 uses the value set by setEf.
+    */
+    std::vector<std::priority_queue<std::pair<dist_t, labeltype>>>
+    searchKnnBatch(const void *queries, size_t num_queries, size_t k, BaseFilterFunctor* isIdAllowed = nullptr, size_t window = 8, size_t ef = 0) const {
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype>>> results(num_queries);
+        if (cur_element_count == 0 || num_queries == 0) return results;
+
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
-        if (bare_bone_search) {
-            top_candidates = searchBaseLayerST<true>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+        ef = std::max(ef ? ef : ef_, k);
+        std::vector<BatchSearchState> states(std::max<size_t>(1, std::min(window, num_queries)));
+        size_t next_query = 0;
+        size_t num_active = 0;
+
+        for (BatchSearchState &state : states) {
+            startBatchQuery(state, (const char *) queries + next_query * data_size_, next_query, bare_bone_search, isIdAllowed);
+            next_query++;
+            num_active++;
+            if (next_query == num_queries) break;
+        }
+
+        while (num_active > 0) {
+            for (BatchSearchState &state : states) {
+                if (!state.active)
+                    continue;
+                if (!state.neighbors.empty()) {
+                    computeBatchNeighbors(state, ef, bare_bone_search, isIdAllowed);
+                    continue;
+                }
+                if (expandBatchCandidate(state, ef, bare_bone_search))
+                    continue;
+
+                // the query is done, the slot takes the next one
+                while (state.top_candidates.size() > k) {
+                    state.top_candidates.pop();
+                }
+                while (state.top_candidates.size() > 0) {
+                    std::pair<dist_t, tableint> rez = state.top_candidates.top();
+                    results[state.query_id].push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
+                    state.top_candidates.pop();
+                }
+                visited_list_pool_->releaseVisitedList(state.vl);
+                state.vl = nullptr;
+                state.active = false;
+                num_active--;
+                if (next_query < num_queries) {
+                    state.candidate_set = decltype(state.candidate_set)();
+                    startBatchQuery(state, (const char *) queries + next_query * data_size_, next_query, bare_bone_search, isIdAllowed);
+                    next_query++;
+                    num_active++;
+                }
+            }
+        }
+        return results;
+    }
+
+
+    void startBatchQuery(BatchSearchState &state, const void *query, size_t query_id, bool bare_bone_search,
+                         BaseFilterFunctor* isIdAllowed) const {
+        state.query_id = query_id;
+        state.query = query;
+        state.active = true;
+        state.vl = visited_list_pool_->getFreeVisitedList();
+
+        tableint ep_id = searchUpperLayers(query);
+        if (bare_bone_search ||
+            (!isMarkedDeleted(ep_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(ep_id))))) {
+            dist_t dist = fstdistfunc_(query, getDataByInternalId(ep_id), dist_func_param_);
+            state.lowerBound = dist;
+            state.top_candidates.emplace(dist, ep_id);
+            state.candidate_set.emplace(-dist, ep_id);
         } else {
-            top_candidates = searchBaseLayerST<false>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            state.lowerBound = std::numeric_limits<dist_t>::max();
+            state.candidate_set.emplace(-state.lowerBound, ep_id);
         }
+        state.vl->visit(ep_id);
+    }
 
-        while (top_candidates.size() > k) {
-            top_candidates.pop();
+
+    // Pops the closest candidate and prefetches its unvisited neighbors, false when the search is over
+    bool expandBatchCandidate(BatchSearchState &state, size_t ef, bool bare_bone_search) const {
+        if (state.candidate_set.empty())
+            return false;
+        dist_t candidate_dist = -state.candidate_set.top().first;
+        bool flag_stop_search = bare_bone_search ? candidate_dist > state.lowerBound :
+                                candidate_dist > state.lowerBound && state.top_candidates.size() == ef;
+        if (flag_stop_search)
+            return false;
+        tableint current_node_id = state.candidate_set.top().second;
+        state.candidate_set.pop();
+
+        int *data = (int *) get_linklist0(current_node_id);
+        size_t size = getListCount((linklistsizeint*)data);
+        for (size_t j = 1; j <= size; j++) {
+            tableint candidate_id = *(data + j);
+            if (state.vl->visit(candidate_id)) {
+                state.neighbors.push_back(candidate_id);
+#ifdef USE_SSE
+                // the whole vector, the other queries run before it is read
+                char *vector = getDataByInternalId(candidate_id);
+                for (size_t offset = 0; offset < data_size_; offset += 64)
+                    _mm_prefetch(vector + offset, _MM_HINT_T0);
+#endif
+            }
         }
-        while (top_candidates.size() > 0) {
-            std::pair<dist_t, tableint> rez = top_candidates.top();
-            result.push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
-            top_candidates.pop();
+        return true;
+    }
+
+
+    // Same candidate handling as searchBaseLayerST without a stop condition
+    void computeBatchNeighbors(BatchSearchState &state, size_t ef, bool bare_bone_search,
+                               BaseFilterFunctor* isIdAllowed) const {
+        for (tableint candidate_id : state.neighbors) {
+            char *currObj1 = getDataByInternalId(candidate_id);
+            dist_t dist = fstdistfunc_(state.query, currObj1, dist_func_param_);
+            if (state.top_candidates.size() < ef || state.lowerBound > dist) {
+                state.candidate_set.emplace(-dist, candidate_id);
+                if (bare_bone_search ||
+                    (!isMarkedDeleted(candidate_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(candidate_id))))) {
+                    state.top_candidates.emplace(dist, candidate_id);
+                }
+                while (state.top_candidates.size() > ef) {
+                    state.top_candidates.pop();
+                }
+                if (!state.top_candidates.empty())
+                    state.lowerBound = state.top_candidates.top().first;
+            }
         }
-        return result;
+        state.neighbors.clear();
+#ifdef USE_SSE
+        if (!state.candidate_set.empty())
+            _mm_prefetch((char *) get_linklist0(state.candidate_set.top().second), _MM_HINT_T0);
+#endif
     }
 
 
@@ -1349,7 +2213,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
                     tableint cand = datal[i];
-                    if (cand < 0 || cand > max_elements_)
+                    if (cand > max_elements_)
                         throw std::runtime_error("cand error");
                     dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
 
@@ -1368,7 +2232,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_t sz = top_candidates.size();
         result.resize(sz);
         while (!top_candidates.empty()) {
-            result[--sz] = top_candidates.top();
+            result[--sz] = std::make_pair(top_candidates.top().first, getExternalLabel(top_candidates.top().second));
             top_candidates.pop();
         }
 
@@ -1378,6 +2242,89 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Measures the recall@k of searchKnn for each of the given ef values. Up to num_samples
+    * stored elements, picked at random, are used as queries and the exact neighbors are found
+    * by a linear scan over all elements that are not deleted. Meant for offline calibration:
+    * the linear scans cost num_samples * cur_element_count distance computations.
+    */
+    std::vector<float> measureRecall(const std::vector<size_t> &ef_values, size_t num_samples, size_t k,
+                                     unsigned int seed = 100) const {
+        std::vector<float> recalls(ef_values.size(), 0);
+        size_t num_elements = cur_element_count;
+        if (num_elements == 0 || num_samples == 0 || k == 0) return recalls;
+
+        std::vector<tableint> samples = sampleElements(num_samples, seed);
+        std::vector<size_t> correct(ef_values.size(), 0);
+        size_t total = 0;
+        for (tableint sample : samples) {
+            const char *query_data = getDataByInternalId(sample);
+            std::priority_queue<std::pair<dist_t, tableint>> exact;
+            for (tableint i = 0; i < num_elements; i++) {
+                if (isMarkedDeleted(i)) continue;
+                dist_t dist = fstdistfunc_(query_data, getDataByInternalId(i), dist_func_param_);
+                if (exact.size() < k || dist < exact.top().first) {
+                    exact.emplace(dist, i);
+                    if (exact.size() > k) exact.pop();
+                }
+            }
+            std::unordered_set<labeltype> expected;
+            total += exact.size();
+            while (!exact.empty()) {
+                expected.insert(getExternalLabel(exact.top().second));
+                exact.pop();
+            }
+
+            for (size_t j = 0; j < ef_values.size(); j++) {
+                auto result = searchKnn(query_data, k, nullptr, ef_values[j]);
+                while (!result.empty()) {
+                    correct[j] += expected.count(result.top().second);
+                    result.pop();
+                }
+            }
+        }
+        for (size_t j = 0; j < ef_values.size() && total > 0; j++) {
+            recalls[j] = (float) correct[j] / total;
+        }
+        return recalls;
+    }
+
+
+    /*
+    * Learns the patience of AdaptiveSearchStopCondition for the given ef and k: up to
+    * num_samples stored elements are searched without limits, and the patience is chosen so
+    * that the `quantile` fraction of them would have found the same top-k.
+    */
+    size_t learnSearchPatience(size_t ef, size_t k, size_t num_samples, float quantile = 0.99f,
+                               unsigned int seed = 100) const {
+        if (cur_element_count == 0 || num_samples == 0 || k == 0) return 0;
+
+        std::vector<SearchTerminationStats> stats;
+        for (tableint sample : sampleElements(num_samples, seed)) {
+            AdaptiveSearchStopCondition<dist_t> stop_condition(k, ef);
+            searchStopConditionClosest(getDataByInternalId(sample), stop_condition);
+            stats.push_back(stop_condition.stats());
+        }
+        return AdaptiveSearchStopCondition<dist_t>::learnPatience(stats, quantile);
+    }
+
+
+    // Random elements that are not deleted, used as queries for calibration
+    std::vector<tableint> sampleElements(size_t num_samples, unsigned int seed) const {
+        size_t num_elements = cur_element_count;
+        std::vector<tableint> samples;
+        if (num_elements == 0) return samples;
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> distrib(0, num_elements - 1);
+        for (size_t i = 0; i < num_samples * 4 && samples.size() < num_samples; i++) {
+            tableint id = (tableint) distrib(rng);
+            if (!isMarkedDeleted(id))
+                samples.push_back(id);
+        }
+        return samples;
+    }
+
+
     void checkIntegrity() {
         int connections_checked = 0;
         std::vector <int > inbound_connections_num(cur_element_count, 0);
@@ -114,6 +114,43 @@ static bool AVX512Capable() {
     }
     return HW_AVX512F && avx512Supported;
 }
+
+static bool F16CCapable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000001, 0);
+    return (cpuInfo[2] & ((int)1 << 29)) != 0;
+}
+
+static bool AVX2Capable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0, 0);
+    int nIds = cpuInfo[0];
+    if (nIds < 0x00000007) return false;
+
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[1] & ((int)1 << 5)) != 0;
+}
+
+static bool POPCNTCapable() {
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000001, 0);
+    return (cpuInfo[2] & ((int)1 << 23)) != 0;
+}
+
+// AVX-512 VPOPCNTDQ, together with AVX-512BW for the masked byte loads
+static bool AVX512VPOPCNTDQCapable() {
+    if (!AVX512Capable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000007, 0);
+    bool avx512bw = (cpuInfo[1] & ((int)1 << 30)) != 0;
+    bool vpopcntdq = (cpuInfo[2] & ((int)1 << 14)) != 0;
+    return avx512bw && vpopcntdq;
+}
 #endif
 
 #include <queue>
@@ -221,8 +258,11 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 }
 }  // namespace hnswlib
 
+#include "cpu_dispatch.h"
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_half.h"
+#include "space_hamming.h"
 #include "stop_condition.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
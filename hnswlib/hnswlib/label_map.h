@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace hnswlib {
+
+/*
+* Flat open-addressing hash map from external labels to internal ids.
+*
+* Lookups (find, iteration) never lock and may run concurrently with one writer.
+* Modifying calls (insert, insert_or_assign, erase, reserve, clear) must be
+* serialized by the caller. A slot is published by storing its value last, and a
+* key never moves to another slot within a table, so readers either see a complete
+* entry or none. On growth the new table is swapped in atomically and the old ones
+* are kept alive for in-flight readers until release_retired() or clear().
+*/
+template<typename label_t, typename id_t>
+class LabelMap {
+    static constexpr id_t EMPTY = std::numeric_limits<id_t>::max();
+    static constexpr id_t ERASED = std::numeric_limits<id_t>::max() - 1;
+
+    struct Slot {
+        std::atomic<label_t> key{0};
+        std::atomic<id_t> value{EMPTY};
+    };
+
+    struct Table {
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+        size_t capacity() const { return mask + 1; }
+    };
+
+    std::atomic<Table *> table_{nullptr};
+    std::vector<std::unique_ptr<Table>> tables_;  // tables_.back() is the current table
+    std::atomic<size_t> size_{0};
+    size_t used_slots_{0};  // live and erased slots of the current table
+
+    static size_t hash(label_t key) {
+        uint64_t x = (uint64_t) key;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return (size_t) x;
+    }
+
+    static size_t capacityFor(size_t num_elements) {
+        size_t capacity = 16;
+        while (capacity * 7 < num_elements * 10) capacity <<= 1;
+        return capacity;
+    }
+
+    // Returns the slot holding the key, or the empty slot ending its probe sequence
+    static Slot *probe(const Table *table, label_t key) {
+        size_t pos = hash(key) & table->mask;
+        while (true) {
+            Slot &slot = table->slots[pos];
+            if (slot.value.load(std::memory_order_acquire) == EMPTY ||
+                slot.key.load(std::memory_order_relaxed) == key)
+                return &slot;
+            pos = (pos + 1) & table->mask;
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::unique_ptr<Table> table(new Table(capacity));
+        Table *old_table = table_.load(std::memory_order_relaxed);
+        used_slots_ = 0;
+        if (old_table) {
+            for (size_t i = 0; i < old_table->capacity(); i++) {
+                id_t value = old_table->slots[i].value.load(std::memory_order_relaxed);
+                if (value == EMPTY || value == ERASED)
+                    continue;
+                label_t key = old_table->slots[i].key.load(std::memory_order_relaxed);
+                Slot *slot = probe(table.get(), key);
+                slot->key.store(key, std::memory_order_relaxed);
+                slot->value.store(value, std::memory_order_relaxed);
+                used_slots_++;
+            }
+        }
+        table_.store(table.get(), std::memory_order_release);
+        tables_.push_back(std::move(table));
+    }
+
+ public:
+    typedef std::pair<label_t, id_t> value_type;
+
+    class const_iterator {
+        friend class LabelMap;
+        const Table *table_;
+        size_t pos_;
+        value_type item_;
+
+        const_iterator(const Table *table, size_t pos) : table_(table), pos_(pos) {
+            skipFree();
+        }
+
+        void skipFree() {
+            for (; table_ && pos_ < table_->capacity(); pos_++) {
+                id_t value = table_->slots[pos_].value.load(std::memory_order_acquire);
+                if (value != EMPTY && value != ERASED) {
+                    item_ = value_type(table_->slots[pos_].key.load(std::memory_order_relaxed), value);
+                    return;
+                }
+            }
+            table_ = nullptr;
+            pos_ = 0;
+        }
+
+     public:
+        const value_type &operator*() const { return item_; }
+        const value_type *operator->() const { return &item_; }
+        const_iterator &operator++() {
+            pos_++;
+            skipFree();
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const { return table_ == other.table_ && pos_ == other.pos_; }
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+    };
+    typedef const_iterator iterator;
+
+    LabelMap() = default;
+    LabelMap(const LabelMap &) = delete;
+    LabelMap &operator=(const LabelMap &) = delete;
+
+    size_t size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(table_.load(std::memory_order_acquire), 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr, 0);
+    }
+
+    const_iterator find(label_t key) const {
+        const Table *table = table_.load(std::memory_order_acquire);
+        if (!table)
+            return end();
+        Slot *slot = probe(table, key);
+        id_t value = slot->value.load(std::memory_order_acquire);
+        if (value == EMPTY || value == ERASED)
+            return end();
+        return const_iterator(table, slot - table->slots.get());
+    }
+
+    size_t count(label_t key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    // Inserts or overwrites; overwriting an existing key never reallocates, so it is
+    // safe while iterating
+    void insert_or_assign(label_t key, id_t value) {
+        Table *table = table_.load(std::memory_order_relaxed);
+        if (!table || (used_slots_ + 1) * 10 > table->capacity() * 7) {
+            Slot *slot = table ? probe(table, key) : nullptr;
+            if (!slot || slot->value.load(std::memory_order_relaxed) == EMPTY) {
+                rehash(capacityFor(size() + 1) * 2);
+                table = table_.load(std::memory_order_relaxed);
+            }
+        }
+        Slot *slot = probe(table, key);
+        id_t old_value = slot->value.load(std::memory_order_relaxed);
+        if (old_value == EMPTY) {
+            slot->key.store(key, std::memory_order_relaxed);
+            used_slots_++;
+        }
+        if (old_value == EMPTY || old_value == ERASED)
+            size_.fetch_add(1, std::memory_order_relaxed);
+        slot->value.store(value, std::memory_order_release);
+    }
+
+    bool insert(const value_type &item) {
+        if (find(item.first) != end())
+            return false;
+        insert_or_assign(item.first, item.second);
+        return true;
+    }
+
+    size_t erase(label_t key) {
+        Table *table = table_.load(std::memory_order_relaxed);
+        if (!table)
+            return 0;
+        Slot *slot = probe(table, key);
+        id_t value = slot->value.load(std::memory_order_relaxed);
+        if (value == EMPTY || value == ERASED)
+            return 0;
+        // the key keeps its slot so that probe sequences passing through it stay intact
+        slot->value.store(ERASED, std::memory_order_release);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return 1;
+    }
+
+    void reserve(size_t num_elements) {
+        Table *table = table_.load(std::memory_order_relaxed);
+        size_t capacity = capacityFor(num_elements);
+        if (!table || table->capacity() < capacity)
+            rehash(capacity);
+    }
+
+    // Frees the tables replaced by earlier growth. Not safe with concurrent readers
+    void release_retired() {
+        if (tables_.size() > 1)
+            tables_.erase(tables_.begin(), tables_.end() - 1);
+    }
+
+    // Not safe with concurrent readers
+    void clear() {
+        table_.store(nullptr, std::memory_order_relaxed);
+        tables_.clear();
+        size_.store(0, std::memory_order_relaxed);
+        used_slots_ = 0;
+    }
+};
+
+}  // namespace hnswlib
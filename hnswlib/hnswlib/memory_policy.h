@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <sstream>
+
+#if defined(__linux__)
+#define HNSWLIB_USE_NUMA_POLICY
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hnswlib {
+
+// Page size used for the base layer and other large index buffers
+enum HugePages {
+    HUGE_PAGES_NONE = 0,         // regular malloc'ed memory
+    HUGE_PAGES_TRANSPARENT = 1,  // anonymous mapping with madvise(MADV_HUGEPAGE)
+    HUGE_PAGES_EXPLICIT = 2      // MAP_HUGETLB from the reserved 2 MB pool, transparent if the pool is empty
+};
+
+// NUMA placement of the same buffers
+enum NumaPlacement {
+    NUMA_DEFAULT = 0,     // first touch
+    NUMA_BIND = 1,        // all pages on numa_node
+    NUMA_INTERLEAVE = 2   // pages spread round-robin over the online nodes
+};
+
+// Nodes are passed to mbind as a mask of one unsigned long
+static const int MAX_NUMA_NODES = (int) (sizeof(unsigned long) * 8);
+
+struct MemoryPolicy {
+    HugePages huge_pages{HUGE_PAGES_NONE};
+    NumaPlacement numa{NUMA_DEFAULT};
+    int numa_node{0};
+
+    bool isDefault() const {
+        return huge_pages == HUGE_PAGES_NONE && numa == NUMA_DEFAULT;
+    }
+
+    bool isValid() const {
+        return numa != NUMA_BIND || (numa_node >= 0 && numa_node < MAX_NUMA_NODES);
+    }
+};
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+#ifdef HNSWLIB_USE_NUMA_POLICY
+// Bit mask of the online NUMA nodes, parsed from e.g. "0-1,3"
+static inline unsigned long onlineNumaNodes() {
+    std::ifstream input("/sys/devices/system/node/online");
+    std::string ranges;
+    if (!input.is_open() || !std::getline(input, ranges))
+        return 1;
+    unsigned long mask = 0;
+    std::stringstream ss(ranges);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+        for (int node = first; node <= last && node < MAX_NUMA_NODES; node++)
+            mask |= 1UL << node;
+    }
+    return mask ? mask : 1;
+}
+#endif
+
+/*
+* Applies the policy to the whole pages inside [addr, addr + size). Pages that are
+* already populated are migrated. Failures are ignored: the policy is an optimization
+* and the memory stays usable with the default placement. An invalid policy (see
+* MemoryPolicy::isValid) is ignored as well.
+*/
+static inline void applyMemoryPolicy(void *addr, size_t size, const MemoryPolicy &policy) {
+#ifdef HNSWLIB_USE_NUMA_POLICY
+    if (policy.isDefault() || !policy.isValid() || addr == nullptr)
+        return;
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t) addr + page - 1) & ~(uintptr_t) (page - 1);
+    uintptr_t end = ((uintptr_t) addr + size) & ~(uintptr_t) (page - 1);
+    if (end <= begin)
+        return;
+    if (policy.huge_pages != HUGE_PAGES_NONE)
+        madvise((void *) begin, end - begin, MADV_HUGEPAGE);
+    if (policy.numa != NUMA_DEFAULT) {
+        const int MPOL_BIND_MODE = 2, MPOL_INTERLEAVE_MODE = 3;
+        const unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+        unsigned long nodes = policy.numa == NUMA_BIND ? 1UL << policy.numa_node : onlineNumaNodes();
+        int mode = policy.numa == NUMA_BIND ? MPOL_BIND_MODE : MPOL_INTERLEAVE_MODE;
+        syscall(SYS_mbind, begin, end - begin, mode, &nodes, sizeof(nodes) * 8 + 1, MPOL_MF_MOVE_FLAG);
+    }
+#endif
+}
+
+/*
+* Allocates size bytes following the policy. With the default policy this is malloc
+* and mapped_size is set to 0; otherwise the memory is an anonymous mapping of
+* mapped_size bytes that must be released with freeLargeBuffer.
+*/
+static inline void *allocateLargeBuffer(size_t size, const MemoryPolicy &policy, size_t &mapped_size) {
+    mapped_size = 0;
+#ifdef HNSWLIB_USE_NUMA_POLICY
+    if (!policy.isDefault() && size > 0) {
+        size_t length = policy.huge_pages == HUGE_PAGES_NONE ? size : (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void *ptr = MAP_FAILED;
+        if (policy.huge_pages == HUGE_PAGES_EXPLICIT)
+            ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+            ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return nullptr;
+        // the policy must be set before the first touch so that pages are placed right away
+        applyMemoryPolicy(ptr, length, policy);
+        mapped_size = length;
+        return ptr;
+    }
+#endif
+    return malloc(size);
+}
+
+static inline void freeLargeBuffer(void *ptr, size_t mapped_size) {
+#ifdef HNSWLIB_USE_NUMA_POLICY
+    if (mapped_size != 0) {
+        munmap(ptr, mapped_size);
+        return;
+    }
+#endif
+    free(ptr);
+}
+
+}  // namespace hnswlib
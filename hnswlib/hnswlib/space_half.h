@@ -0,0 +1,532 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+
+// Half precision (IEEE fp16) and bfloat16 spaces.
+// Elements are stored as 16-bit codes, queries must be encoded the same way
+// (see convertFloatToFp16 / convertFloatToBf16). Distances are computed in float32.
+//
+// With runtime dispatch (see cpu_dispatch.h) the SIMD kernels carry target attributes
+// and are picked from CPUID, so they are used even when the build has no -march flags.
+// Otherwise they are compiled only when the build targets the instruction sets.
+
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+#define HNSWLIB_HALF_AVX2
+#define HNSWLIB_HALF_AVX512
+#define HNSWLIB_TARGET_HALF_AVX2 __attribute__((target("avx2,f16c,fma")))
+#define HNSWLIB_TARGET_HALF_AVX512 __attribute__((target("avx512f")))
+#else
+#if defined(USE_AVX) && defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+#define HNSWLIB_HALF_AVX2
+#endif
+#if defined(USE_AVX512)
+#define HNSWLIB_HALF_AVX512
+#endif
+#define HNSWLIB_TARGET_HALF_AVX2
+#define HNSWLIB_TARGET_HALF_AVX512
+#endif
+
+namespace hnswlib {
+
+static inline float
+fp16ToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // subnormal, normalize the mantissa
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3FF;
+            bits = sign | (exp << 23) | (mant << 13);
+        }
+    } else if (exp == 0x1F) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even
+static inline uint16_t
+floatToFp16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7FFFFFFF;
+
+    if (abs >= 0x7F800000)  // inf or nan
+        return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+    if (abs >= 0x477FF000)  // rounds to a value above 65504
+        return sign | 0x7C00;
+    if (abs < 0x38800000) {  // below the smallest normal half
+        if (abs < 0x33000000)
+            return sign;
+        uint32_t mant = (abs & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - (abs >> 23);
+        uint32_t res = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (res & 1)))
+            res++;
+        return sign | res;
+    }
+    uint32_t res = (abs >> 13) - ((127 - 15) << 10);
+    uint32_t rem = abs & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (res & 1)))
+        res++;
+    return sign | res;
+}
+
+static inline float
+bf16ToFloat(uint16_t h) {
+    uint32_t bits = (uint32_t) h << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even
+static inline uint16_t
+floatToBf16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7FFFFFFF) > 0x7F800000)  // keep nan quiet
+        return (bits >> 16) | 0x40;
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return bits >> 16;
+}
+
+static void
+convertFloatToFp16(const float *src, uint16_t *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++)
+        dst[i] = floatToFp16(src[i]);
+}
+
+static void
+convertFloatToBf16(const float *src, uint16_t *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++)
+        dst[i] = floatToBf16(src[i]);
+}
+
+static void
+convertFp16ToFloat(const uint16_t *src, float *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++)
+        dst[i] = fp16ToFloat(src[i]);
+}
+
+static void
+convertBf16ToFloat(const uint16_t *src, float *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++)
+        dst[i] = bf16ToFloat(src[i]);
+}
+
+static float
+L2SqrFp16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float t = fp16ToFloat(pVect1[i]) - fp16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+InnerProductFp16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += fp16ToFloat(pVect1[i]) * fp16ToFloat(pVect2[i]);
+    }
+    return res;
+}
+
+static float
+InnerProductDistanceFp16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductFp16(pVect1v, pVect2v, qty_ptr);
+}
+
+static float
+L2SqrBf16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float t = bf16ToFloat(pVect1[i]) - bf16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+InnerProductBf16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += bf16ToFloat(pVect1[i]) * bf16ToFloat(pVect2[i]);
+    }
+    return res;
+}
+
+static float
+InnerProductDistanceBf16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductBf16(pVect1v, pVect2v, qty_ptr);
+}
+
+#if defined(HNSWLIB_HALF_AVX512)
+
+// The conversion is fused into the distance loop: 16 codes are widened to float32 per load.
+HNSWLIB_TARGET_HALF_AVX512 static float
+L2SqrFp16AVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_set1_ps(0);
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 v1 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (pVect1 + i)));
+        __m512 v2 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (pVect2 + i)));
+        __m512 diff = _mm512_sub_ps(v1, v2);
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+
+    for (size_t i = qty16; i < qty; i++) {
+        float t = fp16ToFloat(pVect1[i]) - fp16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_HALF_AVX512 static float
+InnerProductDistanceFp16AVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_set1_ps(0);
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 v1 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (pVect1 + i)));
+        __m512 v2 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (pVect2 + i)));
+        sum = _mm512_fmadd_ps(v1, v2, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+
+    for (size_t i = qty16; i < qty; i++) {
+        res += fp16ToFloat(pVect1[i]) * fp16ToFloat(pVect2[i]);
+    }
+    return 1.0f - res;
+}
+
+HNSWLIB_TARGET_HALF_AVX512 static inline __m512
+bf16x16ToFloatAVX512(const uint16_t *p) {
+    __m512i wide = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *) p));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(wide, 16));
+}
+
+HNSWLIB_TARGET_HALF_AVX512 static float
+L2SqrBf16AVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_set1_ps(0);
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 diff = _mm512_sub_ps(bf16x16ToFloatAVX512(pVect1 + i), bf16x16ToFloatAVX512(pVect2 + i));
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+
+    for (size_t i = qty16; i < qty; i++) {
+        float t = bf16ToFloat(pVect1[i]) - bf16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_HALF_AVX512 static float
+InnerProductDistanceBf16AVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_set1_ps(0);
+    for (size_t i = 0; i < qty16; i += 16) {
+        sum = _mm512_fmadd_ps(bf16x16ToFloatAVX512(pVect1 + i), bf16x16ToFloatAVX512(pVect2 + i), sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+
+    for (size_t i = qty16; i < qty; i++) {
+        res += bf16ToFloat(pVect1[i]) * bf16ToFloat(pVect2[i]);
+    }
+    return 1.0f - res;
+}
+
+#endif
+
+#if defined(HNSWLIB_HALF_AVX2)
+
+HNSWLIB_TARGET_HALF_AVX2 static float
+L2SqrFp16F16C(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        __m256 diff = _mm256_sub_ps(v1, v2);
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    for (size_t i = qty8; i < qty; i++) {
+        float t = fp16ToFloat(pVect1[i]) - fp16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_HALF_AVX2 static float
+InnerProductDistanceFp16F16C(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        sum = _mm256_fmadd_ps(v1, v2, sum);
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    for (size_t i = qty8; i < qty; i++) {
+        res += fp16ToFloat(pVect1[i]) * fp16ToFloat(pVect2[i]);
+    }
+    return 1.0f - res;
+}
+
+HNSWLIB_TARGET_HALF_AVX2 static inline __m256
+bf16x8ToFloatAVX2(const uint16_t *p) {
+    __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) p));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+
+HNSWLIB_TARGET_HALF_AVX2 static float
+L2SqrBf16AVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 diff = _mm256_sub_ps(bf16x8ToFloatAVX2(pVect1 + i), bf16x8ToFloatAVX2(pVect2 + i));
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    for (size_t i = qty8; i < qty; i++) {
+        float t = bf16ToFloat(pVect1[i]) - bf16ToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_HALF_AVX2 static float
+InnerProductDistanceBf16AVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        sum = _mm256_fmadd_ps(bf16x8ToFloatAVX2(pVect1 + i), bf16x8ToFloatAVX2(pVect2 + i), sum);
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    for (size_t i = qty8; i < qty; i++) {
+        res += bf16ToFloat(pVect1[i]) * bf16ToFloat(pVect2[i]);
+    }
+    return 1.0f - res;
+}
+
+#endif
+
+#if defined(HNSWLIB_HALF_AVX2)
+#define HNSWLIB_HALF_AVX2_KERNEL(func) func
+#else
+#define HNSWLIB_HALF_AVX2_KERNEL(func) nullptr
+#endif
+#if defined(HNSWLIB_HALF_AVX512)
+#define HNSWLIB_HALF_AVX512_KERNEL(func) func
+#else
+#define HNSWLIB_HALF_AVX512_KERNEL(func) nullptr
+#endif
+
+// Picks the widest kernel the host supports, falling back to the scalar one
+static DISTFUNC<float>
+selectHalfKernel(DISTFUNC<float> scalar, DISTFUNC<float> avx2, DISTFUNC<float> avx512) {
+    DISTFUNC<float> func = scalar;
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    if (getSimdLevel() >= SIMD_AVX2 && F16CCapable())
+        func = avx2;
+    if (getSimdLevel() >= SIMD_AVX512)
+        func = avx512;
+#else
+    if (avx2 && AVX2Capable() && F16CCapable())
+        func = avx2;
+    if (avx512 && AVX512Capable())
+        func = avx512;
+#endif
+    return func;
+}
+
+class L2SpaceFp16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2SpaceFp16(size_t dim) {
+        fstdistfunc_ = selectHalfKernel(L2SqrFp16, HNSWLIB_HALF_AVX2_KERNEL(L2SqrFp16F16C), HNSWLIB_HALF_AVX512_KERNEL(L2SqrFp16AVX512));
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~L2SpaceFp16() {}
+};
+
+class InnerProductSpaceFp16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceFp16(size_t dim) {
+        fstdistfunc_ = selectHalfKernel(InnerProductDistanceFp16, HNSWLIB_HALF_AVX2_KERNEL(InnerProductDistanceFp16F16C), HNSWLIB_HALF_AVX512_KERNEL(InnerProductDistanceFp16AVX512));
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceFp16() {}
+};
+
+class L2SpaceBf16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2SpaceBf16(size_t dim) {
+        fstdistfunc_ = selectHalfKernel(L2SqrBf16, HNSWLIB_HALF_AVX2_KERNEL(L2SqrBf16AVX2), HNSWLIB_HALF_AVX512_KERNEL(L2SqrBf16AVX512));
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~L2SpaceBf16() {}
+};
+
+class InnerProductSpaceBf16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceBf16(size_t dim) {
+        fstdistfunc_ = selectHalfKernel(InnerProductDistanceBf16, HNSWLIB_HALF_AVX2_KERNEL(InnerProductDistanceBf16AVX2), HNSWLIB_HALF_AVX512_KERNEL(InnerProductDistanceBf16AVX512));
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceBf16() {}
+};
+
+}  // namespace hnswlib
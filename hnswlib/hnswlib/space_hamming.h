@@ -0,0 +1,173 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+
+// Hamming space for binary vectors.
+// A vector of dim bits is stored packed, dim / 8 bytes, bit i of the vector
+// being bit (i % 8) of byte i / 8. The distance is the number of differing bits,
+// returned as float so the space plugs into HierarchicalNSW<float>; counts are
+// exact up to 2^24 bits. The distance function parameter is the code size in bytes.
+
+namespace hnswlib {
+
+static inline size_t
+popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static float
+HammingDistance(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    size_t res = 0;
+    size_t i = 0;
+    for (; i + 8 <= qty; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        res += popcount64(x ^ y);
+    }
+    for (; i < qty; i++) {
+        res += popcount64(a[i] ^ b[i]);
+    }
+    return (float) res;
+}
+
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+
+// Without -mpopcnt the builtin becomes a bit-twiddling sequence, the target
+// attribute turns it into the POPCNT instruction. Four accumulators keep the
+// popcounts independent of each other.
+__attribute__((target("popcnt"))) static float
+HammingDistancePOPCNT(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    size_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    size_t i = 0;
+    for (; i + 32 <= qty; i += 32) {
+        uint64_t x[4], y[4];
+        memcpy(x, a + i, sizeof(x));
+        memcpy(y, b + i, sizeof(y));
+        sum0 += __builtin_popcountll(x[0] ^ y[0]);
+        sum1 += __builtin_popcountll(x[1] ^ y[1]);
+        sum2 += __builtin_popcountll(x[2] ^ y[2]);
+        sum3 += __builtin_popcountll(x[3] ^ y[3]);
+    }
+    for (; i + 8 <= qty; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        sum0 += __builtin_popcountll(x ^ y);
+    }
+    for (; i < qty; i++) {
+        sum1 += __builtin_popcountll(a[i] ^ b[i]);
+    }
+    return (float) (sum0 + sum1 + sum2 + sum3);
+}
+
+// Kernel for the common code sizes, WORDS 64-bit words with no residual
+template <size_t WORDS>
+__attribute__((target("popcnt"))) static float
+HammingDistanceFixedPOPCNT(const void *pVect1v, const void *pVect2v, const void * /* qty_ptr */) {
+    uint64_t x[WORDS], y[WORDS];
+    memcpy(x, pVect1v, sizeof(x));
+    memcpy(y, pVect2v, sizeof(y));
+    size_t res = 0;
+    for (size_t i = 0; i < WORDS; i++) {
+        res += __builtin_popcountll(x[i] ^ y[i]);
+    }
+    return (float) res;
+}
+
+// 64 bytes per iteration, the tail is handled with a masked load
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) static float
+HammingDistanceAVX512VPOPCNTDQ(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    __m512i sum0 = _mm512_setzero_si512();
+    __m512i sum1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 128 <= qty; i += 128) {
+        __m512i x0 = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        __m512i x1 = _mm512_xor_si512(_mm512_loadu_si512(a + i + 64), _mm512_loadu_si512(b + i + 64));
+        sum0 = _mm512_add_epi64(sum0, _mm512_popcnt_epi64(x0));
+        sum1 = _mm512_add_epi64(sum1, _mm512_popcnt_epi64(x1));
+    }
+    for (; i < qty; i += 64) {
+        __mmask64 mask = qty - i >= 64 ? ~(__mmask64) 0 : (((__mmask64) 1 << (qty - i)) - 1);
+        __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a + i), _mm512_maskz_loadu_epi8(mask, b + i));
+        sum0 = _mm512_add_epi64(sum0, _mm512_popcnt_epi64(x));
+    }
+    return (float) _mm512_reduce_add_epi64(_mm512_add_epi64(sum0, sum1));
+}
+
+#endif
+
+// Kernel for the host CPU and the code size in bytes, or nullptr to keep the
+// portable one. Codes shorter than 512 bits stay on POPCNT: for 256-bit hashes
+// four scalar popcounts beat a masked 512-bit load and a horizontal reduction.
+static DISTFUNC<float>
+dispatchHamming(size_t code_size) {
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+    static const bool vpopcntdq = AVX512VPOPCNTDQCapable();
+    static const bool popcnt = POPCNTCapable();
+    if (vpopcntdq && code_size >= 64)
+        return HammingDistanceAVX512VPOPCNTDQ;
+    if (popcnt) {
+        switch (code_size) {
+            case 8: return HammingDistanceFixedPOPCNT<1>;
+            case 16: return HammingDistanceFixedPOPCNT<2>;
+            case 32: return HammingDistanceFixedPOPCNT<4>;
+            case 64: return HammingDistanceFixedPOPCNT<8>;
+            default: return HammingDistancePOPCNT;
+        }
+    }
+#endif
+    return nullptr;
+}
+
+class HammingSpace : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    HammingSpace(size_t dim) {
+        if (dim == 0 || dim % 8 != 0)
+            throw std::runtime_error("Hamming space dimension must be a positive multiple of 8 bits");
+        dim_ = dim;
+        data_size_ = dim / 8;
+        fstdistfunc_ = HammingDistance;
+        if (DISTFUNC<float> dispatched = dispatchHamming(data_size_))
+            fstdistfunc_ = dispatched;
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &data_size_;
+    }
+
+    ~HammingSpace() {}
+};
+
+}  // namespace hnswlib
@@ -378,6 +378,8 @@ class InnerProductSpace : public SpaceInterface<float> {
         else if (dim > 4)
             fstdistfunc_ = InnerProductDistanceSIMD4ExtResiduals;
 #endif
+        if (DISTFUNC<float> dispatched = dispatchInnerProductDistance(getSimdLevel(), dim))
+            fstdistfunc_ = dispatched;
         dim_ = dim;
         data_size_ = dim * sizeof(float);
     }
@@ -233,6 +233,8 @@ class L2Space : public SpaceInterface<float> {
         else if (dim > 4)
             fstdistfunc_ = L2SqrSIMD4ExtResiduals;
 #endif
+        if (DISTFUNC<float> dispatched = dispatchL2Sqr(getSimdLevel(), dim))
+            fstdistfunc_ = dispatched;
         dim_ = dim;
         data_size_ = dim * sizeof(float);
     }
@@ -303,6 +305,8 @@ class L2SpaceI : public SpaceInterface<int> {
         } else {
             fstdistfunc_ = L2SqrI;
         }
+        if (DISTFUNC<int> dispatched = dispatchL2SqrI(getSimdLevel()))
+            fstdistfunc_ = dispatched;
         dim_ = dim;
         data_size_ = dim * sizeof(unsigned char);
     }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HNSWLIB_SPIN_PAUSE
+#include <immintrin.h>
+#endif
+
+namespace hnswlib {
+
+// One byte lock for the per-element link lists. Critical sections are a few
+// hundred nanoseconds and almost never contended, so spinning is cheaper than
+// a 40 byte std::mutex per element.
+class SpinLock {
+ public:
+    SpinLock() : flag_(0) {}
+
+    void lock() {
+        int spins = 0;
+        while (!try_lock()) {
+            // wait on a plain load so the cache line is not bounced between waiters
+            while (flag_.load(std::memory_order_relaxed)) {
+                if (++spins < 64) {
+#ifdef HNSWLIB_SPIN_PAUSE
+                    _mm_pause();
+#endif
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    bool try_lock() {
+        return flag_.exchange(1, std::memory_order_acquire) == 0;
+    }
+
+    void unlock() {
+        flag_.store(0, std::memory_order_release);
+    }
+
+ private:
+    std::atomic<unsigned char> flag_;
+};
+
+}  // namespace hnswlib
@@ -3,6 +3,8 @@
 #include "space_ip.h"
 #include <assert.h>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 namespace hnswlib {
 
@@ -45,6 +47,8 @@ class MultiVectorL2Space : public BaseMultiVectorSpace<DOCIDTYPE> {
         else if (dim > 4)
             fstdistfunc_ = L2SqrSIMD4ExtResiduals;
 #endif
+        if (DISTFUNC<float> dispatched = dispatchL2Sqr(getSimdLevel(), dim))
+            fstdistfunc_ = dispatched;
         dim_ = dim;
         vector_size_ = dim * sizeof(float);
         data_size_ = vector_size_ + sizeof(DOCIDTYPE);
@@ -115,6 +119,9 @@ class MultiVectorInnerProductSpace : public BaseMultiVectorSpace<DOCIDTYPE> {
         else if (dim > 4)
             fstdistfunc_ = InnerProductDistanceSIMD4ExtResiduals;
 #endif
+        if (DISTFUNC<float> dispatched = dispatchInnerProductDistance(getSimdLevel(), dim))
+            fstdistfunc_ = dispatched;
+        dim_ = dim;
         vector_size_ = dim * sizeof(float);
         data_size_ = vector_size_ + sizeof(DOCIDTYPE);
     }
@@ -273,4 +280,119 @@ class EpsilonSearchStopCondition : public BaseSearchStopCondition<dist_t> {
 
     ~EpsilonSearchStopCondition() {}
 };
+
+
+enum SearchTermination {
+    TERMINATION_CONVERGED,  // no candidate could improve the results, as without a stop condition
+    TERMINATION_PATIENCE,   // the top-k did not change for `patience` hops
+    TERMINATION_BUDGET      // the distance computation budget was spent
+};
+
+
+struct SearchTerminationStats {
+    size_t hops = 0;                   // expanded base layer elements
+    size_t distance_computations = 0;  // base layer distance computations
+    size_t max_stale_hops = 0;         // longest run of hops without a top-k change that ended with a change
+    SearchTermination reason = TERMINATION_CONVERGED;
+};
+
+
+/*
+* Stops the search when the top-k has not changed for `patience` hops, or when
+* `max_distance_computations` distances were computed on the base layer (checked before each
+* hop). A limit of 0 is disabled; without limits the search returns the same as searchKnn with
+* the same ef. stats() tells after how much work and why the query stopped.
+*/
+template<typename dist_t>
+class AdaptiveSearchStopCondition : public BaseSearchStopCondition<dist_t> {
+    size_t k_;
+    size_t ef_;
+    size_t patience_;
+    size_t max_distance_computations_;
+    size_t curr_num_items_;
+    size_t stale_hops_;
+    std::priority_queue<dist_t> top_k_;
+    SearchTerminationStats stats_;
+
+ public:
+    AdaptiveSearchStopCondition(size_t k, size_t ef, size_t patience = 0, size_t max_distance_computations = 0) {
+        k_ = k;
+        ef_ = std::max(ef, k);
+        patience_ = patience;
+        max_distance_computations_ = max_distance_computations;
+        curr_num_items_ = 0;
+        stale_hops_ = 0;
+    }
+
+    void add_point_to_result(labeltype label, const void *datapoint, dist_t dist) override {
+        curr_num_items_ += 1;
+        if (top_k_.size() < k_ || dist < top_k_.top()) {
+            top_k_.push(dist);
+            if (top_k_.size() > k_)
+                top_k_.pop();
+            stats_.max_stale_hops = std::max(stats_.max_stale_hops, stale_hops_);
+            stale_hops_ = 0;
+        }
+    }
+
+    void remove_point_from_result(labeltype label, const void *datapoint, dist_t dist) override {
+        curr_num_items_ -= 1;
+    }
+
+    bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
+        if (candidate_dist > lowerBound && curr_num_items_ == ef_) {
+            stats_.reason = TERMINATION_CONVERGED;
+            return true;
+        }
+        if (patience_ && top_k_.size() == k_ && stale_hops_ >= patience_) {
+            stats_.reason = TERMINATION_PATIENCE;
+            return true;
+        }
+        if (max_distance_computations_ && stats_.distance_computations >= max_distance_computations_) {
+            stats_.reason = TERMINATION_BUDGET;
+            return true;
+        }
+        stats_.hops += 1;
+        stale_hops_ += 1;
+        return false;
+    }
+
+    bool should_consider_candidate(dist_t candidate_dist, dist_t lowerBound) override {
+        // called once for every distance computed on the base layer
+        stats_.distance_computations += 1;
+        return curr_num_items_ < ef_ || lowerBound > candidate_dist;
+    }
+
+    bool should_remove_extra() override {
+        return curr_num_items_ > ef_;
+    }
+
+    void filter_results(std::vector<std::pair<dist_t, labeltype >> &candidates) override {
+        while (candidates.size() > k_) {
+            candidates.pop_back();
+        }
+    }
+
+    const SearchTerminationStats &stats() const {
+        return stats_;
+    }
+
+    /*
+    * Patience learned from the stats of searches without limits: with it, the given
+    * fraction of the queries stops no earlier than the last change of its top-k.
+    */
+    static size_t learnPatience(const std::vector<SearchTerminationStats> &stats, float quantile = 0.99f) {
+        if (stats.empty()) return 0;
+        std::vector<size_t> stale_hops;
+        for (const SearchTerminationStats &s : stats) {
+            stale_hops.push_back(s.max_stale_hops);
+        }
+        std::sort(stale_hops.begin(), stale_hops.end());
+        size_t pos = (size_t) std::ceil(quantile * stale_hops.size());
+        pos = std::min(std::max<size_t>(pos, 1), stale_hops.size()) - 1;
+        return stale_hops[pos] + 1;
+    }
+
+    ~AdaptiveSearchStopCondition() {}
+};
 }  // namespace hnswlib
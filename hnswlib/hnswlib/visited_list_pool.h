@@ -3,23 +3,45 @@
 #include <mutex>
 #include <string.h>
 #include <deque>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <memory>
 
 namespace hnswlib {
 typedef unsigned short int vl_type;
+static const unsigned int VISITED_EMPTY_ID = (unsigned int) -1;
 
 class VisitedList {
  public:
     vl_type curV;
-    vl_type *mass;
+    vl_type *mass;  // nullptr in compact mode
     unsigned int numelements;
 
-    VisitedList(int numelements1) {
+    // Compact mode: open-addressing set of the ids visited by the current query,
+    // sized by the number of visited elements instead of the index size
+    std::vector<unsigned int> visited_ids;
+    size_t num_visited;
+
+    VisitedList(int numelements1, bool compact = false) {
         curV = -1;
         numelements = numelements1;
-        mass = new vl_type[numelements];
+        num_visited = 0;
+        if (compact) {
+            mass = nullptr;
+            visited_ids.assign(1024, VISITED_EMPTY_ID);
+        } else {
+            mass = new vl_type[numelements];
+        }
     }
 
     void reset() {
+        if (!mass) {
+            if (num_visited > 0)
+                std::fill(visited_ids.begin(), visited_ids.end(), VISITED_EMPTY_ID);
+            num_visited = 0;
+            return;
+        }
         curV++;
         if (curV == 0) {
             memset(mass, 0, sizeof(vl_type) * numelements);
@@ -27,35 +49,147 @@ class VisitedList {
         }
     }
 
+    // Marks the element visited, returns false if it already was
+    inline bool visit(unsigned int id) {
+        if (mass) {
+            if (mass[id] == curV)
+                return false;
+            mass[id] = curV;
+            return true;
+        }
+        return visitCompact(id);
+    }
+
     ~VisitedList() { delete[] mass; }
+
+ private:
+    bool visitCompact(unsigned int id) {
+        size_t mask = visited_ids.size() - 1;
+        size_t pos = (id * 0x9E3779B1u) & mask;
+        while (visited_ids[pos] != VISITED_EMPTY_ID) {
+            if (visited_ids[pos] == id)
+                return false;
+            pos = (pos + 1) & mask;
+        }
+        visited_ids[pos] = id;
+        num_visited++;
+        if (num_visited * 2 > visited_ids.size())
+            grow();
+        return true;
+    }
+
+    void grow() {
+        std::vector<unsigned int> old_ids(visited_ids.size() * 2, VISITED_EMPTY_ID);
+        old_ids.swap(visited_ids);
+        size_t mask = visited_ids.size() - 1;
+        for (unsigned int id : old_ids) {
+            if (id == VISITED_EMPTY_ID)
+                continue;
+            size_t pos = (id * 0x9E3779B1u) & mask;
+            while (visited_ids[pos] != VISITED_EMPTY_ID)
+                pos = (pos + 1) & mask;
+            visited_ids[pos] = id;
+        }
+    }
 };
 ///////////////////////////////////////////////////////////
 //
 // Class for multi-threaded pool-management of VisitedLists
 //
+// Each thread keeps the lists it released in a small thread-local cache, so that
+// the common case of one search per thread at a time never touches the shared pool
+// and its mutex. The lists stay owned by the pool: ~VisitedListPool (and so
+// resizeIndex) frees every list it created, including the ones sitting in thread
+// caches, and marks its shared state dead. A cache entry whose pool is dead is
+// dropped by the next lookup; entries of live pools go back to their pool on
+// eviction or thread exit.
+//
 /////////////////////////////////////////////////////////
 
 class VisitedListPool {
-    std::deque<VisitedList *> pool;
-    std::mutex poolguard;
+    // Outlives the pool while thread caches still reference it
+    struct PoolState {
+        std::mutex guard;
+        std::atomic<bool> alive{true};
+        std::deque<VisitedList *> free_lists;
+        std::vector<VisitedList *> all_lists;
+
+        // Puts a list back unless the pool already freed it
+        void giveBack(VisitedList *vl) {
+            std::unique_lock <std::mutex> lock(guard);
+            if (alive)
+                free_lists.push_front(vl);
+        }
+    };
+
+    std::shared_ptr<PoolState> state;
     int numelements;
+    bool compact;
+
+    static const int THREAD_CACHE_SIZE = 4;
+
+    struct CacheEntry {
+        std::shared_ptr<PoolState> state;
+        VisitedList *list = nullptr;
+    };
+
+    struct ThreadCache {
+        CacheEntry entries[THREAD_CACHE_SIZE];
+        int next_evict = 0;
+
+        ~ThreadCache() {
+            for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+                if (entries[i].list != nullptr)
+                    entries[i].state->giveBack(entries[i].list);
+            }
+        }
+    };
+
+    static ThreadCache &threadCache() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    VisitedList *newList() {
+        VisitedList *vl = new VisitedList(numelements, compact);
+        state->all_lists.push_back(vl);
+        return vl;
+    }
 
  public:
-    VisitedListPool(int initmaxpools, int numelements1) {
+    VisitedListPool(int initmaxpools, int numelements1, bool compact1 = false) {
         numelements = numelements1;
+        compact = compact1;
+        state = std::make_shared<PoolState>();
         for (int i = 0; i < initmaxpools; i++)
-            pool.push_front(new VisitedList(numelements));
+            state->free_lists.push_front(newList());
     }
 
     VisitedList *getFreeVisitedList() {
-        VisitedList *rez;
-        {
-            std::unique_lock <std::mutex> lock(poolguard);
-            if (pool.size() > 0) {
-                rez = pool.front();
-                pool.pop_front();
+        VisitedList *rez = nullptr;
+        ThreadCache &cache = threadCache();
+        for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+            CacheEntry &entry = cache.entries[i];
+            if (entry.list == nullptr)
+                continue;
+            if (entry.state == state) {
+                rez = entry.list;
+                entry.list = nullptr;
+                break;
+            }
+            if (!entry.state->alive) {
+                // the pool already freed the list
+                entry.list = nullptr;
+                entry.state.reset();
+            }
+        }
+        if (rez == nullptr) {
+            std::unique_lock <std::mutex> lock(state->guard);
+            if (state->free_lists.size() > 0) {
+                rez = state->free_lists.front();
+                state->free_lists.pop_front();
             } else {
-                rez = new VisitedList(numelements);
+                rez = newList();
             }
         }
         rez->reset();
@@ -63,16 +197,40 @@ class VisitedListPool {
     }
 
     void releaseVisitedList(VisitedList *vl) {
-        std::unique_lock <std::mutex> lock(poolguard);
-        pool.push_front(vl);
+        ThreadCache &cache = threadCache();
+        int slot = -1;
+        for (int i = 0; i < THREAD_CACHE_SIZE && slot < 0; i++) {
+            CacheEntry &entry = cache.entries[i];
+            if (entry.list == nullptr || !entry.state->alive)
+                slot = i;
+        }
+        if (slot < 0) {
+            // evict a list of another pool, lists of this pool go back to the shared pool
+            for (int n = 0; n < THREAD_CACHE_SIZE && slot < 0; n++) {
+                int i = (cache.next_evict + n) % THREAD_CACHE_SIZE;
+                if (cache.entries[i].state != state)
+                    slot = i;
+            }
+            if (slot < 0) {
+                state->giveBack(vl);
+                return;
+            }
+            cache.next_evict = (slot + 1) % THREAD_CACHE_SIZE;
+            cache.entries[slot].state->giveBack(cache.entries[slot].list);
+        }
+        CacheEntry &entry = cache.entries[slot];
+        if (entry.state != state)
+            entry.state = state;
+        entry.list = vl;
     }
 
     ~VisitedListPool() {
-        while (pool.size()) {
-            VisitedList *rez = pool.front();
-            pool.pop_front();
-            delete rez;
-        }
+        std::unique_lock <std::mutex> lock(state->guard);
+        state->alive = false;
+        for (VisitedList *vl : state->all_lists)
+            delete vl;
+        state->all_lists.clear();
+        state->free_lists.clear();
     }
 };
 }  // namespace hnswlib
@@ -0,0 +1,119 @@
+// This is a test file for the adaptive early termination (AdaptiveSearchStopCondition)
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+float recall(const std::vector<std::pair<float, idx_t>> &result, std::priority_queue<std::pair<float, idx_t>> gt) {
+    std::unordered_set<idx_t> expected;
+    size_t total = gt.size();
+    while (!gt.empty()) {
+        expected.insert(gt.top().second);
+        gt.pop();
+    }
+    size_t correct = 0;
+    for (const auto &item : result) {
+        correct += expected.count(item.second);
+    }
+    return (float) correct / total;
+}
+
+}  // namespace
+
+int main() {
+    int d = 16;
+    idx_t n = 20000;
+    size_t nq = 200;
+    size_t k = 10;
+    size_t ef = 100;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n, 16, 200);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    for (idx_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+
+    // Without limits the results are the same as searchKnn with the same ef
+    for (size_t i = 0; i < nq; i++) {
+        const void *p = query.data() + i * d;
+        hnswlib::AdaptiveSearchStopCondition<float> stop_condition(k, ef);
+        auto result = alg_hnsw.searchStopConditionClosest(p, stop_condition);
+        auto expected = alg_hnsw.searchKnn(p, k, nullptr, ef);
+        assert(result.size() == k);
+        for (size_t j = k; j-- > 0;) {
+            assert(result[j] == expected.top());
+            expected.pop();
+        }
+        const hnswlib::SearchTerminationStats &stats = stop_condition.stats();
+        assert(stats.reason == hnswlib::TERMINATION_CONVERGED);
+        assert(stats.hops > 0 && stats.distance_computations >= stats.hops);
+        assert(stats.max_stale_hops < stats.hops);
+    }
+
+    // The learned patience stops most queries early without changing their top-k
+    size_t patience = alg_hnsw.learnSearchPatience(ef, k, 200);
+    assert(patience > 0);
+    size_t full_work = 0, adaptive_work = 0, stopped = 0;
+    float full_recall = 0, adaptive_recall = 0;
+    for (size_t i = 0; i < nq; i++) {
+        const void *p = query.data() + i * d;
+        auto gt = alg_brute.searchKnn(p, k);
+        hnswlib::AdaptiveSearchStopCondition<float> full(k, ef);
+        full_recall += recall(alg_hnsw.searchStopConditionClosest(p, full), gt);
+        hnswlib::AdaptiveSearchStopCondition<float> adaptive(k, ef, patience);
+        adaptive_recall += recall(alg_hnsw.searchStopConditionClosest(p, adaptive), gt);
+        full_work += full.stats().distance_computations;
+        adaptive_work += adaptive.stats().distance_computations;
+        assert(adaptive.stats().hops <= full.stats().hops);
+        if (adaptive.stats().reason == hnswlib::TERMINATION_PATIENCE) {
+            stopped++;
+            assert(adaptive.stats().hops >= patience);
+        }
+    }
+    full_recall /= nq;
+    adaptive_recall /= nq;
+    std::cout << "Patience " << patience << ": " << stopped << " of " << nq << " queries stopped early, distance computations "
+              << full_work << " -> " << adaptive_work << ", recall " << full_recall << " -> " << adaptive_recall << std::endl;
+    assert(stopped > 0);
+    assert(adaptive_work < full_work);
+    assert(adaptive_recall >= full_recall - 0.02f);
+
+    // The budget bounds the work of every query
+    size_t budget = 300;
+    for (size_t i = 0; i < nq; i++) {
+        hnswlib::AdaptiveSearchStopCondition<float> stop_condition(k, ef, 0, budget);
+        auto result = alg_hnsw.searchStopConditionClosest(query.data() + i * d, stop_condition);
+        assert(result.size() == k);
+        assert(stop_condition.stats().reason == hnswlib::TERMINATION_BUDGET);
+        assert(stop_condition.stats().distance_computations < budget + 2 * 16);
+    }
+
+    // learnPatience picks the quantile of the longest stale runs
+    std::vector<hnswlib::SearchTerminationStats> stats(100);
+    for (size_t i = 0; i < stats.size(); i++) stats[i].max_stale_hops = i;
+    assert(hnswlib::AdaptiveSearchStopCondition<float>::learnPatience(stats, 0.99f) == 99);
+    assert(hnswlib::AdaptiveSearchStopCondition<float>::learnPatience(stats, 0.5f) == 50);
+    assert(hnswlib::AdaptiveSearchStopCondition<float>::learnPatience(stats, 1.0f) == 100);
+    assert(hnswlib::AdaptiveSearchStopCondition<float>::learnPatience(std::vector<hnswlib::SearchTerminationStats>()) == 0);
+
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
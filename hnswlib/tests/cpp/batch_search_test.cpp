@@ -0,0 +1,83 @@
+// This is a test file for the interleaved multi-query search
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+class PickOddIds : public hnswlib::BaseFilterFunctor {
+ public:
+    bool operator()(idx_t label_id) {
+        return label_id % 2 == 1;
+    }
+};
+
+void check_same(hnswlib::HierarchicalNSW<float> &alg, const std::vector<float> &query, size_t nq, size_t k,
+                hnswlib::BaseFilterFunctor *filter, size_t window) {
+    size_t d = query.size() / nq;
+    auto batch = alg.searchKnnBatch(query.data(), nq, k, filter, window);
+    assert(batch.size() == nq);
+    for (size_t j = 0; j < nq; ++j) {
+        auto expected = alg.searchKnn(query.data() + j * d, k, filter);
+        assert(batch[j].size() == expected.size());
+        while (!expected.empty()) {
+            assert(batch[j].top() == expected.top());
+            batch[j].pop();
+            expected.pop();
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    int d = 16;
+    idx_t n = 10000;
+    size_t nq = 37;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg(&space, n);
+    assert(alg.searchKnnBatch(query.data(), nq, k).size() == nq);
+    for (idx_t i = 0; i < n; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+    alg.setEf(40);
+
+    size_t windows[] = {1, 3, 8, 64};
+    std::cout << "Testing batch search ..." << std::endl;
+    for (size_t window : windows) {
+        check_same(alg, query, nq, k, nullptr, window);
+    }
+
+    std::cout << "Testing batch search with filter ..." << std::endl;
+    PickOddIds filter;
+    for (size_t window : windows) {
+        check_same(alg, query, nq, k, &filter, window);
+    }
+
+    std::cout << "Testing batch search with deleted elements ..." << std::endl;
+    for (idx_t i = 0; i < n; i += 3) {
+        alg.markDelete(i);
+    }
+    for (size_t window : windows) {
+        check_same(alg, query, nq, 50, nullptr, window);
+    }
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+// This is a test file for the runtime dispatched distance kernels
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <vector>
+#include <random>
+#include <iostream>
+
+namespace {
+
+const size_t dims[] = {1, 3, 4, 7, 15, 16, 17, 31, 32, 33, 100, 128, 131, 384, 768, 1000, 1024, 1536};
+const size_t fixed_dims[] = {128, 384, 768, 1024, 1536};
+
+bool close(float a, float b) {
+    return fabs(a - b) <= 1e-4f * std::max(1.0f, fabs(b));
+}
+
+void test_level(hnswlib::SimdLevel level) {
+    std::mt19937 rng(level);
+    std::uniform_real_distribution<float> distrib(-1, 1);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    for (size_t dim : dims) {
+        hnswlib::DISTFUNC<float> l2 = hnswlib::dispatchL2Sqr(level, dim);
+        hnswlib::DISTFUNC<float> ip = hnswlib::dispatchInnerProductDistance(level, dim);
+        hnswlib::DISTFUNC<int> l2i = hnswlib::dispatchL2SqrI(level);
+        if (l2 == nullptr) {
+            assert(ip == nullptr);
+            continue;
+        }
+
+        // Offset by one element so that unaligned loads are exercised
+        std::vector<float> a(dim + 1), b(dim + 1);
+        std::vector<unsigned char> ai(dim + 1), bi(dim + 1);
+        for (size_t i = 0; i <= dim; i++) {
+            a[i] = distrib(rng);
+            b[i] = distrib(rng);
+            ai[i] = bytes(rng);
+            bi[i] = bytes(rng);
+        }
+        assert(close(l2(&a[1], &b[1], &dim), hnswlib::L2Sqr(&a[1], &b[1], &dim)));
+        assert(close(ip(&a[1], &b[1], &dim), hnswlib::InnerProductDistance(&a[1], &b[1], &dim)));
+        if (l2i != nullptr)
+            assert(l2i(&ai[1], &bi[1], &dim) == hnswlib::L2SqrI(&ai[1], &bi[1], &dim));
+    }
+}
+
+// Production dimensions get their own kernel on every vectorized level
+void test_fixed_dims(hnswlib::SimdLevel level) {
+    if (level < hnswlib::SIMD_SSE || hnswlib::dispatchL2Sqr(hnswlib::SIMD_SSE, 128) == nullptr)
+        return;
+    for (size_t dim : fixed_dims) {
+        assert(hnswlib::dispatchL2Sqr(level, dim) != nullptr);
+        assert(hnswlib::dispatchL2Sqr(level, dim) != hnswlib::dispatchL2Sqr(level, dim + 1));
+        assert(hnswlib::dispatchInnerProductDistance(level, dim) != hnswlib::dispatchInnerProductDistance(level, dim + 1));
+    }
+}
+
+// The spaces must pick up the kernel of the detected level
+void test_spaces() {
+    hnswlib::SimdLevel level = hnswlib::getSimdLevel();
+    for (size_t dim : dims) {
+        hnswlib::L2Space l2(dim);
+        hnswlib::InnerProductSpace ip(dim);
+        hnswlib::L2SpaceI l2i(dim);
+        if (hnswlib::dispatchL2Sqr(level, dim) != nullptr) {
+            assert(l2.get_dist_func() == hnswlib::dispatchL2Sqr(level, dim));
+            assert(ip.get_dist_func() == hnswlib::dispatchInnerProductDistance(level, dim));
+        }
+        if (hnswlib::dispatchL2SqrI(level) != nullptr) {
+            assert(l2i.get_dist_func() == hnswlib::dispatchL2SqrI(level));
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    hnswlib::SimdLevel level = hnswlib::getSimdLevel();
+    std::cout << "Detected SIMD level: " << hnswlib::simdLevelName(level) << std::endl;
+
+    for (int l = hnswlib::SIMD_SCALAR; l <= level; l++) {
+        std::cout << "Testing " << hnswlib::simdLevelName((hnswlib::SimdLevel) l) << " kernels" << std::endl;
+        test_level((hnswlib::SimdLevel) l);
+        test_fixed_dims((hnswlib::SimdLevel) l);
+    }
+    test_spaces();
+
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+// This is a test file for the per-call ef and the recall measurement used for ef calibration
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+typedef std::priority_queue<std::pair<float, idx_t>> Result;
+
+void check_same(Result a, Result b) {
+    assert(a.size() == b.size());
+    while (!a.empty()) {
+        assert(a.top() == b.top());
+        a.pop();
+        b.pop();
+    }
+}
+
+}  // namespace
+
+int main() {
+    int d = 16;
+    idx_t n = 10000;
+    size_t nq = 50;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg(&space, n, 8, 100);
+    assert(alg.measureRecall({10, 50}, 10, k) == std::vector<float>(2, 0));
+    for (idx_t i = 0; i < n; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+
+    // A per-call ef gives the same results as setEf
+    std::vector<size_t> ef_values = {10, 20, 50, 200};
+    std::vector<std::vector<Result>> expected(ef_values.size());
+    for (size_t e = 0; e < ef_values.size(); ++e) {
+        alg.setEf(ef_values[e]);
+        for (size_t j = 0; j < nq; ++j) {
+            expected[e].push_back(alg.searchKnn(query.data() + j * d, k));
+        }
+        auto batch = alg.searchKnnBatch(query.data(), nq, k);
+        for (size_t j = 0; j < nq; ++j) {
+            check_same(batch[j], expected[e][j]);
+        }
+    }
+    alg.setEf(10);
+    for (size_t e = 0; e < ef_values.size(); ++e) {
+        auto batch = alg.searchKnnBatch(query.data(), nq, k, nullptr, 8, ef_values[e]);
+        for (size_t j = 0; j < nq; ++j) {
+            check_same(alg.searchKnn(query.data() + j * d, k, nullptr, ef_values[e]), expected[e][j]);
+            check_same(batch[j], expected[e][j]);
+        }
+    }
+
+    // Concurrent searches with different ef values do not affect each other
+    std::vector<std::thread> threads;
+    for (size_t e = 0; e < ef_values.size(); ++e) {
+        threads.push_back(std::thread([&, e]() {
+            for (int repeat = 0; repeat < 20; ++repeat) {
+                for (size_t j = 0; j < nq; ++j) {
+                    check_same(alg.searchKnn(query.data() + j * d, k, nullptr, ef_values[e]), expected[e][j]);
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Recall grows with ef and is close to 1 for a large ef
+    auto recalls = alg.measureRecall(ef_values, 200, k);
+    assert(recalls.size() == ef_values.size());
+    for (size_t e = 0; e < ef_values.size(); ++e) {
+        std::cout << "ef " << ef_values[e] << ": recall " << recalls[e] << std::endl;
+    }
+    assert(recalls.front() < recalls.back());
+    assert(recalls.back() >= 0.99f);
+    assert(alg.measureRecall(ef_values, 200, k) == recalls);
+
+    // Deleted elements are neither used as queries nor as exact neighbors
+    for (idx_t i = 0; i < n; i += 2) {
+        alg.markDelete(i);
+    }
+    auto recalls_deleted = alg.measureRecall({200}, 200, k);
+    std::cout << "ef 200 with deletions: recall " << recalls_deleted[0] << std::endl;
+    assert(recalls_deleted[0] >= 0.99f);
+
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
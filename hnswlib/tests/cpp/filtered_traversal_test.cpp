@@ -0,0 +1,228 @@
+// This is a test file for the two-hop filtered traversal (searchKnnFiltered)
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+class PickDivisibleIds : public hnswlib::BaseFilterFunctor {
+    unsigned int divisor = 1;
+ public:
+    PickDivisibleIds(unsigned int divisor): divisor(divisor) {
+        assert(divisor != 0);
+    }
+    bool operator()(idx_t label_id) {
+        return label_id % divisor == 0;
+    }
+};
+
+class SkipDivisibleIds : public hnswlib::BaseFilterFunctor {
+    unsigned int divisor = 1;
+ public:
+    SkipDivisibleIds(unsigned int divisor): divisor(divisor) {
+        assert(divisor != 0);
+    }
+    bool operator()(idx_t label_id) {
+        return label_id % divisor != 0;
+    }
+};
+
+// Ids stored in a set, used for a filter that is correlated with the data
+class PickIdSet : public hnswlib::BaseFilterFunctor {
+    const std::unordered_set<idx_t> &ids;
+ public:
+    PickIdSet(const std::unordered_set<idx_t> &ids): ids(ids) {}
+    bool operator()(idx_t label_id) {
+        return ids.count(label_id) != 0;
+    }
+};
+
+// L2 space that counts the distance computations of the searches
+size_t num_distances = 0;
+
+class CountingL2Space : public hnswlib::SpaceInterface<float> {
+    hnswlib::L2Space space_;
+
+    static float dist(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+        num_distances++;
+        return hnswlib::L2Sqr(pVect1, pVect2, qty_ptr);
+    }
+
+ public:
+    CountingL2Space(size_t dim): space_(dim) {}
+
+    size_t get_data_size() {
+        return space_.get_data_size();
+    }
+
+    hnswlib::DISTFUNC<float> get_dist_func() {
+        return dist;
+    }
+
+    void *get_dist_func_param() {
+        return space_.get_dist_func_param();
+    }
+};
+
+float recall(hnswlib::HierarchicalNSW<float> &alg_hnsw, hnswlib::BruteforceSearch<float> &alg_brute,
+             const std::vector<float> &query, int d, size_t nq, size_t k,
+             hnswlib::BaseFilterFunctor &filter, bool filtered_traversal, const std::vector<idx_t> &entry_labels) {
+    size_t correct = 0, total = 0;
+    for (size_t i = 0; i < nq; i++) {
+        const void *p = query.data() + i * d;
+        auto gt = alg_brute.searchKnn(p, k, &filter);
+        auto res = filtered_traversal ? alg_hnsw.searchKnnFiltered(p, k, &filter, entry_labels) : alg_hnsw.searchKnn(p, k, &filter);
+        std::unordered_set<idx_t> expected;
+        total += gt.size();
+        while (!gt.empty()) {
+            expected.insert(gt.top().second);
+            gt.pop();
+        }
+        while (!res.empty()) {
+            assert(filter(res.top().second));
+            correct += expected.count(res.top().second);
+            res.pop();
+        }
+    }
+    return (float) correct / total;
+}
+
+}  // namespace
+
+int main() {
+    int d = 16;
+    idx_t n = 20000;
+    size_t nq = 200;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    CountingL2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n, 16, 200);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    for (idx_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.setEf(30);
+
+    // 2% of the elements, spread over the whole space
+    PickDivisibleIds spread(50);
+    std::vector<idx_t> spread_entries;
+    for (idx_t i = 0; i < 16; i++) spread_entries.push_back(i * 50 * 25);
+    float base_spread = recall(alg_hnsw, alg_brute, query, d, nq, k, spread, false, spread_entries);
+    float acorn_spread = recall(alg_hnsw, alg_brute, query, d, nq, k, spread, true, spread_entries);
+    std::cout << "2% spread filter: recall " << base_spread << " -> " << acorn_spread << std::endl;
+    assert(acorn_spread >= 0.9f);
+
+    // From 0.5% to 5% of the elements the traversal keeps up with searchKnn
+    for (unsigned int divisor : {200, 100, 20}) {
+        PickDivisibleIds filter(divisor);
+        std::vector<idx_t> entries;
+        for (idx_t i = 0; i < 16; i++) entries.push_back(i * (n / 16 / divisor) * divisor);
+        float base = recall(alg_hnsw, alg_brute, query, d, nq, k, filter, false, entries);
+        float acorn = recall(alg_hnsw, alg_brute, query, d, nq, k, filter, true, entries);
+        std::cout << 100.0f / divisor << "% spread filter: recall " << base << " -> " << acorn << std::endl;
+        assert(acorn >= 0.97f);
+        assert(acorn >= base - 0.02f);
+    }
+
+    // searchKnn gets there only by computing distances to most of the graph. Given the number
+    // of distance computations searchKnnFiltered needed, its recall is low
+    for (unsigned int divisor : {200, 100}) {
+        PickDivisibleIds filter(divisor);
+        std::vector<idx_t> entries;
+        for (idx_t i = 0; i < 16; i++) entries.push_back(i * (n / 16 / divisor) * divisor);
+        size_t acorn_distances = 0, base_distances = 0;
+        size_t acorn_correct = 0, budget_correct = 0, total = 0;
+        for (size_t i = 0; i < nq; i++) {
+            const void *p = query.data() + i * d;
+            auto gt = alg_brute.searchKnn(p, k, &filter);
+            std::unordered_set<idx_t> expected;
+            total += gt.size();
+            while (!gt.empty()) {
+                expected.insert(gt.top().second);
+                gt.pop();
+            }
+
+            num_distances = 0;
+            auto res = alg_hnsw.searchKnnFiltered(p, k, &filter, entries);
+            size_t budget = num_distances;
+            acorn_distances += budget;
+            while (!res.empty()) {
+                acorn_correct += expected.count(res.top().second);
+                res.pop();
+            }
+
+            num_distances = 0;
+            alg_hnsw.searchKnn(p, k, &filter);
+            base_distances += num_distances;
+
+            hnswlib::AdaptiveSearchStopCondition<float> stop_condition(k, 30, 0, budget);
+            auto budget_res = alg_hnsw.searchStopConditionClosest(p, stop_condition, &filter);
+            for (auto &r : budget_res) budget_correct += expected.count(r.second);
+        }
+        float acorn = (float) acorn_correct / total;
+        float budget = (float) budget_correct / total;
+        std::cout << 100.0f / divisor << "% spread filter: " << base_distances / nq << " distances for searchKnn, "
+                  << acorn_distances / nq << " for searchKnnFiltered, recall with that budget "
+                  << budget << " -> " << acorn << std::endl;
+        assert(base_distances > 10 * acorn_distances);
+        assert(budget <= 0.5f);
+        assert(acorn >= budget + 0.4f);
+    }
+
+    // 2% of the elements in one corner of the space, away from most queries
+    std::unordered_set<idx_t> corner;
+    for (idx_t i = 0; i < n; ++i) {
+        if (data[i * d] > 0.8f && data[i * d + 1] > 0.9f) corner.insert(i);
+    }
+    std::vector<idx_t> corner_entries(corner.begin(), corner.end());
+    corner_entries.resize(std::min<size_t>(corner_entries.size(), 16));
+    PickIdSet corner_filter(corner);
+    float base_corner = recall(alg_hnsw, alg_brute, query, d, nq, k, corner_filter, false, corner_entries);
+    float acorn_corner = recall(alg_hnsw, alg_brute, query, d, nq, k, corner_filter, true, corner_entries);
+    std::cout << "Correlated filter (" << corner.size() << " elements): recall " << base_corner << " -> " << acorn_corner << std::endl;
+    assert(acorn_corner >= 0.9f);
+
+    // Deleted elements never show up, also when no filter is given
+    for (idx_t i = 0; i < n; i += 100) alg_hnsw.markDelete(i);
+    SkipDivisibleIds not_deleted(100);
+    size_t correct = 0;
+    for (size_t i = 0; i < nq; i++) {
+        const void *p = query.data() + i * d;
+        auto gt = alg_brute.searchKnn(p, k, &not_deleted);
+        auto res = alg_hnsw.searchKnnFiltered(p, k, nullptr);
+        assert(res.size() == k);
+        std::unordered_set<idx_t> expected;
+        while (!gt.empty()) {
+            expected.insert(gt.top().second);
+            gt.pop();
+        }
+        while (!res.empty()) {
+            assert(res.top().second % 100 != 0);
+            correct += expected.count(res.top().second);
+            res.pop();
+        }
+    }
+    float deleted = (float) correct / (nq * k);
+    std::cout << "Unfiltered with deletions: recall " << deleted << std::endl;
+    assert(deleted >= 0.9f);
+
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
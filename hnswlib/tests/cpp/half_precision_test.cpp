@@ -0,0 +1,143 @@
+// This is a test file for the fp16 and bf16 spaces
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <vector>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void test_conversion() {
+    float values[] = {0.0f, -0.0f, 1.0f, -2.5f, 0.333333f, 65504.0f, 1e-5f, 6.1e-5f, -1e-7f};
+    for (float v : values) {
+        float fp16 = hnswlib::fp16ToFloat(hnswlib::floatToFp16(v));
+        float bf16 = hnswlib::bf16ToFloat(hnswlib::floatToBf16(v));
+        assert(fabs(fp16 - v) <= fabs(v) * 1e-3f + 6e-8f);
+        assert(fabs(bf16 - v) <= fabs(v) * 8e-3f);
+    }
+    assert(hnswlib::floatToFp16(1e6f) == 0x7C00);
+    assert(hnswlib::floatToFp16(1.0f) == 0x3C00);
+    assert(hnswlib::floatToBf16(1.0f) == 0x3F80);
+}
+
+// Compares the kernels with float32 distances between the decoded vectors
+template<typename Space>
+void test_distances(bool is_fp16, bool is_ip) {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1.0, 1.0);
+
+    size_t dims[] = {1, 7, 16, 33, 100, 128};
+    for (size_t d : dims) {
+        Space space(d);
+        hnswlib::L2Space l2_space(d);
+        hnswlib::InnerProductSpace ip_space(d);
+        assert(space.get_data_size() == d * sizeof(uint16_t));
+
+        std::vector<float> a(d), b(d), a_dec(d), b_dec(d);
+        std::vector<uint16_t> a_code(d), b_code(d);
+        for (size_t i = 0; i < d; i++) {
+            a[i] = distrib(rng);
+            b[i] = distrib(rng);
+        }
+        if (is_fp16) {
+            hnswlib::convertFloatToFp16(a.data(), a_code.data(), d);
+            hnswlib::convertFloatToFp16(b.data(), b_code.data(), d);
+            hnswlib::convertFp16ToFloat(a_code.data(), a_dec.data(), d);
+            hnswlib::convertFp16ToFloat(b_code.data(), b_dec.data(), d);
+        } else {
+            hnswlib::convertFloatToBf16(a.data(), a_code.data(), d);
+            hnswlib::convertFloatToBf16(b.data(), b_code.data(), d);
+            hnswlib::convertBf16ToFloat(a_code.data(), a_dec.data(), d);
+            hnswlib::convertBf16ToFloat(b_code.data(), b_dec.data(), d);
+        }
+
+        float expected = is_ip ?
+            ip_space.get_dist_func()(a_dec.data(), b_dec.data(), ip_space.get_dist_func_param()) :
+            l2_space.get_dist_func()(a_dec.data(), b_dec.data(), l2_space.get_dist_func_param());
+        float got = space.get_dist_func()(a_code.data(), b_code.data(), space.get_dist_func_param());
+        assert(fabs(expected - got) <= 1e-4f * (1.0f + fabs(expected)));
+    }
+}
+
+template<typename Space>
+void test_recall(bool is_fp16) {
+    int d = 32;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    std::vector<uint16_t> data(n * d);
+    std::vector<uint16_t> query(nq * d);
+    std::vector<float> buffer(d);
+    for (idx_t i = 0; i < n + nq; ++i) {
+        for (int j = 0; j < d; j++) {
+            buffer[j] = distrib(rng);
+        }
+        uint16_t *dst = i < n ? data.data() + i * d : query.data() + (i - n) * d;
+        if (is_fp16) {
+            hnswlib::convertFloatToFp16(buffer.data(), dst, d);
+        } else {
+            hnswlib::convertFloatToBf16(buffer.data(), dst, d);
+        }
+    }
+
+    Space space(d);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n);
+    alg_hnsw.setEf(100);
+    for (idx_t i = 0; i < n; ++i) {
+        alg_brute.addPoint(data.data() + d * i, i);
+        alg_hnsw.addPoint(data.data() + d * i, i);
+    }
+
+    float correct = 0;
+    for (idx_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw.searchKnn(p, k);
+        std::unordered_set<idx_t> gt_labels;
+        while (!gd.empty()) {
+            gt_labels.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (gt_labels.count(res.top().second))
+                correct += 1;
+            res.pop();
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << "\n";
+    assert(recall > 0.95);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing conversions ..." << std::endl;
+    test_conversion();
+
+    std::cout << "Testing distances ..." << std::endl;
+    test_distances<hnswlib::L2SpaceFp16>(true, false);
+    test_distances<hnswlib::InnerProductSpaceFp16>(true, true);
+    test_distances<hnswlib::L2SpaceBf16>(false, false);
+    test_distances<hnswlib::InnerProductSpaceBf16>(false, true);
+
+    std::cout << "Testing recall ..." << std::endl;
+    test_recall<hnswlib::L2SpaceFp16>(true);
+    test_recall<hnswlib::L2SpaceBf16>(false);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
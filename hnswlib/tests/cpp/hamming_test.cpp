@@ -0,0 +1,134 @@
+// This is a test file for the Hamming space and its popcount kernels
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <random>
+#include <iostream>
+
+namespace {
+
+const size_t code_sizes[] = {1, 3, 8, 13, 16, 32, 40, 64, 65, 96, 128, 200, 256};
+
+// Bit by bit reference
+size_t naive_hamming(const unsigned char *a, const unsigned char *b, size_t code_size) {
+    size_t res = 0;
+    for (size_t i = 0; i < code_size * 8; i++) {
+        res += ((a[i / 8] >> (i % 8)) & 1) != ((b[i / 8] >> (i % 8)) & 1);
+    }
+    return res;
+}
+
+void test_kernels() {
+    std::mt19937 rng(47);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    for (size_t code_size : code_sizes) {
+        // Offset by one byte so that unaligned loads are exercised
+        std::vector<unsigned char> a(code_size + 1), b(code_size + 1);
+        for (size_t i = 0; i <= code_size; i++) {
+            a[i] = bytes(rng);
+            b[i] = bytes(rng);
+        }
+        float expected = (float) naive_hamming(&a[1], &b[1], code_size);
+        assert(hnswlib::HammingDistance(&a[1], &b[1], &code_size) == expected);
+        assert(hnswlib::HammingDistance(&a[1], &a[1], &code_size) == 0);
+        if (hnswlib::DISTFUNC<float> dispatched = hnswlib::dispatchHamming(code_size))
+            assert(dispatched(&a[1], &b[1], &code_size) == expected);
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+        if (POPCNTCapable())
+            assert(hnswlib::HammingDistancePOPCNT(&a[1], &b[1], &code_size) == expected);
+        if (AVX512VPOPCNTDQCapable())
+            assert(hnswlib::HammingDistanceAVX512VPOPCNTDQ(&a[1], &b[1], &code_size) == expected);
+#endif
+    }
+}
+
+void test_space() {
+    hnswlib::HammingSpace space(256);
+    assert(space.get_data_size() == 32);
+    assert(*(size_t *) space.get_dist_func_param() == 32);
+    if (hnswlib::dispatchHamming(32) != nullptr)
+        assert(space.get_dist_func() == hnswlib::dispatchHamming(32));
+
+    bool thrown = false;
+    try {
+        hnswlib::HammingSpace bad(100);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// 256-bit codes, the HNSW results are compared with brute force
+void test_recall() {
+    size_t dim = 256;
+    size_t code_size = dim / 8;
+    int max_elements = 5000;
+    int nq = 100;
+    size_t k = 10;
+
+    std::mt19937 rng(123);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::vector<unsigned char> data(max_elements * code_size);
+    std::vector<unsigned char> query(nq * code_size);
+    for (auto &c : data) c = bytes(rng);
+    // Queries are perturbed copies of stored codes, as for near-duplicate hashes
+    std::uniform_int_distribution<size_t> pick(0, max_elements - 1);
+    std::uniform_int_distribution<size_t> bit(0, dim - 1);
+    for (int q = 0; q < nq; q++) {
+        memcpy(&query[q * code_size], &data[pick(rng) * code_size], code_size);
+        for (int flip = 0; flip < 20; flip++) {
+            size_t b = bit(rng);
+            query[q * code_size + b / 8] ^= (unsigned char) (1 << (b % 8));
+        }
+    }
+
+    hnswlib::HammingSpace space(dim);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, max_elements);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, max_elements, 16, 200);
+    for (int i = 0; i < max_elements; i++) {
+        alg_brute.addPoint(&data[i * code_size], i);
+        alg_hnsw.addPoint(&data[i * code_size], i);
+    }
+    alg_hnsw.setEf(100);
+
+    float correct = 0;
+    for (int q = 0; q < nq; q++) {
+        const void *p = &query[q * code_size];
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw.searchKnn(p, k);
+        assert(res.size() == k);
+        // Many codes share a distance, so compare by distance instead of label
+        std::vector<float> gt_dist, res_dist;
+        for (; !gd.empty(); gd.pop()) gt_dist.push_back(gd.top().first);
+        for (; !res.empty(); res.pop()) {
+            res_dist.push_back(res.top().first);
+            assert(res.top().first == hnswlib::HammingDistance(p, &data[res.top().second * code_size], &code_size));
+        }
+        for (size_t j = 0; j < k; j++) {
+            if (res_dist[j] <= gt_dist[0])
+                correct += 1;
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << "\n";
+    assert(recall > 0.9);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing kernels ..." << std::endl;
+    test_kernels();
+
+    std::cout << "Testing space ..." << std::endl;
+    test_space();
+
+    std::cout << "Testing recall ..." << std::endl;
+    test_recall();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+// This is a test file for the flat label map used by HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+typedef hnswlib::LabelMap<hnswlib::labeltype, hnswlib::tableint> LabelMap;
+
+void test_operations() {
+    LabelMap map;
+    std::unordered_map<hnswlib::labeltype, hnswlib::tableint> expected;
+    assert(map.empty());
+    assert(map.find(1) == map.end());
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_int_distribution<hnswlib::labeltype> distrib_label(0, 5000);
+    for (int i = 0; i < 100000; i++) {
+        hnswlib::labeltype label = distrib_label(rng);
+        if (i % 3 == 0) {
+            assert(map.erase(label) == expected.erase(label));
+        } else {
+            map.insert_or_assign(label, i);
+            expected[label] = i;
+        }
+        assert(map.size() == expected.size());
+    }
+    // labels far apart and at the extremes of the range
+    hnswlib::labeltype extremes[] = {0, (hnswlib::labeltype) -1, (hnswlib::labeltype) 1 << 40};
+    for (hnswlib::labeltype label : extremes) {
+        map.insert_or_assign(label, 7);
+        expected[label] = 7;
+    }
+    assert(!map.insert(std::make_pair((hnswlib::labeltype) 0, (hnswlib::tableint) 8)));
+
+    size_t visited = 0;
+    for (auto item : map) {
+        assert(expected.at(item.first) == item.second);
+        visited++;
+    }
+    assert(visited == expected.size());
+    for (auto &item : expected) {
+        auto search = map.find(item.first);
+        assert(search != map.end());
+        assert(search->second == item.second);
+    }
+
+    map.clear();
+    assert(map.size() == 0 && map.begin() == map.end());
+}
+
+// Readers look labels up without locks while a single writer keeps inserting
+void test_concurrent_readers() {
+    LabelMap map;
+    hnswlib::labeltype n = 200000;
+    std::atomic<hnswlib::labeltype> published{0};
+    std::atomic<bool> done{false};
+    std::atomic<size_t> errors{0};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            while (!done.load()) {
+                hnswlib::labeltype limit = published.load(std::memory_order_acquire);
+                if (limit == 0)
+                    continue;
+                hnswlib::labeltype label = rng() % limit;
+                auto search = map.find(label * 3);
+                if (search == map.end() || search->second != label)
+                    errors++;
+            }
+        });
+    }
+    for (hnswlib::labeltype i = 0; i < n; i++) {
+        map.insert_or_assign(i * 3, (hnswlib::tableint) i);
+        published.store(i + 1, std::memory_order_release);
+    }
+    done = true;
+    for (auto &reader : readers) reader.join();
+    assert(errors == 0);
+    assert(map.size() == n);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing operations ..." << std::endl;
+    test_operations();
+    std::cout << "Testing concurrent readers ..." << std::endl;
+    test_concurrent_readers();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
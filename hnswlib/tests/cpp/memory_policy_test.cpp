@@ -0,0 +1,127 @@
+// This is a test file for huge page and NUMA placement of the base layer
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void test_buffer(const hnswlib::MemoryPolicy &policy) {
+    size_t mapped_size;
+    size_t size = 5 * 1024 * 1024 + 123;
+    char *buffer = (char *) hnswlib::allocateLargeBuffer(size, policy, mapped_size);
+    assert(buffer != nullptr);
+    assert(policy.isDefault() ? mapped_size == 0 : mapped_size >= size);
+    memset(buffer, 7, size);
+    assert(buffer[size - 1] == 7);
+    hnswlib::applyMemoryPolicy(buffer, size, policy);
+    hnswlib::freeLargeBuffer(buffer, mapped_size);
+}
+
+// The placement must not change anything observable
+void test_index(const hnswlib::MemoryPolicy &policy) {
+    int d = 16;
+    idx_t n = 4000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg_default(&space, n);
+    hnswlib::HierarchicalNSW<float> alg(&space, n / 2);
+    for (idx_t i = 0; i < n / 2; ++i) {
+        alg_default.addPoint(data.data() + d * i, i);
+        alg.addPoint(data.data() + d * i, i);
+    }
+    alg.setMemoryPolicy(policy);
+    alg.resizeIndex(n);
+    for (idx_t i = n / 2; i < n; ++i) {
+        alg_default.addPoint(data.data() + d * i, i);
+        alg.addPoint(data.data() + d * i, i);
+    }
+    alg_default.setEf(50);
+    alg.setEf(50);
+    for (idx_t j = 0; j < nq; ++j) {
+        assert(alg.searchKnnCloserFirst(query.data() + j * d, k) == alg_default.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+
+    alg.reorderGraph(hnswlib::REORDER_BFS);
+    alg.saveIndex("memory_policy_test.bin");
+    hnswlib::HierarchicalNSW<float> loaded(&space);
+    loaded.setMemoryPolicy(policy);
+    loaded.loadIndex("memory_policy_test.bin", &space);
+    loaded.setEf(50);
+    for (idx_t j = 0; j < nq; ++j) {
+        assert(loaded.searchKnnCloserFirst(query.data() + j * d, k) == alg.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+    remove("memory_policy_test.bin");
+
+#ifdef HNSWLIB_USE_MMAP
+    // the policy is applied to the mapping in place
+    alg.saveIndexMapped("memory_policy_test.bin");
+    hnswlib::HierarchicalNSW<float> mapped(&space);
+    mapped.setMemoryPolicy(policy);
+    mapped.loadIndexMapped("memory_policy_test.bin", &space, n + 100);
+    mapped.setEf(50);
+    for (idx_t j = 0; j < nq; ++j) {
+        assert(mapped.searchKnnCloserFirst(query.data() + j * d, k) == alg.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+    mapped.addPoint(query.data(), n);
+    assert(mapped.searchKnn(query.data(), 1).top().second == n);
+    remove("memory_policy_test.bin");
+#endif
+}
+
+void test_invalid_node() {
+    hnswlib::MemoryPolicy policy;
+    policy.numa = hnswlib::NUMA_BIND;
+    policy.numa_node = hnswlib::MAX_NUMA_NODES;
+    assert(!policy.isValid());
+    // ignored by the low level helpers, rejected by the index
+    test_buffer(policy);
+    hnswlib::L2Space space(16);
+    hnswlib::HierarchicalNSW<float> alg(&space, 100);
+    bool thrown = false;
+    try {
+        alg.setMemoryPolicy(policy);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    policy.numa_node = -1;
+    assert(!policy.isValid());
+}
+
+}  // namespace
+
+int main() {
+    hnswlib::MemoryPolicy policies[4];
+    policies[1].huge_pages = hnswlib::HUGE_PAGES_TRANSPARENT;
+    policies[2].huge_pages = hnswlib::HUGE_PAGES_EXPLICIT;
+    policies[2].numa = hnswlib::NUMA_BIND;
+    policies[3].huge_pages = hnswlib::HUGE_PAGES_TRANSPARENT;
+    policies[3].numa = hnswlib::NUMA_INTERLEAVE;
+
+    for (int i = 0; i < 4; i++) {
+        std::cout << "Testing policy " << i << " ..." << std::endl;
+        test_buffer(policies[i]);
+        test_index(policies[i]);
+    }
+    std::cout << "Testing invalid NUMA node ..." << std::endl;
+    test_invalid_node();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
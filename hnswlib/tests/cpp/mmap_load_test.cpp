@@ -0,0 +1,124 @@
+// This is a test file for saveIndexMapped / loadIndexMapped
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void check_same_results(hnswlib::HierarchicalNSW<float>& a, hnswlib::HierarchicalNSW<float>& b,
+                        const std::vector<float>& query, size_t nq, int d, size_t k) {
+    for (size_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        auto ra = a.searchKnnCloserFirst(p, k);
+        auto rb = b.searchKnnCloserFirst(p, k);
+        assert(ra.size() == rb.size());
+        for (size_t i = 0; i < ra.size(); ++i) {
+            assert(ra[i].second == rb[i].second);
+            assert(ra[i].first == rb[i].first);
+        }
+    }
+}
+
+void test(hnswlib::MmapWarmup warmup) {
+    int d = 16;
+    idx_t n = 3000;
+    idx_t n_extra = 500;
+    idx_t nq = 50;
+    size_t k = 10;
+    std::string path = "mmap_load_test.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data((n + n_extra) * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg(&space, n + n_extra);
+    for (idx_t i = 0; i < n; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+    alg.markDelete(7);
+    alg.markDelete(42);
+    alg.saveIndexMapped(path);
+    assert(hnswlib::HierarchicalNSW<float>::isMappedIndexFile(path));
+
+    // Search results of the mapped index must match the original
+    hnswlib::HierarchicalNSW<float> mapped(&space);
+    mapped.loadIndexMapped(path, &space, n + n_extra, warmup);
+    assert(mapped.cur_element_count == n);
+    assert(mapped.getDeletedCount() == 2);
+    mapped.setEf(50);
+    alg.setEf(50);
+    check_same_results(alg, mapped, query, nq, d, k);
+
+    // The mapped index stays writable: add new elements after the mapped ones
+    for (idx_t i = n; i < n + n_extra; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+        mapped.addPoint(data.data() + d * i, i);
+    }
+    check_same_results(alg, mapped, query, nq, d, k);
+
+    // Saving over the file we are mapped from and resizing must keep the index intact
+    mapped.saveIndexMapped(path);
+    mapped.resizeIndex(n + n_extra + 100);
+    check_same_results(alg, mapped, query, nq, d, k);
+
+    hnswlib::HierarchicalNSW<float> reloaded(&space);
+    reloaded.loadIndexMapped(path, &space, 0, warmup);
+    assert(reloaded.cur_element_count == n + n_extra);
+    reloaded.setEf(50);
+    check_same_results(alg, reloaded, query, nq, d, k);
+
+    // A file whose levels do not match its links arena is rejected after the mappings are
+    // made; the index keeps its previous contents
+    std::string corrupt_path = "mmap_load_test_corrupt.bin";
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uint64_t levels_offset;
+        memcpy(&levels_offset, bytes.data() + 120, sizeof(levels_offset));
+        int *levels = (int *) (bytes.data() + levels_offset);
+        size_t i = 0;
+        while (levels[i] != 0) i++;
+        levels[i] = 1;
+        std::ofstream out(corrupt_path, std::ios::binary);
+        out.write(bytes.data(), bytes.size());
+    }
+    bool thrown = false;
+    try {
+        reloaded.loadIndexMapped(corrupt_path, &space, 0, warmup);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(reloaded.cur_element_count == n + n_extra);
+    check_same_results(alg, reloaded, query, nq, d, k);
+
+    remove(corrupt_path.c_str());
+    remove(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing without warmup ..." << std::endl;
+    test(hnswlib::MMAP_WARMUP_NONE);
+    std::cout << "Testing with MADV_WILLNEED ..." << std::endl;
+    test(hnswlib::MMAP_WARMUP_WILLNEED);
+    std::cout << "Testing with MAP_POPULATE ..." << std::endl;
+    test(hnswlib::MMAP_WARMUP_POPULATE);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -119,7 +119,46 @@ int main() {
     std::cout << "same elements search recall : " << recall << "\n";
     assert(recall > 0.99);
 
+    // The inner product space passes the dimension to the distance function,
+    // results are reported with the external labels
+    hnswlib::labeltype label_offset = 100000;
+    hnswlib::MultiVectorInnerProductSpace<docidtype> ip_space(dim);
+    assert(*(size_t*)ip_space.get_dist_func_param() == (size_t)dim);
+    hnswlib::HierarchicalNSW<dist_t>* alg_ip = new hnswlib::HierarchicalNSW<dist_t>(&ip_space, max_elements, M, ef_construction);
+    for (int i = 0; i < max_elements; i++) {
+        alg_ip->addPoint(data + i * data_point_size, label_offset + i);
+    }
+    correct = 0;
+    for (int i = 0; i < num_queries; i++) {
+        const char* query_data = data + i * data_point_size;
+        hnswlib::MultiVectorSearchStopCondition<docidtype, dist_t> stop_condition(ip_space, num_docs, ef_collection);
+        std::vector<std::pair<float, hnswlib::labeltype>> result =
+            alg_ip->searchStopConditionClosest(query_data, stop_condition);
+        std::unordered_set<docidtype> ip_docs;
+        for (auto pair: result) {
+            assert(pair.second >= label_offset);
+            ip_docs.emplace(label_docid_lookup[pair.second - label_offset]);
+        }
+        assert(ip_docs.size() == num_docs);
+
+        // The closest document is the one of the element with the largest inner product
+        dist_t best = 0;
+        hnswlib::labeltype best_label = 0;
+        for (int j = 0; j < max_elements; j++) {
+            dist_t dist = ip_space.get_dist_func()(query_data, data + j * data_point_size, ip_space.get_dist_func_param());
+            if (j == 0 || dist < best) {
+                best = dist;
+                best_label = j;
+            }
+        }
+        if (label_docid_lookup[result[0].second - label_offset] == label_docid_lookup[best_label]) correct++;
+    }
+    recall = correct / num_queries;
+    std::cout << "inner product closest document recall : " << recall << "\n";
+    assert(recall > 0.95);
+
     delete[] data;
+    delete alg_ip;
     delete alg_brute;
     delete alg_hnsw;
     return 0;
@@ -0,0 +1,95 @@
+// This is a test file for HierarchicalNSW::reorderGraph
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+// Average distance between the internal ids of level 0 neighbors
+double average_edge_span(hnswlib::HierarchicalNSW<float>& alg) {
+    double span = 0;
+    size_t edges = 0;
+    for (hnswlib::tableint i = 0; i < alg.cur_element_count; i++) {
+        hnswlib::linklistsizeint* ll = alg.get_linklist0(i);
+        hnswlib::tableint* data = (hnswlib::tableint*)(ll + 1);
+        for (size_t j = 0; j < alg.getListCount(ll); j++) {
+            span += data[j] > i ? data[j] - i : i - data[j];
+            edges++;
+        }
+    }
+    return span / edges;
+}
+
+void test(hnswlib::GraphReorder strategy) {
+    int d = 16;
+    idx_t n = 5000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg(&space, n + 100);
+    for (idx_t i = 0; i < n; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+    alg.markDelete(3);
+    alg.setEf(50);
+
+    std::vector<std::vector<std::pair<float, idx_t>>> before;
+    for (idx_t j = 0; j < nq; ++j) {
+        before.push_back(alg.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+    double span_before = average_edge_span(alg);
+
+    alg.reorderGraph(strategy);
+    double span_after = average_edge_span(alg);
+    std::cout << "Average edge span: " << span_before << " -> " << span_after << "\n";
+    assert(span_after < span_before);
+    assert(alg.isMarkedDeleted(alg.label_lookup_.find(3)->second));
+
+    // Same graph with new ids: results must not change
+    for (idx_t j = 0; j < nq; ++j) {
+        auto after = alg.searchKnnCloserFirst(query.data() + j * d, k);
+        assert(after == before[j]);
+    }
+    for (idx_t i = 0; i < n; i += 97) {
+        std::vector<float> v = alg.getDataByLabel<float>(i);
+        assert(memcmp(v.data(), data.data() + i * d, d * sizeof(float)) == 0);
+    }
+
+    // The reordered index stays usable for inserts and survives a save/load cycle
+    alg.addPoint(data.data(), n);
+    alg.saveIndexMapped("reorder_test.bin");
+    hnswlib::HierarchicalNSW<float> loaded(&space);
+    loaded.loadIndexMapped("reorder_test.bin", &space);
+    loaded.setEf(50);
+    for (idx_t j = 0; j < nq; ++j) {
+        assert(loaded.searchKnnCloserFirst(query.data() + j * d, k) == alg.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+    remove("reorder_test.bin");
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing BFS reorder ..." << std::endl;
+    test(hnswlib::REORDER_BFS);
+    std::cout << "Testing RCM reorder ..." << std::endl;
+    test(hnswlib::REORDER_RCM);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
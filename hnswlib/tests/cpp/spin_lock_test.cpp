@@ -0,0 +1,110 @@
+// This is a test file for the per-element SpinLock and the single writer insert path
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void test_lock() {
+    assert(sizeof(hnswlib::SpinLock) == 1);
+
+    hnswlib::SpinLock lock;
+    assert(lock.try_lock());
+    assert(!lock.try_lock());
+    lock.unlock();
+
+    size_t counter = 0;
+    int num_threads = 8;
+    int num_iterations = 100000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < num_iterations; i++) {
+                std::unique_lock<hnswlib::SpinLock> guard(lock);
+                counter++;
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    assert(counter == (size_t)num_threads * num_iterations);
+}
+
+float recall(int num_threads) {
+    int d = 16;
+    idx_t n = 10000;
+    idx_t nq = 100;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n);
+    alg_hnsw.setSingleWriter(num_threads == 1);
+    for (idx_t i = 0; i < n; ++i) {
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            for (idx_t i = t; i < n; i += num_threads) {
+                alg_hnsw.addPoint(data.data() + d * i, i);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    alg_hnsw.setEf(50);
+    float correct = 0;
+    for (idx_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw.searchKnn(p, k);
+        std::unordered_set<idx_t> gt_labels;
+        while (!gd.empty()) {
+            gt_labels.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (gt_labels.count(res.top().second))
+                correct += 1;
+            res.pop();
+        }
+    }
+    return correct / (nq * k);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing spin lock ..." << std::endl;
+    test_lock();
+
+    std::cout << "Testing single writer build ..." << std::endl;
+    float recall_single = recall(1);
+    std::cout << "Recall: " << recall_single << "\n";
+    assert(recall_single > 0.95);
+
+    std::cout << "Testing concurrent build ..." << std::endl;
+    float recall_multi = recall(4);
+    std::cout << "Recall: " << recall_multi << "\n";
+    assert(recall_multi > 0.95);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
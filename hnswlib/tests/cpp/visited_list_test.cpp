@@ -0,0 +1,135 @@
+// This is a test file for the thread-local and compact visited lists
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void test_compact_list() {
+    hnswlib::VisitedList vl(100000, true);
+    assert(vl.mass == nullptr);
+    for (int round = 0; round < 3; round++) {
+        vl.reset();
+        for (unsigned int id = 0; id < 5000; id += 1 + round)
+            assert(vl.visit(id));
+        for (unsigned int id = 0; id < 5000; id += 1 + round)
+            assert(!vl.visit(id));
+    }
+    vl.reset();
+    assert(vl.visit(17));
+}
+
+void test_pool_lifetime() {
+    // lists cached by a thread go back to their pool when the thread exits
+    hnswlib::VisitedListPool pool(0, 1000);
+    hnswlib::VisitedList *cached = nullptr;
+    std::thread([&]() {
+        cached = pool.getFreeVisitedList();
+        pool.releaseVisitedList(cached);
+    }).join();
+    hnswlib::VisitedList *vl = pool.getFreeVisitedList();
+    assert(vl == cached);
+    pool.releaseVisitedList(vl);
+
+    // destroyed pools free the lists cached by threads, stale entries are dropped on lookup
+    std::thread([&]() {
+        for (int i = 0; i < 100; i++) {
+            hnswlib::VisitedListPool *dead = new hnswlib::VisitedListPool(1, 1000, i % 2 == 0);
+            hnswlib::VisitedList *list = dead->getFreeVisitedList();
+            assert(list->visit(1));
+            dead->releaseVisitedList(list);
+            delete dead;
+            hnswlib::VisitedList *live = pool.getFreeVisitedList();
+            assert(live->visit(1));
+            pool.releaseVisitedList(live);
+        }
+    }).join();
+}
+
+// Compact lists change only the bookkeeping, the results must be identical
+void test_search(bool compact) {
+    int d = 16;
+    idx_t n = 5000;
+    idx_t nq = 200;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = distrib(rng);
+    for (size_t i = 0; i < query.size(); ++i) query[i] = distrib(rng);
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg(&space, n / 2);
+    hnswlib::HierarchicalNSW<float> alg_other(&space, n);
+    alg.setCompactVisitedLists(compact);
+    alg_other.setCompactVisitedLists(compact);
+    for (idx_t i = 0; i < n / 2; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+    // the pool is replaced on resize, lists cached by threads must not be reused
+    alg.resizeIndex(n);
+    for (idx_t i = n / 2; i < n; ++i) {
+        alg.addPoint(data.data() + d * i, i);
+    }
+    for (idx_t i = 0; i < n; ++i) {
+        alg_other.addPoint(data.data() + d * i, i);
+    }
+    alg.setEf(50);
+    alg_other.setEf(50);
+
+    std::vector<std::vector<std::pair<float, idx_t>>> expected(nq);
+    for (idx_t j = 0; j < nq; ++j) {
+        expected[j] = alg.searchKnnCloserFirst(query.data() + j * d, k);
+    }
+
+    // several threads alternate between two indexes sharing the thread caches
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{0};
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (idx_t j = t; j < nq; j += 4) {
+                if (alg.searchKnnCloserFirst(query.data() + j * d, k) != expected[j])
+                    mismatches++;
+                alg_other.searchKnn(query.data() + j * d, k);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    assert(mismatches == 0);
+
+    hnswlib::HierarchicalNSW<float> alg_array(&space, n);
+    for (idx_t i = 0; i < n; ++i) {
+        alg_array.addPoint(data.data() + d * i, i);
+    }
+    alg_array.setEf(50);
+    alg_array.setCompactVisitedLists(!compact);
+    for (idx_t j = 0; j < nq; ++j) {
+        assert(alg_array.searchKnnCloserFirst(query.data() + j * d, k) == alg_other.searchKnnCloserFirst(query.data() + j * d, k));
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing compact list ..." << std::endl;
+    test_compact_list();
+    std::cout << "Testing pool lifetime ..." << std::endl;
+    test_pool_lifetime();
+    std::cout << "Testing array visited lists ..." << std::endl;
+    test_search(false);
+    std::cout << "Testing compact visited lists ..." << std::endl;
+    test_search(true);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
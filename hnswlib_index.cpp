@@ -4,10 +4,28 @@
 #include <iostream>
 #include <vector>
 #include <fstream> // 包含 <fstream> 以使用 std::ifstream
+#include <cstdio>
+#include <algorithm>
+#include <memory>
 
-HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M, int ef_construction) : max_elements(num_data)  {
+HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M, int ef_construction, IndexFactory::DataType data_type)
+    : max_elements(num_data), dim(data_type == IndexFactory::DataType::BINARY ? dim / 8 : dim), data_type(data_type) {
     hnswlib::SpaceInterface<float>* space;
-    if (metric == IndexFactory::MetricType::L2) {
+    if (data_type == IndexFactory::DataType::BINARY) { // 按位打包存储，汉明距离，metric 不生效
+        space = new hnswlib::HammingSpace(dim);
+    } else if (data_type == IndexFactory::DataType::FLOAT16) { // 半精度存储，内存和带宽减半
+        if (metric == IndexFactory::MetricType::L2) {
+            space = new hnswlib::L2SpaceFp16(dim);
+        } else {
+            space = new hnswlib::InnerProductSpaceFp16(dim);
+        }
+    } else if (data_type == IndexFactory::DataType::BFLOAT16) {
+        if (metric == IndexFactory::MetricType::L2) {
+            space = new hnswlib::L2SpaceBf16(dim);
+        } else {
+            space = new hnswlib::InnerProductSpaceBf16(dim);
+        }
+    } else if (metric == IndexFactory::MetricType::L2) {
         space = new hnswlib::L2Space(dim);
     } else {
         space = new hnswlib::InnerProductSpace(dim);
@@ -17,28 +35,109 @@ HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metri
     index = new hnswlib::HierarchicalNSW<float>(space, num_data, M, ef_construction);
 }
 
+const void* HNSWLibIndex::encodeVector(const float* data, std::vector<uint16_t>& buffer, size_t num) const {
+    if (data_type == IndexFactory::DataType::FLOAT32) {
+        return data;
+    }
+
+    if (data_type == IndexFactory::DataType::BINARY) { // 每个输入值为一个字节
+        buffer.resize((dim * num + 1) / 2);
+        uint8_t* codes = reinterpret_cast<uint8_t*>(buffer.data());
+        IndexFactory::toBinaryCodes(data, dim * num, codes);
+        return codes;
+    }
+
+    // 插入和查询向量都要编码成与索引相同的 16 位格式
+    buffer.resize(dim * num);
+    if (data_type == IndexFactory::DataType::FLOAT16) {
+        hnswlib::convertFloatToFp16(data, buffer.data(), dim * num);
+    } else {
+        hnswlib::convertFloatToBf16(data, buffer.data(), dim * num);
+    }
+    return buffer.data();
+}
+
 void HNSWLibIndex::insert_vectors(const std::vector<float>& data, uint64_t label) {
-    index->addPoint(data.data(), static_cast<hnswlib::labeltype>(label));
+    std::vector<uint16_t> buffer;
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    index->addPoint(encodeVector(data.data(), buffer), static_cast<hnswlib::labeltype>(label));
 }
 
 
-std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int ef_search) {
-    index->setEf(ef_search);
+std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int ef_search, bool filtered_traversal,
+                                                                              size_t patience, size_t max_distance_computations, std::vector<hnswlib::SearchTerminationStats>* stats) {
+    // ef 作为参数传给每次检索，不修改索引的共享状态，并发检索可以使用不同的 ef
+    size_t ef = static_cast<size_t>(std::max(ef_search, 1));
 
     RoaringBitmapIDFilter* selector = nullptr;
     if (bitmap != nullptr) {
         selector = new RoaringBitmapIDFilter(bitmap);
     } 
 
-    auto result = index->searchKnn(query.data(), k, selector);
-
+    std::vector<uint16_t> buffer;
     std::vector<long> indices;
     std::vector<float> distances;
-    while (!result.empty()) { // 检查result是否为空
-        auto item = result.top();
-        indices.push_back(item.second);
-        distances.push_back(item.first);
-        result.pop();
+    size_t num_queries = query.size() / dim;
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    if (filtered_traversal && selector != nullptr) {
+        // 过滤条件很严格时沿不满足条件的邻居多走一跳，并从位图中均匀取若干标签作为额外入口点
+        std::vector<hnswlib::labeltype> entry_labels;
+        uint64_t cardinality = roaring_bitmap_get_cardinality(bitmap);
+        uint64_t step = std::max<uint64_t>(1, cardinality / 16);
+        for (uint64_t rank = 0; rank < cardinality && entry_labels.size() < 16; rank += step) {
+            uint32_t label;
+            if (roaring_bitmap_select(bitmap, static_cast<uint32_t>(rank), &label)) {
+                entry_labels.push_back(label);
+            }
+        }
+
+        const char* encoded = static_cast<const char*>(encodeVector(query.data(), buffer, num_queries));
+        indices.assign(num_queries * k, -1);
+        distances.assign(num_queries * k, 0);
+        for (size_t q = 0; q < num_queries; ++q) {
+            auto result = index->searchKnnFiltered(encoded + q * index->data_size_, k, selector, entry_labels, ef);
+            for (size_t j = 0; !result.empty(); ++j) {
+                indices[q * k + j] = result.top().second;
+                distances[q * k + j] = result.top().first;
+                result.pop();
+            }
+        }
+    } else if (patience > 0 || max_distance_computations > 0 || stats != nullptr) {
+        // 自适应提前终止：top-k 连续 patience 跳不变或距离计算次数用完时停止，并记录每个查询的终止统计
+        const char* encoded = static_cast<const char*>(encodeVector(query.data(), buffer, num_queries));
+        indices.assign(num_queries * k, -1);
+        distances.assign(num_queries * k, 0);
+        for (size_t q = 0; q < num_queries; ++q) {
+            hnswlib::AdaptiveSearchStopCondition<float> stop_condition(k, ef, patience, max_distance_computations);
+            auto result = index->searchStopConditionClosest(encoded + q * index->data_size_, stop_condition, selector);
+            for (size_t j = 0; j < result.size(); ++j) { // 与其他检索方式一致，按距离由远到近排列
+                indices[q * k + j] = result[result.size() - 1 - j].second;
+                distances[q * k + j] = result[result.size() - 1 - j].first;
+            }
+            if (stats != nullptr) {
+                stats->push_back(stop_condition.stats());
+            }
+        }
+    } else if (num_queries > 1) {
+        // 多个查询交错推进，一个查询等待内存时计算其他查询的距离
+        auto results = index->searchKnnBatch(encodeVector(query.data(), buffer, num_queries), num_queries, k, selector, 8, ef);
+        indices.assign(num_queries * k, -1);
+        distances.assign(num_queries * k, 0);
+        for (size_t q = 0; q < num_queries; ++q) {
+            for (size_t j = 0; !results[q].empty(); ++j) {
+                indices[q * k + j] = results[q].top().second;
+                distances[q * k + j] = results[q].top().first;
+                results[q].pop();
+            }
+        }
+    } else {
+        auto result = index->searchKnn(encodeVector(query.data(), buffer), k, selector, ef);
+        while (!result.empty()) { // 检查result是否为空
+            auto item = result.top();
+            indices.push_back(item.second);
+            distances.push_back(item.first);
+            result.pop();
+        }
     }
 
     if (bitmap != nullptr) {
@@ -48,16 +147,164 @@ std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::search_vectors(co
     return {indices, distances};
 }
 
+std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap, size_t max_results, int ef_search) {
+    std::vector<long> indices;
+    std::vector<float> distances;
+    if (max_results == 0) {
+        return {indices, distances};
+    }
+
+    // 结果集中至少有 ef 个候选且下一个候选超出半径时停止，radius 与检索返回的距离含义相同（L2 平方距离或 1 - 内积）
+    // max_results 很小时仍按 ef 个候选检索，避免检索范围过窄找不到半径内的向量
+    size_t ef = static_cast<size_t>(std::max(ef_search, 1));
+    hnswlib::EpsilonSearchStopCondition<float> stop_condition(radius, ef, std::max(ef, max_results));
+    std::unique_ptr<RoaringBitmapIDFilter> selector;
+    if (bitmap != nullptr) {
+        selector.reset(new RoaringBitmapIDFilter(bitmap));
+    }
+
+    std::vector<uint16_t> buffer;
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    auto result = index->searchStopConditionClosest(encodeVector(query.data(), buffer), stop_condition, selector.get());
+    if (result.size() > max_results) {
+        result.resize(max_results);
+    }
+    for (const auto& item : result) {
+        indices.push_back(item.second);
+        distances.push_back(item.first);
+    }
+    return {indices, distances};
+}
+
+std::vector<HNSWLibIndex::CalibrationPoint> HNSWLibIndex::calibrate(const std::vector<int>& ef_values, size_t num_samples, int k) {
+    std::vector<size_t> efs;
+    for (int ef : ef_values) {
+        efs.push_back(static_cast<size_t>(std::max(ef, 1)));
+    }
+    std::sort(efs.begin(), efs.end());
+    efs.erase(std::unique(efs.begin(), efs.end()), efs.end());
+
+    std::vector<CalibrationPoint> curve;
+    {
+        std::shared_lock<std::shared_mutex> lock(rw_mutex);
+        GlobalLogger->info("Calibrating HNSW ef with {} samples, k = {}", num_samples, k);
+        size_t num = static_cast<size_t>(std::max(k, 1));
+        std::vector<float> recalls = index->measureRecall(efs, num_samples, num);
+        for (size_t i = 0; i < efs.size(); ++i) {
+            // 同一批抽样查询不设限制检索，学习自适应提前终止的耐心值
+            size_t patience = index->learnSearchPatience(efs[i], num, num_samples);
+            curve.push_back({static_cast<int>(efs[i]), recalls[i], patience});
+            GlobalLogger->info("ef {}: recall {}, patience {}", efs[i], recalls[i], patience);
+        }
+    }
+    std::lock_guard<std::mutex> lock(curve_mutex);
+    ef_curve = curve;
+    ef_curve_k = k;
+    return curve;
+}
+
+int HNSWLibIndex::efForRecall(float recall_target, int k) {
+    std::lock_guard<std::mutex> lock(curve_mutex);
+    if (ef_curve.empty()) {
+        return -1;
+    }
+    if (k != ef_curve_k) { // 召回率随 k 变化，其他 k 的曲线不能套用
+        GlobalLogger->warn("ef-recall curve was calibrated for k = {}, not k = {}", ef_curve_k, k);
+        return -1;
+    }
+    for (const auto& point : ef_curve) { // 曲线按 ef 升序，取第一个达到目标的 ef
+        if (point.recall >= recall_target) {
+            return point.ef;
+        }
+    }
+    return ef_curve.back().ef; // 没有 ef 达到目标时使用校准过的最大 ef
+}
+
+size_t HNSWLibIndex::patienceForEf(int ef, int k) {
+    std::lock_guard<std::mutex> lock(curve_mutex);
+    if (k != ef_curve_k) {
+        return 0;
+    }
+    for (const auto& point : ef_curve) { // 取不小于 ef 的最小校准点
+        if (point.ef >= ef) {
+            return point.patience;
+        }
+    }
+    return ef_curve.empty() ? 0 : ef_curve.back().patience;
+}
+
 void HNSWLibIndex::saveIndex(const std::string& file_path) { // 添加 saveIndex 方法实现
-    index->saveIndex(file_path);
+    // 使用可直接 mmap 的快照格式，重启时无需整体读入内存
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    index->saveIndexMapped(file_path);
+
+    // ef-召回率曲线保存到 file_path.efcurve，第一行为校准时的 k，之后每行一个 ef、召回率和耐心值
+    // 先写临时文件再重命名，写到一半时崩溃不会留下截断的曲线
+    std::lock_guard<std::mutex> curve_lock(curve_mutex);
+    if (!ef_curve.empty()) {
+        std::string curve_path = file_path + ".efcurve";
+        std::string tmp_path = curve_path + ".tmp";
+        {
+            std::ofstream out(tmp_path);
+            out << ef_curve_k << "\n";
+            for (const auto& point : ef_curve) {
+                out << point.ef << " " << point.recall << " " << point.patience << "\n";
+            }
+            out.flush();
+            if (!out) {
+                throw std::runtime_error("Failed to write " + tmp_path);
+            }
+        }
+        if (std::rename(tmp_path.c_str(), curve_path.c_str()) != 0) {
+            throw std::runtime_error("Failed to rename " + tmp_path + " to " + curve_path);
+        }
+    }
 }
 
 void HNSWLibIndex::loadIndex(const std::string& file_path) { // 添加 loadIndex 方法实现
     std::ifstream file(file_path); // 尝试打开文件
     if (file.good()) { // 检查文件是否存在
         file.close();
-        index->loadIndex(file_path, space, max_elements);
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        if (hnswlib::HierarchicalNSW<float>::isMappedIndexFile(file_path)) {
+            // 大页和 NUMA 策略直接作用于文件映射，不复制基础层，保持快速启动；
+            // 仍与页缓存共享的页保持原有位置，写时复制和新写入的页按策略分配
+            index->loadIndexMapped(file_path, space, max_elements, mmap_warmup);
+        } else { // 兼容旧格式的快照
+            index->loadIndex(file_path, space, max_elements);
+        }
+
+        std::ifstream curve_file(file_path + ".efcurve");
+        std::lock_guard<std::mutex> curve_lock(curve_mutex);
+        if (curve_file >> ef_curve_k) {
+            ef_curve.clear();
+            CalibrationPoint point;
+            while (curve_file >> point.ef >> point.recall >> point.patience) {
+                ef_curve.push_back(point);
+            }
+        }
     } else {
         GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
     }
+}
+
+void HNSWLibIndex::setMmapWarmup(hnswlib::MmapWarmup warmup) {
+    mmap_warmup = warmup;
+}
+
+void HNSWLibIndex::setMemoryPolicy(const hnswlib::MemoryPolicy& policy) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    index->setMemoryPolicy(policy);
+}
+
+void HNSWLibIndex::setCompactVisitedLists(bool compact) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    index->setCompactVisitedLists(compact);
+}
+
+void HNSWLibIndex::reorder(hnswlib::GraphReorder strategy) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    GlobalLogger->info("Reordering HNSW graph with {} elements", index->cur_element_count.load());
+    index->reorderGraph(strategy);
+    GlobalLogger->info("HNSW graph reordered");
 }
\ No newline at end of file
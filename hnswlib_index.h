@@ -4,14 +4,32 @@
 #include "index_factory.h"
 #include "roaring/roaring.h" // 包含 roaring/roaring.h 以使用 Roaring Bitmaps
 #include <vector>
+#include <shared_mutex>
+#include <mutex>
 
 class HNSWLibIndex {
 public:
-    HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M = 16, int ef_construction = 200);
+    // 校准得到的 ef-召回率曲线上的一个点
+    struct CalibrationPoint {
+        int ef;
+        float recall;
+        size_t patience; // 该 ef 下自适应提前终止的耐心值：top-k 连续多少跳不变后停止
+    };
+
+    HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M = 16, int ef_construction = 200, IndexFactory::DataType data_type = IndexFactory::DataType::FLOAT32); // 添加 data_type 参数
     void insert_vectors(const std::vector<float>& data, uint64_t label);
-std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50);
+std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50, bool filtered_traversal = false,
+                                                                    size_t patience = 0, size_t max_distance_computations = 0, std::vector<hnswlib::SearchTerminationStats>* stats = nullptr); // query 包含多个向量时批量检索，每个查询占 k 个位置，不足用 -1 填充；filtered_traversal 对选择性很高的过滤条件使用两跳遍历；patience 和 max_distance_computations 非 0 时提前终止，stats 非空时记录每个查询的终止统计
+    std::pair<std::vector<long>, std::vector<float>> range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap = nullptr, size_t max_results = 1000, int ef_search = 50); // 返回距离不超过 radius 的向量，按距离由近到远，最多 max_results 个
     void saveIndex(const std::string& file_path); // 添加 saveIndex 方法声明
     void loadIndex(const std::string& file_path); // 添加 loadIndex 方法声明
+    void setMmapWarmup(hnswlib::MmapWarmup warmup); // 设置 mmap 加载快照后的预热方式
+    void reorder(hnswlib::GraphReorder strategy = hnswlib::REORDER_BFS); // 按图结构重排内部 ID，提高检索时的缓存命中率
+    void setMemoryPolicy(const hnswlib::MemoryPolicy& policy); // 设置基础层内存的大页和 NUMA 策略
+    void setCompactVisitedLists(bool compact); // 大索引使用哈希集合记录访问过的节点，减少每个检索线程的内存
+    std::vector<CalibrationPoint> calibrate(const std::vector<int>& ef_values, size_t num_samples, int k); // 抽样已存向量作为查询，与精确检索对比，测量每个 ef 的召回率和耐心值并保存为 ef-召回率曲线
+    int efForRecall(float recall_target, int k); // 按 ef-召回率曲线返回 k 个结果达到目标召回率的最小 ef，未以该 k 校准时返回 -1
+    size_t patienceForEf(int ef, int k); // 以该 k 校准得到的耐心值，未以该 k 校准时返回 0
  // 定义 RoaringBitmapIDFilter 类
     class RoaringBitmapIDFilter : public hnswlib::BaseFilterFunctor {
     public:
@@ -26,7 +44,16 @@ std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vecto
     };
 
 private:
+    const void* encodeVector(const float* data, std::vector<uint16_t>& buffer, size_t num = 1) const; // 按 data_type 编码 num 个连续的向量，二值向量按字节写入 buffer
+
     hnswlib::HierarchicalNSW<float>* index;
     hnswlib::SpaceInterface<float>* space; // 添加 space 成员变量
     size_t max_elements; // 添加 max_elements 成员变量
+    size_t dim; // 每个向量的输入值个数，二值向量为打包后的字节数
+    IndexFactory::DataType data_type; // 向量存储精度
+    hnswlib::MmapWarmup mmap_warmup = hnswlib::MMAP_WARMUP_NONE; // 添加 mmap_warmup 成员变量
+    std::shared_mutex rw_mutex; // 重排、加载和保存时独占索引，插入和检索共享
+    std::vector<CalibrationPoint> ef_curve; // 校准得到的曲线，按 ef 升序
+    int ef_curve_k = 0; // 校准时使用的 k
+    std::mutex curve_mutex;
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "http_server.h"
 #include "faiss_index.h"
 #include "hnswlib_index.h"
+#include "disk_graph_index.h"
+#include "vector_store.h"
+#include "sharded_hnsw_index.h"
+#include "multi_vector_index.h"
 #include "index_factory.h"
 #include "logger.h"
 #include "constants.h"
@@ -16,6 +20,10 @@ HttpServer::HttpServer(const std::string& host, int port, VectorDatabase* vector
         searchHandler(req, res);
     });
 
+    server.Post("/rangeSearch", [this](const httplib::Request& req, httplib::Response& res) { // 返回距离阈值内的所有向量
+        rangeSearchHandler(req, res);
+    });
+
     server.Post("/insert", [this](const httplib::Request& req, httplib::Response& res) {
         insertHandler(req, res);
     });
@@ -32,6 +40,18 @@ HttpServer::HttpServer(const std::string& host, int port, VectorDatabase* vector
         snapshotHandler(req, res);
     });
 
+    server.Post("/admin/train", [this](const httplib::Request& req, httplib::Response& res) { // 添加 /admin/train 请求处理程序
+        trainHandler(req, res);
+    });
+
+    server.Post("/admin/reorder", [this](const httplib::Request& req, httplib::Response& res) { // 添加 /admin/reorder 请求处理程序
+        reorderHandler(req, res);
+    });
+
+    server.Post("/admin/calibrate", [this](const httplib::Request& req, httplib::Response& res) { // 校准 HNSW 索引的 ef-召回率曲线
+        calibrateHandler(req, res);
+    });
+
     server.Post("/admin/setLeader", [this](const httplib::Request& req, httplib::Response& res) { // 将 /admin/set_leader 更改为驼峰命名
         setLeaderHandler(req, res);
     });
@@ -57,16 +77,20 @@ void HttpServer::start() {
 
 bool HttpServer::isRequestValid(const rapidjson::Document& json_request, CheckType check_type) {
     switch (check_type) {
-        case CheckType::SEARCH:
-            return json_request.HasMember(REQUEST_VECTORS) &&
-                   json_request.HasMember(REQUEST_K) &&
+        case CheckType::SEARCH: // 多字段检索的查询向量在 fields 中
+            return (json_request.HasMember(REQUEST_VECTORS) || (json_request.HasMember(REQUEST_FIELDS) && json_request[REQUEST_FIELDS].IsObject())) &&
+                   json_request.HasMember(REQUEST_K) && json_request[REQUEST_K].IsInt() &&
+                   (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
+        case CheckType::RANGE_SEARCH:
+            return json_request.HasMember(REQUEST_VECTORS) && json_request[REQUEST_VECTORS].IsArray() &&
+                   json_request.HasMember(REQUEST_RADIUS) && json_request[REQUEST_RADIUS].IsNumber() &&
                    (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
         case CheckType::INSERT:
             return json_request.HasMember(REQUEST_VECTORS) &&
                    json_request.HasMember(REQUEST_ID) &&
                    (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
-        case CheckType::UPSERT: // 添加UPSERT逻辑
-            return json_request.HasMember(REQUEST_VECTORS) &&
+        case CheckType::UPSERT: // 添加UPSERT逻辑，文档可以只有具名向量字段
+            return (json_request.HasMember(REQUEST_VECTORS) || hasVectorField(json_request)) &&
                    json_request.HasMember(REQUEST_ID) &&
                    (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
         default:
@@ -74,6 +98,15 @@ bool HttpServer::isRequestValid(const rapidjson::Document& json_request, CheckTy
     }
 }
 
+bool HttpServer::hasVectorField(const rapidjson::Document& json_request) {
+    for (const auto& field_entry : getGlobalIndexFactory()->getFieldIndexes()) {
+        if (json_request.HasMember(field_entry.first.c_str()) && (json_request[field_entry.first.c_str()].IsArray() || json_request[field_entry.first.c_str()].IsObject())) {
+            return true;
+        }
+    }
+    return false;
+}
+
 IndexFactory::IndexType HttpServer::getIndexTypeFromRequest(const rapidjson::Document& json_request) {
     // 获取请求参数中的索引类型
     if (json_request.HasMember(REQUEST_INDEX_TYPE) && json_request[REQUEST_INDEX_TYPE].IsString()) {
@@ -82,6 +115,14 @@ IndexFactory::IndexType HttpServer::getIndexTypeFromRequest(const rapidjson::Doc
             return IndexFactory::IndexType::FLAT;
         } else if (index_type_str == INDEX_TYPE_HNSW) { // 添加对HNSW的支持
             return IndexFactory::IndexType::HNSW;
+        } else if (index_type_str == INDEX_TYPE_FAISS_FACTORY) {
+            return IndexFactory::IndexType::FAISS_FACTORY;
+        } else if (index_type_str == INDEX_TYPE_DISK_GRAPH) {
+            return IndexFactory::IndexType::DISK_GRAPH;
+        } else if (index_type_str == INDEX_TYPE_SHARDED_HNSW) {
+            return IndexFactory::IndexType::SHARDED_HNSW;
+        } else if (index_type_str == INDEX_TYPE_MULTI_VECTOR) {
+            return IndexFactory::IndexType::MULTI_VECTOR;
         }
     }
     return IndexFactory::IndexType::UNKNOWN; // 返回UNKNOWN值
@@ -114,19 +155,16 @@ void HttpServer::searchHandler(const httplib::Request& req, httplib::Response& r
     }
 
     // 获取查询参数
-    std::vector<float> query;
-    for (const auto& q : json_request[REQUEST_VECTORS].GetArray()) {
-        query.push_back(q.GetFloat());
-    }
     int k = json_request[REQUEST_K].GetInt();
 
     GlobalLogger->debug("Query parameters: k = {}", k);
 
-    // 获取请求参数中的索引类型
+    // 获取请求参数中的索引类型，检索具名向量字段时使用字段自己的索引
     IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+    bool field_search = json_request.HasMember(REQUEST_FIELD) || json_request.HasMember(REQUEST_FIELDS);
 
     // 如果索引类型为UNKNOWN，返回400错误
-    if (indexType == IndexFactory::IndexType::UNKNOWN) {
+    if (indexType == IndexFactory::IndexType::UNKNOWN && !field_search) {
         GlobalLogger->error("Invalid indexType parameter in the request");
         res.status = 400;
         setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid indexType parameter in the request"); 
@@ -134,7 +172,16 @@ void HttpServer::searchHandler(const httplib::Request& req, httplib::Response& r
     }
 
     // 使用 VectorDatabase 的 search 接口执行查询
-    std::pair<std::vector<long>, std::vector<float>> results = vector_database_->search(json_request);
+    std::vector<hnswlib::SearchTerminationStats> stats;
+    std::pair<std::vector<long>, std::vector<float>> results;
+    try {
+        results = vector_database_->search(json_request, &stats);
+    } catch (const std::exception& e) {
+        GlobalLogger->error("Failed to run search: {}", e.what());
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, e.what());
+        return;
+    }
 
     // 将结果转换为JSON
     rapidjson::Document json_response;
@@ -158,11 +205,90 @@ void HttpServer::searchHandler(const httplib::Request& req, httplib::Response& r
         json_response.AddMember(RESPONSE_DISTANCES, distances, allocator);
     }
 
+    // 启用提前终止时返回每个查询的跳数、距离计算次数和终止原因
+    if (!stats.empty()) {
+        static const char* termination_names[] = {"converged", "patience", "budget"};
+        rapidjson::Value stats_array(rapidjson::kArrayType);
+        for (const auto& stat : stats) {
+            rapidjson::Value stat_object(rapidjson::kObjectType);
+            stat_object.AddMember(RESPONSE_HOPS, static_cast<uint64_t>(stat.hops), allocator);
+            stat_object.AddMember(RESPONSE_DISTANCE_COMPUTATIONS, static_cast<uint64_t>(stat.distance_computations), allocator);
+            stat_object.AddMember(RESPONSE_TERMINATION, rapidjson::StringRef(termination_names[stat.reason]), allocator);
+            stats_array.PushBack(stat_object, allocator);
+        }
+        json_response.AddMember(RESPONSE_STATS, stats_array, allocator);
+    }
+
     // 设置响应
     json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator); 
     setJsonResponse(json_response, res);
 }
 
+void HttpServer::rangeSearchHandler(const httplib::Request& req, httplib::Response& res) {
+    GlobalLogger->debug("Received range search request");
+
+    // 解析JSON请求
+    rapidjson::Document json_request;
+    json_request.Parse(req.body.c_str());
+
+    // 打印用户的输入参数
+    GlobalLogger->info("Range search request parameters: {}", req.body);
+
+    // 检查JSON文档是否为有效对象
+    if (!json_request.IsObject()) {
+        GlobalLogger->error("Invalid JSON request");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid JSON request");
+        return;
+    }
+
+    // 检查请求的合法性
+    if (!isRequestValid(json_request, CheckType::RANGE_SEARCH)) {
+        GlobalLogger->error("Missing vectors or radius parameter in the request");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Missing vectors or radius parameter in the request");
+        return;
+    }
+
+    // 获取请求参数中的索引类型
+    IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+    if (indexType == IndexFactory::IndexType::UNKNOWN) {
+        GlobalLogger->error("Invalid indexType parameter in the request");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid indexType parameter in the request");
+        return;
+    }
+
+    // 使用 VectorDatabase 的 rangeSearch 接口执行查询
+    std::pair<std::vector<long>, std::vector<float>> results;
+    try {
+        results = vector_database_->rangeSearch(json_request);
+    } catch (const std::exception& e) {
+        GlobalLogger->error("Failed to run range search: {}", e.what());
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, e.what());
+        return;
+    }
+
+    // 将结果转换为JSON，没有结果时返回空数组
+    rapidjson::Document json_response;
+    json_response.SetObject();
+    rapidjson::Document::AllocatorType& allocator = json_response.GetAllocator();
+
+    rapidjson::Value vectors(rapidjson::kArrayType);
+    rapidjson::Value distances(rapidjson::kArrayType);
+    for (size_t i = 0; i < results.first.size(); ++i) {
+        vectors.PushBack(static_cast<int64_t>(results.first[i]), allocator);
+        distances.PushBack(results.second[i], allocator);
+    }
+    json_response.AddMember(RESPONSE_VECTORS, vectors, allocator);
+    json_response.AddMember(RESPONSE_DISTANCES, distances, allocator);
+
+    // 设置响应
+    json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(json_response, res);
+}
+
 void HttpServer::insertHandler(const httplib::Request& req, httplib::Response& res) {
     GlobalLogger->debug("Received insert request");
 
@@ -214,7 +340,8 @@ void HttpServer::insertHandler(const httplib::Request& req, httplib::Response& r
 
     // 根据索引类型初始化索引对象并调用insert_vectors函数
     switch (indexType) {
-        case IndexFactory::IndexType::FLAT: {
+        case IndexFactory::IndexType::FLAT:
+        case IndexFactory::IndexType::FAISS_FACTORY: {
             FaissIndex* faissIndex = static_cast<FaissIndex*>(index);
             faissIndex->insert_vectors(data, label);
             break;
@@ -224,12 +351,33 @@ void HttpServer::insertHandler(const httplib::Request& req, httplib::Response& r
             hnswIndex->insert_vectors(data, label);
             break;
         }
+        case IndexFactory::IndexType::DISK_GRAPH: {
+            DiskGraphIndex* diskIndex = static_cast<DiskGraphIndex*>(index);
+            diskIndex->insert_vectors(data, label);
+            break;
+        }
+        case IndexFactory::IndexType::SHARDED_HNSW: {
+            ShardedHNSWIndex* shardedIndex = static_cast<ShardedHNSWIndex*>(index);
+            shardedIndex->insert_vectors(data, label);
+            break;
+        }
+        case IndexFactory::IndexType::MULTI_VECTOR: {
+            MultiVectorIndex* multiVectorIndex = static_cast<MultiVectorIndex*>(index);
+            multiVectorIndex->insert_vectors(data, label);
+            break;
+        }
 
         // 在此处添加其他索引类型的处理逻辑
         default:
             break;
     }
 
+    // 保存原始向量用于精确重排
+    VectorStore* vectorStore = static_cast<VectorStore*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::VECTOR_STORE));
+    if (vectorStore != nullptr && indexType != IndexFactory::IndexType::MULTI_VECTOR) {
+        vectorStore->insert_vectors(data, label);
+    }
+
     // 设置响应
     rapidjson::Document json_response;
     json_response.SetObject();
@@ -268,6 +416,16 @@ void HttpServer::upsertHandler(const httplib::Request& req, httplib::Response& r
 
     // 获取请求参数中的索引类型
     IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+
+    // 应用日志时无法报告错误，索引不支持的更新在追加日志前拒绝
+    try {
+        vector_database_->checkUpsert(label, indexType);
+    } catch (const std::invalid_argument& e) {
+        GlobalLogger->error("Rejected upsert: {}", e.what());
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, e.what());
+        return;
+    }
     
     // 调用 RaftStuff 的 appendEntries 方法将新的日志条目添加到集群中
     raft_stuff_->appendEntries(req.body);
@@ -339,6 +497,144 @@ void HttpServer::snapshotHandler(const httplib::Request& req, httplib::Response&
     setJsonResponse(json_response, res);
 }
 
+void HttpServer::trainHandler(const httplib::Request& req, httplib::Response& res) {
+    GlobalLogger->debug("Received train request");
+
+    // 请求中可指定 indexType，默认训练 FAISS_FACTORY 索引；DISK_GRAPH 索引的训练即重建磁盘图
+    rapidjson::Document json_request;
+    json_request.Parse(req.body.c_str());
+    IndexFactory::IndexType indexType = IndexFactory::IndexType::FAISS_FACTORY;
+    if (json_request.IsObject() && json_request.HasMember(REQUEST_INDEX_TYPE)) {
+        indexType = getIndexTypeFromRequest(json_request);
+    }
+
+    void* index = getGlobalIndexFactory()->getIndex(indexType);
+    if (index == nullptr || (indexType != IndexFactory::IndexType::FAISS_FACTORY && indexType != IndexFactory::IndexType::DISK_GRAPH)) {
+        GlobalLogger->error("Index type is not configured or does not need training");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Index type is not configured or does not need training");
+        return;
+    }
+
+    // 使用缓存的向量训练索引
+    try {
+        if (indexType == IndexFactory::IndexType::FAISS_FACTORY) {
+            static_cast<FaissIndex*>(index)->train();
+        } else {
+            static_cast<DiskGraphIndex*>(index)->build();
+        }
+    } catch (const std::exception& e) {
+        GlobalLogger->error("Failed to train index: {}", e.what());
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, e.what());
+        return;
+    }
+
+    rapidjson::Document json_response;
+    json_response.SetObject();
+    rapidjson::Document::AllocatorType& allocator = json_response.GetAllocator();
+
+    // 设置响应
+    json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(json_response, res);
+}
+
+void HttpServer::reorderHandler(const httplib::Request& req, httplib::Response& res) {
+    GlobalLogger->debug("Received reorder request");
+
+    // 解析JSON请求，strategy 参数可选，默认 BFS
+    rapidjson::Document json_request;
+    json_request.Parse(req.body.c_str());
+    hnswlib::GraphReorder strategy = hnswlib::REORDER_BFS;
+    if (json_request.IsObject() && json_request.HasMember(REQUEST_REORDER_STRATEGY) && json_request[REQUEST_REORDER_STRATEGY].IsString()) {
+        std::string strategy_str = json_request[REQUEST_REORDER_STRATEGY].GetString();
+        if (strategy_str == "RCM") {
+            strategy = hnswlib::REORDER_RCM;
+        } else if (strategy_str != "BFS") {
+            GlobalLogger->error("Invalid reorder strategy: {}", strategy_str);
+            res.status = 400;
+            setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid reorder strategy");
+            return;
+        }
+    }
+
+    // 重排期间 HNSW 索引的插入和检索会被阻塞
+    HNSWLibIndex* hnswIndex = static_cast<HNSWLibIndex*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::HNSW));
+    hnswIndex->reorder(strategy);
+
+    rapidjson::Document json_response;
+    json_response.SetObject();
+    rapidjson::Document::AllocatorType& allocator = json_response.GetAllocator();
+
+    // 设置响应
+    json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(json_response, res);
+}
+
+void HttpServer::calibrateHandler(const httplib::Request& req, httplib::Response& res) {
+    GlobalLogger->debug("Received calibrate request");
+
+    // 解析JSON请求，k、samples 和 efValues 参数可选
+    rapidjson::Document json_request;
+    json_request.Parse(req.body.c_str());
+    if (!json_request.IsObject()) {
+        GlobalLogger->error("Invalid JSON request");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid JSON request");
+        return;
+    }
+    int k = 10;
+    if (json_request.HasMember(REQUEST_K) && json_request[REQUEST_K].IsInt()) {
+        k = json_request[REQUEST_K].GetInt();
+    }
+    size_t num_samples = 100;
+    if (json_request.HasMember(REQUEST_SAMPLES) && json_request[REQUEST_SAMPLES].IsUint()) {
+        num_samples = json_request[REQUEST_SAMPLES].GetUint();
+    }
+    std::vector<int> ef_values = {10, 20, 40, 80, 160, 320};
+    if (json_request.HasMember(REQUEST_EF_VALUES) && json_request[REQUEST_EF_VALUES].IsArray()) {
+        ef_values.clear();
+        for (const auto& ef : json_request[REQUEST_EF_VALUES].GetArray()) {
+            if (ef.IsInt()) {
+                ef_values.push_back(ef.GetInt());
+            }
+        }
+    }
+
+    // 逐个抽样向量与精确检索对比，耗时与索引大小成正比，应在离线时调用
+    IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+    void* index = getGlobalIndexFactory()->getIndex(indexType);
+    std::vector<HNSWLibIndex::CalibrationPoint> curve;
+    if (indexType == IndexFactory::IndexType::HNSW && index != nullptr) {
+        curve = static_cast<HNSWLibIndex*>(index)->calibrate(ef_values, num_samples, k);
+    } else if (indexType == IndexFactory::IndexType::SHARDED_HNSW && index != nullptr) {
+        curve = static_cast<ShardedHNSWIndex*>(index)->calibrate(ef_values, num_samples, k);
+    } else {
+        GlobalLogger->error("Calibration is only supported for HNSW indexes");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Calibration is only supported for HNSW indexes");
+        return;
+    }
+
+    rapidjson::Document json_response;
+    json_response.SetObject();
+    rapidjson::Document::AllocatorType& allocator = json_response.GetAllocator();
+
+    rapidjson::Value curve_array(rapidjson::kArrayType);
+    for (const auto& point : curve) {
+        rapidjson::Value point_object(rapidjson::kObjectType);
+        point_object.AddMember(RESPONSE_EF, point.ef, allocator);
+        point_object.AddMember(RESPONSE_RECALL, point.recall, allocator);
+        point_object.AddMember(RESPONSE_PATIENCE, static_cast<uint64_t>(point.patience), allocator);
+        curve_array.PushBack(point_object, allocator);
+    }
+
+    // 设置响应
+    json_response.AddMember(RESPONSE_CURVE, curve_array, allocator);
+    json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(json_response, res);
+}
+
 void HttpServer::setLeaderHandler(const httplib::Request& req, httplib::Response& res) {
     GlobalLogger->debug("Received setLeader request");
 
@@ -439,6 +735,7 @@ void HttpServer::getNodeHandler(const httplib::Request& req, httplib::Response&
     node_object.AddMember("state", rapidjson::Value(std::get<2>(node_info).c_str(), allocator), allocator); // 添加节点状态
     node_object.AddMember("last_log_idx", std::get<3>(node_info), allocator); // 添加节点最后日志索引
     node_object.AddMember("last_succ_resp_us", std::get<4>(node_info), allocator); // 添加节点最后成功响应时间
+    node_object.AddMember("simd", rapidjson::StringRef(hnswlib::simdLevelName(hnswlib::getSimdLevel())), allocator); // 本节点距离计算使用的指令集
     
     json_response.AddMember("node", node_object, allocator);
 
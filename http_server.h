@@ -12,6 +12,7 @@ class HttpServer {
 public:
     enum class CheckType {
         SEARCH,
+        RANGE_SEARCH,
         INSERT,
         UPSERT
     };
@@ -22,10 +23,14 @@ public:
 
 private:
     void searchHandler(const httplib::Request& req, httplib::Response& res);
+    void rangeSearchHandler(const httplib::Request& req, httplib::Response& res); // 范围检索，返回距离阈值内的所有向量
     void insertHandler(const httplib::Request& req, httplib::Response& res);
     void upsertHandler(const httplib::Request& req, httplib::Response& res);
     void queryHandler(const httplib::Request& req, httplib::Response& res); // 添加queryHandler函数声明
     void snapshotHandler(const httplib::Request& req, httplib::Response& res);
+    void trainHandler(const httplib::Request& req, httplib::Response& res); // 添加 trainHandler 函数声明
+    void reorderHandler(const httplib::Request& req, httplib::Response& res); // 添加 reorderHandler 函数声明
+    void calibrateHandler(const httplib::Request& req, httplib::Response& res); // 测量 ef-召回率曲线，供按目标召回率检索使用
     void setLeaderHandler(const httplib::Request& req, httplib::Response& res); // 添加 setLeaderHandler 函数声明
     void addFollowerHandler(const httplib::Request& req, httplib::Response& res); // 添加 addFollowerHandler 方法声明
     void listNodeHandler(const httplib::Request& req, httplib::Response& res); // 添加 listNodeHandler 函数声明
@@ -34,6 +39,7 @@ private:
     void setErrorJsonResponse(httplib::Response& res, int error_code, const std::string& errorMsg); 
     bool isRequestValid(const rapidjson::Document& json_request, CheckType check_type);
     IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Document& json_request); 
+    bool hasVectorField(const rapidjson::Document& json_request); // 请求中是否有已配置的具名向量字段
 
     httplib::Server server;
     std::string host;
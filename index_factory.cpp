@@ -1,9 +1,21 @@
 #include "index_factory.h"
 #include "hnswlib_index.h"
 #include "filter_index.h" // 包含 filter_index.h 以使用 FilterIndex 类
+#include "disk_graph_index.h"
+#include "vector_store.h"
+#include "sharded_hnsw_index.h"
+#include "multi_vector_index.h"
+#include "sparse_index.h"
 
 #include <faiss/IndexFlat.h>
 #include <faiss/IndexIDMap.h>
+#include <faiss/IndexBinaryFlat.h>
+#include <faiss/IndexScalarQuantizer.h> // 半精度 FLAT 索引使用 IndexScalarQuantizer
+#include <faiss/index_factory.h> // 包含 index_factory.h 以通过工厂字符串创建索引
+#include <faiss/IVFlib.h>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
 #include <experimental/filesystem> // 包含 <experimental/filesystem> 以使用 std::experimental::filesystem
 
 namespace {
@@ -14,21 +26,96 @@ IndexFactory* getGlobalIndexFactory() {
     return &globalIndexFactory; 
 }
 
-void IndexFactory::init(IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric) {
+void* IndexFactory::createIndex(IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric, IndexFactory::DataType data_type, const std::string& index_param) {
     faiss::MetricType faiss_metric = (metric == IndexFactory::MetricType::L2) ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
+    if (data_type == IndexFactory::DataType::BINARY && dim % 8 != 0) {
+        throw std::invalid_argument("Binary vector dimension must be a multiple of 8 bits");
+    }
 
     switch (type) {
-        case IndexFactory::IndexType::FLAT:
-            index_map[type] = new FaissIndex(new faiss::IndexIDMap(new faiss::IndexFlat(dim, faiss_metric)));
-            break;
+        case IndexFactory::IndexType::FLAT: {
+            if (data_type == IndexFactory::DataType::BINARY) { // 二值向量使用汉明距离，metric 不生效
+                return new FaissIndex(new faiss::IndexBinaryIDMap(new faiss::IndexBinaryFlat(dim)));
+            }
+            faiss::Index* flat_index = nullptr;
+            if (data_type == IndexFactory::DataType::FLOAT16) {
+                flat_index = new faiss::IndexScalarQuantizer(dim, faiss::ScalarQuantizer::QT_fp16, faiss_metric);
+            } else if (data_type == IndexFactory::DataType::BFLOAT16) {
+                flat_index = new faiss::IndexScalarQuantizer(dim, faiss::ScalarQuantizer::QT_bf16, faiss_metric);
+            } else {
+                flat_index = new faiss::IndexFlat(dim, faiss_metric);
+            }
+            return new FaissIndex(new faiss::IndexIDMap(flat_index));
+        }
         case IndexFactory::IndexType::HNSW:
-            index_map[type] = new HNSWLibIndex(dim, num_data, metric, 16, 200);
-            break;
+            return new HNSWLibIndex(dim, num_data, metric, 16, 200, data_type);
         case IndexFactory::IndexType::FILTER: // 初始化 FilterIndex 对象
-            index_map[type] = new FilterIndex();
-            break;
+            return new FilterIndex();
+        case IndexFactory::IndexType::FAISS_FACTORY: { // 例如 "IVF4096,PQ64" 或 "OPQ32,IVF65536_HNSW32,PQ32"
+            if (data_type == IndexFactory::DataType::BINARY) { // 二值索引的工厂字符串，例如 "BFlat" 或 "BHNSW32"
+                faiss::IndexBinary* binary_index = faiss::index_binary_factory(dim, index_param.c_str());
+                if (!binary_index->is_trained) { // 二值索引没有训练缓存和训练入口，"BIVF1024" 等需要训练的索引永远无法写入
+                    delete binary_index;
+                    throw std::invalid_argument("Binary faiss index \"" + index_param + "\" requires training, which is not supported for binary vectors");
+                }
+                if (dynamic_cast<faiss::IndexBinaryIDMap*>(binary_index) == nullptr) {
+                    binary_index = new faiss::IndexBinaryIDMap(binary_index);
+                }
+                return new FaissIndex(binary_index);
+            }
+            faiss::Index* factory_index = faiss::index_factory(dim, index_param.c_str(), faiss_metric);
+            // IVF 类索引自带 ID 管理，其余索引包装为 IndexIDMap 以支持 add_with_ids
+            if (faiss::ivflib::try_extract_index_ivf(factory_index) == nullptr && dynamic_cast<faiss::IndexIDMap*>(factory_index) == nullptr) {
+                factory_index = new faiss::IndexIDMap(factory_index);
+            }
+            return new FaissIndex(factory_index);
+        }
+        case IndexFactory::IndexType::DISK_GRAPH: // index_param 为磁盘文件路径
+            if (data_type == IndexFactory::DataType::BINARY) {
+                throw std::invalid_argument("Disk graph index does not support binary vectors");
+            }
+            return new DiskGraphIndex(dim, metric, index_param);
+        case IndexFactory::IndexType::VECTOR_STORE:
+            return new VectorStore(dim, metric);
+        case IndexFactory::IndexType::SHARDED_HNSW: { // index_param 为分片数，默认每个核一个分片
+            int num_shards = index_param.empty() ? static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) : std::stoi(index_param);
+            return new ShardedHNSWIndex(dim, num_data, metric, num_shards, data_type);
+        }
+        case IndexFactory::IndexType::MULTI_VECTOR: // num_data 为所有文档的向量总数上限
+            return new MultiVectorIndex(dim, num_data, metric);
+        case IndexFactory::IndexType::SPARSE: // 稀疏向量没有固定维度，使用内积
+            return new SparseIndex();
         default:
-            break;
+            return nullptr;
+    }
+}
+
+void IndexFactory::init(IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric, IndexFactory::DataType data_type, const std::string& index_param) {
+    void* index = createIndex(type, dim, num_data, metric, data_type, index_param);
+    if (index != nullptr) {
+        index_map[type] = index;
+        index_info_map[type] = {type, index, data_type == DataType::BINARY ? dim / 8 : dim, metric};
+    }
+}
+
+void IndexFactory::initField(const std::string& field, IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric, IndexFactory::DataType data_type) {
+    if (type != IndexType::FLAT && type != IndexType::HNSW && type != IndexType::MULTI_VECTOR && type != IndexType::SPARSE) {
+        throw std::invalid_argument("Unsupported index type for vector field " + field);
+    }
+    // 二值向量只对 FLAT 和 HNSW 字段生效，MULTI_VECTOR 和 SPARSE 字段仍使用 float 输入
+    if (data_type == DataType::BINARY && type != IndexType::FLAT && type != IndexType::HNSW) {
+        data_type = DataType::FLOAT32;
+    }
+    int input_dim = data_type == DataType::BINARY ? dim / 8 : dim;
+    field_index_map[field] = {type, createIndex(type, dim, num_data, metric, data_type, ""), input_dim, metric};
+}
+
+void IndexFactory::toBinaryCodes(const float* data, size_t size, uint8_t* codes) {
+    for (size_t i = 0; i < size; ++i) {
+        if (!(data[i] >= 0 && data[i] <= 255)) { // NaN 也不在范围内
+            throw std::invalid_argument("Binary vector byte value out of range");
+        }
+        codes[i] = static_cast<uint8_t>(data[i]);
     }
 }
 
@@ -40,41 +127,92 @@ void* IndexFactory::getIndex(IndexType type) const {
     return nullptr;
 }
 
+const IndexFactory::FieldIndex* IndexFactory::getIndexInfo(IndexType type) const {
+    auto it = index_info_map.find(type);
+    if (it != index_info_map.end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+const IndexFactory::FieldIndex* IndexFactory::getFieldIndex(const std::string& field) const {
+    auto it = field_index_map.find(field);
+    if (it != field_index_map.end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+const std::map<std::string, IndexFactory::FieldIndex>& IndexFactory::getFieldIndexes() const {
+    return field_index_map;
+}
+
+void IndexFactory::saveIndex(IndexFactory::IndexType index_type, void* index, const std::string& file_path, ScalarStorage& scalar_storage) {
+    // 根据索引类型调用相应的 saveIndex 函数
+    if (index_type == IndexType::FLAT || index_type == IndexType::FAISS_FACTORY) {
+        static_cast<FaissIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::HNSW) {
+        static_cast<HNSWLibIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::DISK_GRAPH) { // 只保存磁盘文件引用和内存增量
+        static_cast<DiskGraphIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::VECTOR_STORE) {
+        static_cast<VectorStore*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::SHARDED_HNSW) {
+        static_cast<ShardedHNSWIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::MULTI_VECTOR) {
+        static_cast<MultiVectorIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::SPARSE) {
+        static_cast<SparseIndex*>(index)->saveIndex(file_path);
+    } else if (index_type == IndexType::FILTER) { // 保存 FilterIndex 类型的索引
+        static_cast<FilterIndex*>(index)->saveIndex(scalar_storage, file_path);
+    }
+}
+
+void IndexFactory::loadIndex(IndexFactory::IndexType index_type, void* index, const std::string& file_path, ScalarStorage& scalar_storage) {
+    // 根据索引类型调用相应的 loadIndex 函数
+    if (index_type == IndexType::FLAT || index_type == IndexType::FAISS_FACTORY) {
+        static_cast<FaissIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::HNSW) {
+        static_cast<HNSWLibIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::DISK_GRAPH) { // 只保存磁盘文件引用和内存增量
+        static_cast<DiskGraphIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::VECTOR_STORE) {
+        static_cast<VectorStore*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::SHARDED_HNSW) {
+        static_cast<ShardedHNSWIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::MULTI_VECTOR) {
+        static_cast<MultiVectorIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::SPARSE) {
+        static_cast<SparseIndex*>(index)->loadIndex(file_path);
+    } else if (index_type == IndexType::FILTER) { // 加载 FilterIndex 类型的索引
+        static_cast<FilterIndex*>(index)->loadIndex(scalar_storage, file_path);
+    }
+}
+
 void IndexFactory::saveIndex(const std::string& folder_path, ScalarStorage& scalar_storage) { // 添加 ScalarStorage 参数
 
     for (const auto& index_entry : index_map) {
-        IndexType index_type = index_entry.first;
-        void* index = index_entry.second;
-
         // 为每个索引类型生成一个文件名
-        std::string file_path = folder_path + std::to_string(static_cast<int>(index_type)) + ".index";
-
-        // 根据索引类型调用相应的 saveIndex 函数
-        if (index_type == IndexType::FLAT) {
-            static_cast<FaissIndex*>(index)->saveIndex(file_path);
-        } else if (index_type == IndexType::HNSW) {
-            static_cast<HNSWLibIndex*>(index)->saveIndex(file_path);
-        } else if (index_type == IndexType::FILTER) { // 保存 FilterIndex 类型的索引
-            static_cast<FilterIndex*>(index)->saveIndex(scalar_storage, file_path);
-        }
+        std::string file_path = folder_path + std::to_string(static_cast<int>(index_entry.first)) + ".index";
+        saveIndex(index_entry.first, index_entry.second, file_path, scalar_storage);
+    }
+
+    // 具名向量字段的索引按字段名保存
+    for (const auto& field_entry : field_index_map) {
+        std::string file_path = folder_path + "field_" + field_entry.first + ".index";
+        saveIndex(field_entry.second.type, field_entry.second.index, file_path, scalar_storage);
     }
 }
 
 void IndexFactory::loadIndex(const std::string& folder_path, ScalarStorage& scalar_storage) { // 添加 loadIndex 方法实现
     for (const auto& index_entry : index_map) {
-        IndexType index_type = index_entry.first;
-        void* index = index_entry.second;
-
         // 为每个索引类型生成一个文件名
-        std::string file_path = folder_path + std::to_string(static_cast<int>(index_type)) + ".index";
-
-        // 根据索引类型调用相应的 loadIndex 函数
-        if (index_type == IndexType::FLAT) {
-            static_cast<FaissIndex*>(index)->loadIndex(file_path);
-        } else if (index_type == IndexType::HNSW) {
-            static_cast<HNSWLibIndex*>(index)->loadIndex(file_path);
-        } else if (index_type == IndexType::FILTER) { // 加载 FilterIndex 类型的索引
-            static_cast<FilterIndex*>(index)->loadIndex(scalar_storage, file_path);
-        }
+        std::string file_path = folder_path + std::to_string(static_cast<int>(index_entry.first)) + ".index";
+        loadIndex(index_entry.first, index_entry.second, file_path, scalar_storage);
     }
-}
\ No newline at end of file
+
+    for (const auto& field_entry : field_index_map) {
+        std::string file_path = folder_path + "field_" + field_entry.first + ".index";
+        loadIndex(field_entry.second.type, field_entry.second.index, file_path, scalar_storage);
+    }
+}
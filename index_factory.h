@@ -10,6 +10,12 @@ public:
         FLAT,
         HNSW,
         FILTER, // 添加 FILTER 枚举值
+        FAISS_FACTORY, // 通过 faiss 工厂字符串创建的索引，需要训练
+        DISK_GRAPH, // 存放在 SSD 上的图索引
+        VECTOR_STORE, // 原始向量存储，用于压缩索引的精确重排
+        SHARDED_HNSW, // 节点内分片的 HNSW 索引，单个查询并行检索各分片
+        MULTI_VECTOR, // 多向量文档索引，检索返回 top-k 个不同文档
+        SPARSE, // 稀疏向量倒排索引，Block-Max WAND 检索 top-k 内积
         UNKNOWN = -1 
     };
 
@@ -18,13 +24,39 @@ public:
         IP
     };
 
-    void init(IndexFactory::IndexType type, int dim = 1, int num_data = 0, IndexFactory::MetricType metric = IndexFactory::MetricType::L2);
+    enum class DataType { // 向量在索引中的存储精度
+        FLOAT32,
+        FLOAT16,
+        BFLOAT16,
+        BINARY // 按位打包的二值向量，dim 为位数，每个向量输入 dim / 8 个字节值，使用汉明距离
+    };
+
+    // 文档中的具名向量字段，每个字段有自己的维度、距离类型和索引
+    struct FieldIndex {
+        IndexType type;
+        void* index;
+        int dim; // 每个向量的输入值个数，二值向量为字节数
+        MetricType metric;
+    };
+
+    void init(IndexFactory::IndexType type, int dim = 1, int num_data = 0, IndexFactory::MetricType metric = IndexFactory::MetricType::L2, IndexFactory::DataType data_type = IndexFactory::DataType::FLOAT32, const std::string& index_param = ""); // 添加 data_type 参数，index_param 为 FAISS_FACTORY 的工厂字符串、DISK_GRAPH 的磁盘文件路径或 SHARDED_HNSW 的分片数
+    void initField(const std::string& field, IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric = IndexFactory::MetricType::L2, IndexFactory::DataType data_type = IndexFactory::DataType::FLOAT32); // 为具名向量字段创建索引，支持 FLAT、HNSW、MULTI_VECTOR 和 SPARSE
+    static void toBinaryCodes(const float* data, size_t size, uint8_t* codes); // 二值向量的 size 个字节值写入 codes，值不在 [0, 255] 内时抛出 std::invalid_argument
     void* getIndex(IndexType type) const;
+    const FieldIndex* getIndexInfo(IndexType type) const; // 全局索引及其维度和距离类型，未初始化时返回 nullptr
+    const FieldIndex* getFieldIndex(const std::string& field) const; // 字段未配置时返回 nullptr
+    const std::map<std::string, FieldIndex>& getFieldIndexes() const;
     void saveIndex(const std::string& folder_path, ScalarStorage& scalar_storage); // 添加 ScalarStorage 参数
     void loadIndex(const std::string& folder_path, ScalarStorage& scalar_storage); // 添加 loadIndex 方法声明
 
 private:
+    static void* createIndex(IndexFactory::IndexType type, int dim, int num_data, IndexFactory::MetricType metric, IndexFactory::DataType data_type, const std::string& index_param);
+    static void saveIndex(IndexFactory::IndexType type, void* index, const std::string& file_path, ScalarStorage& scalar_storage);
+    static void loadIndex(IndexFactory::IndexType type, void* index, const std::string& file_path, ScalarStorage& scalar_storage);
+
     std::map<IndexType, void*> index_map; 
+    std::map<IndexType, FieldIndex> index_info_map; // 全局索引的维度和距离类型，供混合检索使用
+    std::map<std::string, FieldIndex> field_index_map; // 字段名到字段索引
 };
 
 IndexFactory* getGlobalIndexFactory();
\ No newline at end of file
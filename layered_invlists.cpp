@@ -0,0 +1,353 @@
+#include "layered_invlists.h"
+#include "logger.h"
+#include <faiss/invlists/InvertedListsIOHook.h>
+#include <faiss/impl/io.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <typeinfo>
+
+namespace {
+    // 分层倒排表在索引文件中的标记
+    const char* LAYERED_INVLISTS_KEY = "ilyr";
+
+    template <typename T>
+    void writePOD(faiss::IOWriter* f, const T* ptr, size_t n) {
+        if (n > 0 && (*f)(ptr, sizeof(T), n) != n) {
+            throw std::runtime_error("Failed to write layered inverted lists");
+        }
+    }
+
+    template <typename T>
+    void readPOD(faiss::IOReader* f, T* ptr, size_t n) {
+        if (n > 0 && (*f)(ptr, sizeof(T), n) != n) {
+            throw std::runtime_error("Failed to read layered inverted lists");
+        }
+    }
+}
+
+LayeredInvertedLists::LayeredInvertedLists(size_t nlist, size_t code_size, const std::string& path_prefix)
+    : faiss::InvertedLists(nlist, code_size), owner_(nlist, 0), path_prefix_(path_prefix) {
+    pushLayer();
+}
+
+LayeredInvertedLists::LayeredInvertedLists(size_t nlist, size_t code_size)
+    : faiss::InvertedLists(nlist, code_size), owner_(nlist, 0), frozen_(true) {}
+
+LayeredInvertedLists::~LayeredInvertedLists() {
+    // 只被运行时引用的层文件在重启后不会再被使用
+    for (faiss::OnDiskInvertedLists* layer : layers_) {
+        if (!snapshot_files_.count(layer->filename)) {
+            std::remove(layer->filename.c_str());
+        }
+        delete layer;
+    }
+}
+
+size_t LayeredInvertedLists::list_size(size_t list_no) const {
+    return layers_[owner_[list_no]]->list_size(list_no);
+}
+
+const uint8_t* LayeredInvertedLists::get_codes(size_t list_no) const {
+    return layers_[owner_[list_no]]->get_codes(list_no);
+}
+
+const faiss::idx_t* LayeredInvertedLists::get_ids(size_t list_no) const {
+    return layers_[owner_[list_no]]->get_ids(list_no);
+}
+
+void LayeredInvertedLists::release_codes(size_t list_no, const uint8_t* codes) const {
+    layers_[owner_[list_no]]->release_codes(list_no, codes);
+}
+
+void LayeredInvertedLists::release_ids(size_t list_no, const faiss::idx_t* ids) const {
+    layers_[owner_[list_no]]->release_ids(list_no, ids);
+}
+
+void LayeredInvertedLists::prefetch_lists(const faiss::idx_t* list_nos, int n) const {
+    std::vector<std::vector<faiss::idx_t>> per_layer(layers_.size());
+    for (int i = 0; i < n; ++i) {
+        if (list_nos[i] >= 0) {
+            per_layer[owner_[list_nos[i]]].push_back(list_nos[i]);
+        }
+    }
+    for (size_t l = 0; l < layers_.size(); ++l) {
+        if (!per_layer[l].empty()) {
+            layers_[l]->prefetch_lists(per_layer[l].data(), static_cast<int>(per_layer[l].size()));
+        }
+    }
+}
+
+size_t LayeredInvertedLists::add_entries(size_t list_no, size_t n_entry, const faiss::idx_t* ids, const uint8_t* code) {
+    return writableLayer(list_no)->add_entries(list_no, n_entry, ids, code);
+}
+
+void LayeredInvertedLists::update_entries(size_t list_no, size_t offset, size_t n_entry, const faiss::idx_t* ids, const uint8_t* code) {
+    writableLayer(list_no)->update_entries(list_no, offset, n_entry, ids, code);
+}
+
+void LayeredInvertedLists::resize(size_t list_no, size_t new_size) {
+    writableLayer(list_no)->resize(list_no, new_size);
+}
+
+void LayeredInvertedLists::reset() {
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    if (frozen_) {
+        pushLayer();
+    }
+    // 清空的列表直接归写入层，不需要复制
+    uint32_t active = static_cast<uint32_t>(layers_.size() - 1);
+    for (size_t list_no = 0; list_no < nlist; ++list_no) {
+        if (owner_[list_no] == active) {
+            layers_[active]->resize(list_no, 0);
+        } else {
+            owner_[list_no] = active;
+        }
+    }
+}
+
+void LayeredInvertedLists::copyFrom(const faiss::InvertedLists* lists) {
+    for (size_t list_no = 0; list_no < nlist; ++list_no) {
+        size_t n = lists->list_size(list_no);
+        if (n > 0) {
+            faiss::InvertedLists::ScopedIds ids(lists, list_no);
+            faiss::InvertedLists::ScopedCodes codes(lists, list_no);
+            add_entries(list_no, n, ids.get(), codes.get());
+        }
+    }
+}
+
+void LayeredInvertedLists::adoptFrozenLayer(faiss::OnDiskInvertedLists* layer) {
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    for (faiss::OnDiskInvertedLists* old : layers_) {
+        std::remove(old->filename.c_str());
+        delete old;
+    }
+    layers_.assign(1, layer);
+    owner_.assign(nlist, 0);
+    frozen_ = true;
+    snapshot_files_ = {layer->filename};
+}
+
+void LayeredInvertedLists::makeWritable(const faiss::IDSelector& sel) {
+    for (size_t list_no = 0; list_no < nlist; ++list_no) {
+        if (!frozen_ && owner_[list_no] == layers_.size() - 1) {
+            continue;
+        }
+        bool selected = false;
+        {
+            size_t n = list_size(list_no);
+            faiss::InvertedLists::ScopedIds ids(this, list_no);
+            for (size_t i = 0; i < n && !selected; ++i) {
+                selected = sel.is_member(ids.get()[i]);
+            }
+        }
+        if (selected) {
+            writableLayer(list_no);
+        }
+    }
+}
+
+void LayeredInvertedLists::setPathPrefix(const std::string& path_prefix) {
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    path_prefix_ = path_prefix;
+}
+
+void LayeredInvertedLists::freeze() {
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    frozen_ = true;
+}
+
+void LayeredInvertedLists::commitSnapshot() {
+    std::vector<std::string> current = files();
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    std::set<std::string> referenced(current.begin(), current.end());
+    // 上一次快照引用、但运行时已不拥有任何列表的层文件不再需要；映射保留到下次新建层时回收
+    for (const std::string& file : snapshot_files_) {
+        if (!referenced.count(file)) {
+            std::remove(file.c_str());
+        }
+    }
+    snapshot_files_.swap(referenced);
+}
+
+std::vector<std::string> LayeredInvertedLists::files() const {
+    std::vector<bool> owns(layers_.size(), false);
+    for (uint32_t layer : owner_) {
+        owns[layer] = true;
+    }
+    std::vector<std::string> result;
+    for (size_t l = 0; l < layers_.size(); ++l) {
+        if (owns[l]) {
+            result.push_back(layers_[l]->filename);
+        }
+    }
+    return result;
+}
+
+faiss::OnDiskInvertedLists* LayeredInvertedLists::writableLayer(size_t list_no) {
+    std::lock_guard<std::mutex> lock(layer_mutex_);
+    if (frozen_) {
+        pushLayer();
+    }
+    size_t active = layers_.size() - 1;
+    if (owner_[list_no] != active) {
+        moveList(list_no, active);
+    }
+    return layers_[active];
+}
+
+void LayeredInvertedLists::pushLayer() {
+    if (path_prefix_.empty()) {
+        throw std::runtime_error("Layered inverted lists have no path for new layers");
+    }
+    dropUnusedLayers();
+
+    std::string path;
+    do {
+        path = path_prefix_ + "." + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    } while (std::any_of(layers_.begin(), layers_.end(), [&](const faiss::OnDiskInvertedLists* layer) { return layer->filename == path; }));
+    layers_.push_back(new faiss::OnDiskInvertedLists(nlist, code_size, path.c_str()));
+    frozen_ = false;
+
+    // 层数过多时将条目最少的冻结层合并到新的写入层，合并后的层在不被快照引用时回收
+    if (layers_.size() > MAX_LAYERS) {
+        std::vector<size_t> entries(layers_.size(), 0);
+        for (size_t l = 0; l < nlist; ++l) {
+            entries[owner_[l]] += layers_[owner_[l]]->list_size(l);
+        }
+        size_t smallest = std::min_element(entries.begin(), entries.end() - 1) - entries.begin();
+        size_t active = layers_.size() - 1;
+        for (size_t l = 0; l < nlist; ++l) {
+            if (owner_[l] == smallest) {
+                moveList(l, active);
+            }
+        }
+        GlobalLogger->info("Merged inverted list layer {} into {}", layers_[smallest]->filename, layers_[active]->filename);
+        dropUnusedLayers();
+    }
+}
+
+void LayeredInvertedLists::moveList(size_t list_no, size_t target) {
+    // 写入层中该列表总是空的：列表只会从冻结层移入写入层，新建的写入层不含任何条目
+    faiss::OnDiskInvertedLists* source = layers_[owner_[list_no]];
+    size_t n = source->list_size(list_no);
+    if (n > 0) {
+        faiss::InvertedLists::ScopedIds ids(source, list_no);
+        faiss::InvertedLists::ScopedCodes codes(source, list_no);
+        layers_[target]->add_entries(list_no, n, ids.get(), codes.get());
+    }
+    owner_[list_no] = static_cast<uint32_t>(target);
+}
+
+void LayeredInvertedLists::dropUnusedLayers() {
+    if (layers_.empty()) {
+        return;
+    }
+    std::vector<bool> owns(layers_.size(), false);
+    for (uint32_t layer : owner_) {
+        owns[layer] = true;
+    }
+    std::vector<uint32_t> remap(layers_.size(), 0);
+    std::vector<faiss::OnDiskInvertedLists*> kept;
+    for (size_t l = 0; l < layers_.size(); ++l) {
+        bool writable = !frozen_ && l + 1 == layers_.size();
+        if (!owns[l] && !writable && !snapshot_files_.count(layers_[l]->filename)) {
+            std::remove(layers_[l]->filename.c_str());
+            delete layers_[l];
+            continue;
+        }
+        remap[l] = static_cast<uint32_t>(kept.size());
+        kept.push_back(layers_[l]);
+    }
+    for (uint32_t& layer : owner_) {
+        layer = remap[layer];
+    }
+    layers_.swap(kept);
+}
+
+// 格式：nlist、code_size、层数，每层的文件名和文件大小，然后是每个列表所在的层及其在该层中的位置
+struct LayeredInvertedListsIOHook : faiss::InvertedListsIOHook {
+    LayeredInvertedListsIOHook() : faiss::InvertedListsIOHook(LAYERED_INVLISTS_KEY, typeid(LayeredInvertedLists).name()) {}
+
+    void write(const faiss::InvertedLists* ils, faiss::IOWriter* f) const override {
+        const LayeredInvertedLists* lists = dynamic_cast<const LayeredInvertedLists*>(ils);
+        uint32_t h = faiss::fourcc(LAYERED_INVLISTS_KEY);
+        writePOD(f, &h, 1);
+        uint64_t nlist = lists->nlist, code_size = lists->code_size;
+        writePOD(f, &nlist, 1);
+        writePOD(f, &code_size, 1);
+
+        // 只写入拥有列表的层
+        std::vector<uint32_t> index(lists->layers_.size(), UINT32_MAX);
+        std::vector<const faiss::OnDiskInvertedLists*> written;
+        for (uint32_t layer : lists->owner_) {
+            if (index[layer] == UINT32_MAX) {
+                index[layer] = static_cast<uint32_t>(written.size());
+                written.push_back(lists->layers_[layer]);
+            }
+        }
+        uint64_t num_layers = written.size();
+        writePOD(f, &num_layers, 1);
+        for (const faiss::OnDiskInvertedLists* layer : written) {
+            uint64_t len = layer->filename.size();
+            writePOD(f, &len, 1);
+            writePOD(f, layer->filename.data(), len);
+            uint64_t totsize = layer->totsize;
+            writePOD(f, &totsize, 1);
+        }
+        for (size_t list_no = 0; list_no < lists->nlist; ++list_no) {
+            uint32_t layer = index[lists->owner_[list_no]];
+            writePOD(f, &layer, 1);
+            writePOD(f, &lists->layers_[lists->owner_[list_no]]->lists[list_no], 1);
+        }
+    }
+
+    faiss::InvertedLists* read(faiss::IOReader* f, int /* io_flags */) const override {
+        uint64_t nlist = 0, code_size = 0, num_layers = 0;
+        readPOD(f, &nlist, 1);
+        readPOD(f, &code_size, 1);
+        readPOD(f, &num_layers, 1);
+        LayeredInvertedLists* lists = new LayeredInvertedLists(nlist, code_size);
+        try {
+            for (uint64_t l = 0; l < num_layers; ++l) {
+                uint64_t len = 0, totsize = 0;
+                readPOD(f, &len, 1);
+                std::string filename(len, '\0');
+                readPOD(f, &filename[0], len);
+                readPOD(f, &totsize, 1);
+
+                // 快照引用的文件不再改变，只读映射
+                faiss::OnDiskInvertedLists* layer = new faiss::OnDiskInvertedLists();
+                lists->layers_.push_back(layer);
+                layer->nlist = nlist;
+                layer->code_size = code_size;
+                layer->lists.resize(nlist);
+                layer->filename = filename;
+                layer->totsize = totsize;
+                layer->read_only = true;
+                lists->snapshot_files_.insert(filename); // 析构时不删除快照引用的文件
+                layer->do_mmap();
+            }
+            for (size_t list_no = 0; list_no < nlist; ++list_no) {
+                uint32_t layer = 0;
+                readPOD(f, &layer, 1);
+                if (layer >= num_layers) {
+                    throw std::runtime_error("Invalid layer in layered inverted lists");
+                }
+                lists->owner_[list_no] = layer;
+                readPOD(f, &lists->layers_[layer]->lists[list_no], 1);
+            }
+        } catch (...) {
+            delete lists;
+            throw;
+        }
+        return lists;
+    }
+};
+
+void registerLayeredInvertedListsIOHook() {
+    static std::once_flag once;
+    std::call_once(once, [] { faiss::InvertedListsIOHook::add_callback(new LayeredInvertedListsIOHook()); });
+}
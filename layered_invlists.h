@@ -0,0 +1,60 @@
+#pragma once
+
+#include <faiss/invlists/InvertedLists.h>
+#include <faiss/invlists/OnDiskInvertedLists.h>
+#include <faiss/impl/IDSelector.h>
+#include <vector>
+#include <string>
+#include <set>
+#include <mutex>
+
+// 分层的 IVF 磁盘倒排表：由多个 OnDiskInvertedLists 文件组成，每个列表只存放在其中一层。
+// 快照时冻结当前写入层，之后修改某个列表前先把它复制到新的写入层（写时复制），
+// 被冻结的文件不再改变，快照只记录各层的文件名和列表位置，加载时直接 mmap 引用这些文件。
+// 写入、删除由调用方独占索引后进行，freeze 和 commitSnapshot 可以与检索并发
+struct LayeredInvertedLists : faiss::InvertedLists {
+    static const size_t MAX_LAYERS = 16; // 层数超过后把最小的冻结层合并到写入层
+
+    LayeredInvertedLists(size_t nlist, size_t code_size, const std::string& path_prefix);
+    ~LayeredInvertedLists() override;
+
+    size_t list_size(size_t list_no) const override;
+    const uint8_t* get_codes(size_t list_no) const override;
+    const faiss::idx_t* get_ids(size_t list_no) const override;
+    void release_codes(size_t list_no, const uint8_t* codes) const override;
+    void release_ids(size_t list_no, const faiss::idx_t* ids) const override;
+    void prefetch_lists(const faiss::idx_t* list_nos, int nlist) const override;
+
+    size_t add_entries(size_t list_no, size_t n_entry, const faiss::idx_t* ids, const uint8_t* code) override;
+    void update_entries(size_t list_no, size_t offset, size_t n_entry, const faiss::idx_t* ids, const uint8_t* code) override;
+    void resize(size_t list_no, size_t new_size) override;
+    void reset() override;
+
+    void copyFrom(const faiss::InvertedLists* lists); // 将内存中的倒排表复制到写入层
+    void adoptFrozenLayer(faiss::OnDiskInvertedLists* layer); // 接管旧格式快照的倒排表文件作为唯一的冻结层，不复制数据
+    void makeWritable(const faiss::IDSelector& sel); // 将包含被选中 ID 的列表复制到写入层，faiss 删除时在列表内原地交换，必须先完成复制
+    void setPathPrefix(const std::string& path_prefix); // 之后新建的层使用该路径前缀
+
+    void freeze(); // 冻结当前各层，之后的修改写入新的层
+    void commitSnapshot(); // 快照文件已生效，删除只被上一次快照引用的层文件
+    std::vector<std::string> files() const; // 当前引用的层文件
+
+private:
+    friend struct LayeredInvertedListsIOHook;
+
+    LayeredInvertedLists(size_t nlist, size_t code_size); // 供读取快照使用，不创建写入层
+    faiss::OnDiskInvertedLists* writableLayer(size_t list_no); // 返回写入层，列表不在写入层时先复制过去
+    void pushLayer(); // 新建写入层，并回收不再引用的层，调用方需持有 layer_mutex_
+    void moveList(size_t list_no, size_t target); // 将列表复制到目标层，调用方需持有 layer_mutex_
+    void dropUnusedLayers(); // 删除不拥有任何列表且不被快照引用的冻结层，调用方需持有 layer_mutex_
+
+    std::vector<faiss::OnDiskInvertedLists*> layers_; // 最后一层在未冻结时接收写入
+    std::vector<uint32_t> owner_; // 每个列表所在的层
+    bool frozen_ = false; // 最后一层已被快照引用，修改前需要新建层
+    std::string path_prefix_;
+    std::set<std::string> snapshot_files_; // 最近一次生效的快照引用的层文件
+    std::mutex layer_mutex_; // faiss 会在多个线程中并行写入不同的列表
+};
+
+// 注册 LayeredInvertedLists 的读写钩子，faiss::write_index / read_index 通过它保存和加载分层倒排表
+void registerLayeredInvertedListsIOHook();
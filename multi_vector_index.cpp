@@ -0,0 +1,218 @@
+#include "multi_vector_index.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+#include <queue>
+#include <limits>
+
+namespace {
+    const uint64_t MAX_DOC_ID = 0xffffffffULL; // 标签高 32 位保存文档 ID，与过滤位图的 ID 范围一致
+
+    hnswlib::labeltype chunkLabel(uint64_t doc_id, size_t chunk) {
+        return static_cast<hnswlib::labeltype>((doc_id << 32) | chunk);
+    }
+
+    // MaxSim 计算用的线程局部缓冲区，多次检索之间复用，避免每个候选文档分配内存
+    struct MaxSimArena {
+        std::vector<uint64_t> docs;
+        std::vector<size_t> doc_sizes;
+        std::vector<const char*> doc_vectors; // 当前候选文档所有向量在索引中的地址
+        std::vector<float> best; // 每个查询 token 到当前文档的最近距离
+    };
+    thread_local MaxSimArena maxsim_arena;
+}
+
+MultiVectorIndex::MultiVectorIndex(int dim, int num_data, IndexFactory::MetricType metric, int M, int ef_construction)
+    : max_elements(num_data), dim(dim) {
+    if (metric == IndexFactory::MetricType::L2) {
+        space = new hnswlib::MultiVectorL2Space<uint64_t>(dim);
+    } else {
+        space = new hnswlib::MultiVectorInnerProductSpace<uint64_t>(dim);
+    }
+    index = new hnswlib::HierarchicalNSW<float>(space, num_data, M, ef_construction);
+}
+
+MultiVectorIndex::~MultiVectorIndex() {
+    delete index;
+    delete space;
+}
+
+void MultiVectorIndex::insert_vectors(const std::vector<float>& data, uint64_t doc_id) {
+    if (data.empty() || data.size() % dim != 0) {
+        throw std::invalid_argument("Multi-vector document size must be a non-zero multiple of the dimension");
+    }
+    if (doc_id > MAX_DOC_ID) {
+        throw std::invalid_argument("Multi-vector document id must fit in 32 bits");
+    }
+    size_t num = data.size() / dim;
+
+    // 每个向量后面附带文档 ID，检索时按文档计数
+    std::vector<char> point(space->get_data_size());
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    std::lock_guard<std::mutex> doc_lock(doc_mutex);
+    for (size_t i = 0; i < num; ++i) {
+        memcpy(point.data(), data.data() + i * dim, dim * sizeof(float));
+        space->set_doc_id(point.data(), doc_id);
+        index->addPoint(point.data(), chunkLabel(doc_id, i)); // 已有的块原位更新
+    }
+
+    // 文档变短时删除多出来的旧向量
+    size_t& old_num = doc_sizes[doc_id];
+    for (size_t i = num; i < old_num; ++i) {
+        index->markDelete(chunkLabel(doc_id, i));
+    }
+    old_num = num;
+}
+
+std::vector<std::pair<float, uint64_t>> MultiVectorIndex::searchDocs(const float* query, size_t num_docs, const roaring_bitmap_t* bitmap, size_t ef) {
+    std::unique_ptr<DocIDFilter> selector;
+    if (bitmap != nullptr) {
+        selector.reset(new DocIDFilter(bitmap));
+    }
+
+    // 结果集中有 ef 个不同文档且下一个候选更远时停止，最后保留最近的 num_docs 个文档的所有向量
+    hnswlib::MultiVectorSearchStopCondition<uint64_t, float> stop_condition(*space, num_docs, ef);
+    auto result = index->searchStopConditionClosest(query, stop_condition, selector.get());
+
+    // 结果按距离由近到远，每个文档第一次出现时的距离就是文档距离
+    std::vector<std::pair<float, uint64_t>> docs;
+    std::unordered_set<uint64_t> seen;
+    for (const auto& item : result) {
+        uint64_t doc_id = item.second >> 32;
+        if (seen.insert(doc_id).second) {
+            docs.emplace_back(item.first, doc_id);
+        }
+    }
+    return docs;
+}
+
+std::pair<std::vector<long>, std::vector<float>> MultiVectorIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int ef_search) {
+    size_t num_docs = static_cast<size_t>(std::max(k, 1));
+    size_t ef = static_cast<size_t>(std::max(ef_search, 1));
+    size_t num_queries = query.size() / dim;
+    std::vector<long> indices(num_queries * k, -1);
+    std::vector<float> distances(num_queries * k, 0);
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    for (size_t q = 0; q < num_queries; ++q) {
+        auto docs = searchDocs(query.data() + q * dim, num_docs, bitmap, ef);
+        for (size_t j = 0; j < docs.size(); ++j) { // 与其他检索方式一致，按距离由远到近排列
+            indices[q * k + j] = static_cast<long>(docs[docs.size() - 1 - j].second);
+            distances[q * k + j] = docs[docs.size() - 1 - j].first;
+        }
+    }
+    return {indices, distances};
+}
+
+std::pair<std::vector<long>, std::vector<float>> MultiVectorIndex::maxsim_search(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int ef_search, int candidates) {
+    size_t num_tokens = query.size() / dim;
+    std::vector<long> indices(k, -1);
+    std::vector<float> distances(k, 0);
+    if (num_tokens == 0 || k <= 0) {
+        return {indices, distances};
+    }
+    size_t num_candidates = static_cast<size_t>(candidates > 0 ? candidates : k);
+    size_t ef = static_cast<size_t>(std::max(ef_search, 1));
+    MaxSimArena& arena = maxsim_arena;
+
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+
+    // 每个查询 token 在索引中检索最近的文档，合并为候选集合
+    arena.docs.clear();
+    for (size_t t = 0; t < num_tokens; ++t) {
+        for (const auto& doc : searchDocs(query.data() + t * dim, num_candidates, bitmap, ef)) {
+            arena.docs.push_back(doc.second);
+        }
+    }
+    std::sort(arena.docs.begin(), arena.docs.end());
+    arena.docs.erase(std::unique(arena.docs.begin(), arena.docs.end()), arena.docs.end());
+    {
+        std::lock_guard<std::mutex> doc_lock(doc_mutex);
+        arena.doc_sizes.resize(arena.docs.size());
+        for (size_t i = 0; i < arena.docs.size(); ++i) {
+            auto it = doc_sizes.find(arena.docs[i]);
+            arena.doc_sizes[i] = it == doc_sizes.end() ? 0 : it->second;
+        }
+    }
+
+    // 精确计算每个候选文档的 MaxSim，外层遍历文档向量，每个文档向量只读取一次，查询矩阵留在缓存中
+    hnswlib::DISTFUNC<float> dist_func = space->get_dist_func();
+    void* dist_func_param = space->get_dist_func_param();
+    std::priority_queue<std::pair<float, uint64_t>> top_docs; // 距离最小的 k 个文档，堆顶为最远的文档
+    for (size_t i = 0; i < arena.docs.size(); ++i) {
+        arena.doc_vectors.clear();
+        for (size_t chunk = 0; chunk < arena.doc_sizes[i]; ++chunk) {
+            auto search = index->label_lookup_.find(chunkLabel(arena.docs[i], chunk));
+            if (search != index->label_lookup_.end() && !index->isMarkedDeleted(search->second)) {
+                arena.doc_vectors.push_back(index->getDataByInternalId(search->second));
+            }
+        }
+        if (arena.doc_vectors.empty()) {
+            continue;
+        }
+
+        arena.best.assign(num_tokens, std::numeric_limits<float>::max());
+        for (const char* doc_vector : arena.doc_vectors) {
+            for (size_t t = 0; t < num_tokens; ++t) {
+                float dist = dist_func(query.data() + t * dim, doc_vector, dist_func_param);
+                arena.best[t] = std::min(arena.best[t], dist);
+            }
+        }
+        float score = 0;
+        for (float best : arena.best) {
+            score += best;
+        }
+        if (top_docs.size() < static_cast<size_t>(k) || score < top_docs.top().first) {
+            top_docs.emplace(score, arena.docs[i]);
+            if (top_docs.size() > static_cast<size_t>(k)) {
+                top_docs.pop();
+            }
+        }
+    }
+
+    for (size_t j = 0; !top_docs.empty(); ++j) { // 与其他检索方式一致，按距离由远到近排列
+        indices[j] = static_cast<long>(top_docs.top().second);
+        distances[j] = top_docs.top().first;
+        top_docs.pop();
+    }
+    return {indices, distances};
+}
+
+size_t MultiVectorIndex::num_vectors(uint64_t doc_id) {
+    std::lock_guard<std::mutex> doc_lock(doc_mutex);
+    auto it = doc_sizes.find(doc_id);
+    return it == doc_sizes.end() ? 0 : it->second;
+}
+
+void MultiVectorIndex::saveIndex(const std::string& file_path) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    index->saveIndex(file_path);
+}
+
+void MultiVectorIndex::loadIndex(const std::string& file_path) {
+    std::ifstream file(file_path);
+    if (!file.good()) {
+        GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
+        return;
+    }
+    file.close();
+
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    index->loadIndex(file_path, space, max_elements);
+
+    // 未删除的向量的块序号连续，文档的向量数为最大块序号加 1
+    std::lock_guard<std::mutex> doc_lock(doc_mutex);
+    doc_sizes.clear();
+    for (size_t i = 0; i < index->cur_element_count; ++i) {
+        if (index->isMarkedDeleted(i)) {
+            continue;
+        }
+        hnswlib::labeltype label = index->getExternalLabel(i);
+        size_t& num = doc_sizes[label >> 32];
+        num = std::max(num, static_cast<size_t>(label & MAX_DOC_ID) + 1);
+    }
+    GlobalLogger->info("Multi-vector index loaded with {} documents", doc_sizes.size());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "hnswlib/hnswlib.h"
+#include "index_factory.h"
+#include "roaring/roaring.h"
+#include <vector>
+#include <string>
+#include <shared_mutex>
+#include <mutex>
+#include <unordered_map>
+
+// 多向量文档索引：一个文档 ID 下保存多个向量（文本分块、图像分块等），
+// 检索返回距离最近的 k 个不同文档，文档距离取其最近向量的距离。
+// 每个向量的标签为 (文档 ID << 32) | 块序号，数据末尾附带文档 ID，检索时按文档计数，找到足够的文档后提前停止
+class MultiVectorIndex {
+public:
+    MultiVectorIndex(int dim, int num_data, IndexFactory::MetricType metric, int M = 16, int ef_construction = 200); // num_data 为所有文档的向量总数上限
+    ~MultiVectorIndex();
+
+    void insert_vectors(const std::vector<float>& data, uint64_t doc_id); // data 为文档的所有向量首尾相接，已存在的文档整体替换
+    std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50); // 返回文档 ID，与 HNSW 索引一致按距离由远到近，多个查询时每个查询占 k 个位置，不足用 -1 填充
+    // 延迟交互检索：query 为一个查询的所有 token 向量，每个 token 在索引中取 candidates 个候选文档，
+    // 再对候选文档的所有向量精确计算 MaxSim，返回得分最高的 k 个文档。
+    // 距离为每个查询 token 到文档最近向量的距离之和，内积时等于 token 数减去 MaxSim 得分
+    std::pair<std::vector<long>, std::vector<float>> maxsim_search(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50, int candidates = 0);
+    size_t num_vectors(uint64_t doc_id); // 文档当前的向量数
+    void saveIndex(const std::string& file_path);
+    void loadIndex(const std::string& file_path); // 加载后按标签重建文档的向量数
+
+    // 检索时按向量标签中的文档 ID 检查过滤位图
+    class DocIDFilter : public hnswlib::BaseFilterFunctor {
+    public:
+        DocIDFilter(const roaring_bitmap_t* bitmap) : bitmap_(bitmap) {}
+
+        bool operator()(hnswlib::labeltype label) {
+            return roaring_bitmap_contains(bitmap_, static_cast<uint32_t>(label >> 32));
+        }
+
+    private:
+        const roaring_bitmap_t* bitmap_;
+    };
+
+private:
+    std::vector<std::pair<float, uint64_t>> searchDocs(const float* query, size_t num_docs, const roaring_bitmap_t* bitmap, size_t ef); // 单个查询向量最近的 num_docs 个文档，按距离由近到远
+
+    hnswlib::HierarchicalNSW<float>* index;
+    hnswlib::BaseMultiVectorSpace<uint64_t>* space;
+    size_t max_elements;
+    size_t dim;
+    std::unordered_map<uint64_t, size_t> doc_sizes; // 文档 ID 到向量数，已删除的向量不计入
+    std::shared_mutex rw_mutex; // 加载和保存时独占索引
+    std::mutex doc_mutex; // 同一时间只更新一个文档，保证文档的向量数与索引一致
+};
@@ -103,7 +103,7 @@ void Persistence::takeSnapshot(ScalarStorage& scalar_storage) { // 移除 takeSn
     lastSnapshotID_ =  increaseID_;
     std::string snapshot_folder_path = "snapshots_";
     IndexFactory* index_factory = getGlobalIndexFactory(); // 通过全局指针获取 IndexFactory 实例
-    index_factory->saveIndex(snapshot_folder_path, scalar_storage);
+    index_factory->saveIndex(snapshot_folder_path, scalar_storage); // 磁盘倒排表复制到每个快照独有的文件中
 
     saveLastSnapshotID();
 }
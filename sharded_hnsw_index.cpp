@@ -0,0 +1,291 @@
+#include "sharded_hnsw_index.h"
+#include "logger.h"
+#include <algorithm>
+#include <future>
+#include <fstream>
+#include <limits>
+
+namespace {
+    const uint64_t SHARDED_SNAPSHOT_MAGIC = 0x44524148534e4853ULL; // "SHNSHARD"
+}
+
+ShardedHNSWIndex::ShardedHNSWIndex(int dim, int num_data, IndexFactory::MetricType metric, int num_shards, IndexFactory::DataType data_type)
+    : dim(data_type == IndexFactory::DataType::BINARY ? dim / 8 : dim), next_id(0), stopping(false) {
+    if (num_shards < 1) {
+        throw std::invalid_argument("Sharded HNSW index needs at least one shard");
+    }
+    int shard_capacity = (num_data + num_shards - 1) / num_shards;
+    for (int i = 0; i < num_shards; ++i) {
+        shards.push_back(new HNSWLibIndex(dim, shard_capacity, metric, 16, 200, data_type));
+    }
+    for (int i = 1; i < num_shards; ++i) {
+        workers.emplace_back(&ShardedHNSWIndex::workerLoop, this);
+    }
+    GlobalLogger->info("Sharded HNSW index created with {} shards of {} elements", num_shards, shard_capacity);
+}
+
+ShardedHNSWIndex::~ShardedHNSWIndex() {
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        stopping = true;
+    }
+    task_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (HNSWLibIndex* shard : shards) {
+        delete shard;
+    }
+}
+
+void ShardedHNSWIndex::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(task_mutex);
+            task_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ShardedHNSWIndex::runTask(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_cv.notify_one();
+}
+
+int ShardedHNSWIndex::routeLabel(uint64_t label) {
+    std::lock_guard<std::mutex> lock(route_mutex);
+    auto it = label_to_shard.find(label);
+    if (it != label_to_shard.end()) {
+        return it->second;
+    }
+    int shard = static_cast<int>(next_id++ % shards.size());
+    label_to_shard[label] = shard;
+    return shard;
+}
+
+void ShardedHNSWIndex::insert_vectors(const std::vector<float>& data, uint64_t label) {
+    shards[routeLabel(label)]->insert_vectors(data, label);
+}
+
+std::pair<std::vector<long>, std::vector<float>> ShardedHNSWIndex::search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap, int ef_search, bool filtered_traversal,
+                                                                                  size_t patience, size_t max_distance_computations, std::vector<hnswlib::SearchTerminationStats>* stats) {
+    size_t num = shards.size();
+    std::vector<std::pair<std::vector<long>, std::vector<float>>> shard_results(num);
+
+    // 距离计算预算按分片平分，各分片分别记录终止统计，之后按查询合并
+    size_t shard_budget = (max_distance_computations + num - 1) / num;
+    std::vector<std::vector<hnswlib::SearchTerminationStats>> shard_stats(num);
+    runOnShards([&](size_t i) {
+        shard_results[i] = shards[i]->search_vectors(query, k, bitmap, ef_search, filtered_traversal, patience, shard_budget,
+                                                     stats != nullptr ? &shard_stats[i] : nullptr);
+    });
+
+    // 每个查询的跳数和距离计算次数为各分片之和，终止原因取最受限的分片
+    size_t num_queries = query.size() / dim;
+    if (stats != nullptr) {
+        for (size_t q = 0; q < shard_stats[0].size(); ++q) {
+            hnswlib::SearchTerminationStats merged;
+            for (const auto& shard_stat : shard_stats) {
+                merged.hops += shard_stat[q].hops;
+                merged.distance_computations += shard_stat[q].distance_computations;
+                merged.max_stale_hops = std::max(merged.max_stale_hops, shard_stat[q].max_stale_hops);
+                merged.reason = std::max(merged.reason, shard_stat[q].reason);
+            }
+            stats->push_back(merged);
+        }
+    }
+
+    // 合并各分片结果，取全局距离最小的 k 个
+    if (num_queries <= 1) {
+        return mergeResults(shard_results, 0, std::numeric_limits<size_t>::max(), k, true);
+    }
+
+    // 批量检索时各分片对每个查询返回 k 个位置，逐个查询合并后用 -1 填充到 k 个
+    std::vector<long> indices(num_queries * k, -1);
+    std::vector<float> distances(num_queries * k, 0);
+    for (size_t q = 0; q < num_queries; ++q) {
+        auto merged = mergeResults(shard_results, q * k, k, k, true);
+        std::copy(merged.first.begin(), merged.first.end(), indices.begin() + q * k);
+        std::copy(merged.second.begin(), merged.second.end(), distances.begin() + q * k);
+    }
+    return {indices, distances};
+}
+
+std::pair<std::vector<long>, std::vector<float>> ShardedHNSWIndex::range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap, size_t max_results, int ef_search) {
+    std::vector<std::pair<std::vector<long>, std::vector<float>>> shard_results(shards.size());
+    runOnShards([&](size_t i) {
+        shard_results[i] = shards[i]->range_search(query, radius, bitmap, max_results, ef_search);
+    });
+    return mergeResults(shard_results, 0, std::numeric_limits<size_t>::max(), static_cast<int>(std::min<size_t>(max_results, std::numeric_limits<int>::max())), false);
+}
+
+void ShardedHNSWIndex::runOnShards(const std::function<void(size_t)>& fn) {
+    // 除第一个分片外，其余分片提交到线程池并行执行
+    std::vector<std::future<void>> futures;
+    for (size_t i = 1; i < shards.size(); ++i) {
+        auto task = std::make_shared<std::packaged_task<void()>>([&fn, i]() {
+            fn(i);
+        });
+        futures.push_back(task->get_future());
+        runTask([task]() { (*task)(); });
+    }
+    std::exception_ptr error;
+    try {
+        fn(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // 必须等待全部分片结束，任务引用了调用方的局部变量
+    for (auto& future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::pair<std::vector<long>, std::vector<float>> ShardedHNSWIndex::mergeResults(const std::vector<std::pair<std::vector<long>, std::vector<float>>>& shard_results, size_t offset, size_t count, int k, bool farthest_first) {
+    std::vector<std::pair<float, long>> merged;
+    for (const auto& result : shard_results) {
+        size_t end = std::min(result.first.size(), offset + std::min(count, result.first.size()));
+        for (size_t j = offset; j < end; ++j) {
+            if (result.first[j] != -1) {
+                merged.emplace_back(result.second[j], result.first[j]);
+            }
+        }
+    }
+    size_t top = std::min(merged.size(), static_cast<size_t>(std::max(k, 0)));
+    std::partial_sort(merged.begin(), merged.begin() + top, merged.end());
+    if (farthest_first) { // k 近邻检索与 HNSWLibIndex 一致由远到近，范围检索由近到远
+        std::reverse(merged.begin(), merged.begin() + top);
+    }
+
+    std::vector<long> indices(top);
+    std::vector<float> distances(top);
+    for (size_t j = 0; j < top; ++j) {
+        indices[j] = merged[j].second;
+        distances[j] = merged[j].first;
+    }
+    return {indices, distances};
+}
+
+void ShardedHNSWIndex::setMemoryPolicy(const hnswlib::MemoryPolicy& policy) {
+    for (HNSWLibIndex* shard : shards) {
+        shard->setMemoryPolicy(policy);
+    }
+}
+
+std::vector<HNSWLibIndex::CalibrationPoint> ShardedHNSWIndex::calibrate(const std::vector<int>& ef_values, size_t num_samples, int k) {
+    std::vector<HNSWLibIndex::CalibrationPoint> curve;
+    for (HNSWLibIndex* shard : shards) {
+        auto shard_curve = shard->calibrate(ef_values, num_samples, k);
+        if (curve.empty()) {
+            curve = shard_curve;
+            continue;
+        }
+        for (size_t i = 0; i < curve.size(); ++i) {
+            curve[i].recall = std::min(curve[i].recall, shard_curve[i].recall);
+            curve[i].patience = std::max(curve[i].patience, shard_curve[i].patience);
+        }
+    }
+    return curve;
+}
+
+int ShardedHNSWIndex::efForRecall(float recall_target, int k) {
+    int ef = -1;
+    for (HNSWLibIndex* shard : shards) {
+        int shard_ef = shard->efForRecall(recall_target, k);
+        if (shard_ef < 0) {
+            return -1;
+        }
+        ef = std::max(ef, shard_ef);
+    }
+    return ef;
+}
+
+size_t ShardedHNSWIndex::patienceForEf(int ef, int k) {
+    size_t patience = 0;
+    for (HNSWLibIndex* shard : shards) {
+        patience = std::max(patience, shard->patienceForEf(ef, k));
+    }
+    return patience;
+}
+
+size_t ShardedHNSWIndex::num_shards() const {
+    return shards.size();
+}
+
+void ShardedHNSWIndex::saveIndex(const std::string& file_path) {
+    {
+        std::lock_guard<std::mutex> lock(route_mutex);
+        std::ofstream out(file_path, std::ios::binary);
+        if (!out) {
+            GlobalLogger->error("Failed to open file for writing: {}", file_path);
+            return;
+        }
+        uint64_t num = shards.size();
+        uint64_t num_labels = label_to_shard.size();
+        out.write(reinterpret_cast<const char*>(&SHARDED_SNAPSHOT_MAGIC), sizeof(SHARDED_SNAPSHOT_MAGIC));
+        out.write(reinterpret_cast<const char*>(&num), sizeof(num));
+        out.write(reinterpret_cast<const char*>(&next_id), sizeof(next_id));
+        out.write(reinterpret_cast<const char*>(&num_labels), sizeof(num_labels));
+        for (const auto& entry : label_to_shard) {
+            uint64_t shard = entry.second;
+            out.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+            out.write(reinterpret_cast<const char*>(&shard), sizeof(shard));
+        }
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shards[i]->saveIndex(file_path + ".shard" + std::to_string(i));
+    }
+}
+
+void ShardedHNSWIndex::loadIndex(const std::string& file_path) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in.good()) {
+        GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
+        return;
+    }
+
+    uint64_t magic = 0, num = 0, num_labels = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&num), sizeof(num));
+    if (magic != SHARDED_SNAPSHOT_MAGIC) {
+        GlobalLogger->error("Invalid sharded HNSW snapshot: {}", file_path);
+        return;
+    }
+    if (num != shards.size()) { // 分片数改变后路由表失效，需要重新导入数据
+        GlobalLogger->error("Sharded HNSW snapshot has {} shards, configured {}", num, shards.size());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(route_mutex);
+    in.read(reinterpret_cast<char*>(&next_id), sizeof(next_id));
+    in.read(reinterpret_cast<char*>(&num_labels), sizeof(num_labels));
+    label_to_shard.clear();
+    label_to_shard.reserve(num_labels);
+    for (uint64_t i = 0; i < num_labels; ++i) {
+        uint64_t label = 0, shard = 0;
+        in.read(reinterpret_cast<char*>(&label), sizeof(label));
+        in.read(reinterpret_cast<char*>(&shard), sizeof(shard));
+        label_to_shard[label] = static_cast<int>(shard);
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shards[i]->loadIndex(file_path + ".shard" + std::to_string(i));
+    }
+    GlobalLogger->info("Loaded sharded HNSW index with {} labels", num_labels);
+}
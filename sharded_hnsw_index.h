@@ -0,0 +1,54 @@
+#pragma once
+
+#include "hnswlib_index.h"
+#include "index_factory.h"
+#include "roaring/roaring.h"
+#include <vector>
+#include <string>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+// 节点内分片的 HNSW 索引：新向量按内部 ID 轮流分配到各分片，
+// 检索时各分片在线程池中并行检索，再合并为全局 top-k，单个查询可以利用多个核
+class ShardedHNSWIndex {
+public:
+    ShardedHNSWIndex(int dim, int num_data, IndexFactory::MetricType metric, int num_shards, IndexFactory::DataType data_type = IndexFactory::DataType::FLOAT32);
+    ~ShardedHNSWIndex();
+
+    void insert_vectors(const std::vector<float>& data, uint64_t label); // 已存在的标签在原分片中更新
+    std::pair<std::vector<long>, std::vector<float>> search_vectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50, bool filtered_traversal = false,
+                                                                    size_t patience = 0, size_t max_distance_computations = 0, std::vector<hnswlib::SearchTerminationStats>* stats = nullptr); // 与 HNSWLibIndex 一致，结果按距离由远到近，多个查询时每个查询占 k 个位置
+    std::pair<std::vector<long>, std::vector<float>> range_search(const std::vector<float>& query, float radius, const roaring_bitmap_t* bitmap = nullptr, size_t max_results = 1000, int ef_search = 50); // 各分片分别检索后合并，按距离由近到远
+    void setMemoryPolicy(const hnswlib::MemoryPolicy& policy);
+    std::vector<HNSWLibIndex::CalibrationPoint> calibrate(const std::vector<int>& ef_values, size_t num_samples, int k); // 逐个分片校准，返回各 ef 在所有分片中最低的召回率和最大的耐心值
+    int efForRecall(float recall_target, int k); // 各分片达到目标召回率所需 ef 的最大值，有分片未以该 k 校准时返回 -1
+    size_t patienceForEf(int ef, int k); // 各分片耐心值的最大值
+    size_t num_shards() const;
+    void saveIndex(const std::string& file_path); // file_path 保存路由表，各分片保存到 file_path.shard<i>
+    void loadIndex(const std::string& file_path);
+
+private:
+    // 合并各分片结果中 [offset, offset + count) 区间的候选，取距离最小的 k 个，farthest_first 为 true 时由远到近排列
+    static std::pair<std::vector<long>, std::vector<float>> mergeResults(const std::vector<std::pair<std::vector<long>, std::vector<float>>>& shard_results, size_t offset, size_t count, int k, bool farthest_first);
+    void runOnShards(const std::function<void(size_t)>& fn); // 在线程池中对每个分片并行执行 fn(i)，等待全部结束并重新抛出异常
+    int routeLabel(uint64_t label); // 已有标签返回所在分片，新标签按内部 ID 对分片数取模
+    void runTask(std::function<void()> task);
+    void workerLoop();
+
+    int dim; // 每个向量的输入值个数，二值向量为字节数
+    std::vector<HNSWLibIndex*> shards;
+    std::unordered_map<uint64_t, int> label_to_shard;
+    uint64_t next_id; // 下一个新向量的内部 ID
+    std::mutex route_mutex;
+
+    // 检索线程池，调用线程自己检索第一个分片，其余分片交给工作线程
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex task_mutex;
+    std::condition_variable task_cv;
+    bool stopping;
+};
@@ -0,0 +1,306 @@
+#include "sparse_index.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+    const uint64_t SPARSE_SNAPSHOT_MAGIC = 0x5849455352415053ULL; // "SPARSEIX"
+    const uint32_t END_DOC = std::numeric_limits<uint32_t>::max();
+
+    template<typename T>
+    void writePOD(std::ofstream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void readPOD(std::ifstream& in, T& value) {
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+}
+
+void SparseIndex::PostingList::append(uint32_t doc, float value) {
+    if (docs.size() % BLOCK_SIZE == 0) {
+        block_last.push_back(doc);
+        block_max.push_back(value);
+        block_min.push_back(value);
+    }
+    docs.push_back(doc);
+    values.push_back(value);
+    block_last.back() = doc;
+    block_max.back() = std::max(block_max.back(), value);
+    block_min.back() = std::min(block_min.back(), value);
+    max_value = docs.size() == 1 ? value : std::max(max_value, value);
+    min_value = docs.size() == 1 ? value : std::min(min_value, value);
+}
+
+struct SparseIndex::Cursor {
+    const PostingList* list;
+    float weight;
+    float upper; // 整条倒排链对得分的贡献上界
+    size_t pos = 0;
+    size_t block = 0; // 可以领先 pos 所在的块，只用于计算块上界
+
+    Cursor(const PostingList* list, float weight)
+        : list(list), weight(weight), upper(std::max(0.0f, weight * (weight > 0 ? list->max_value : list->min_value))) {}
+
+    uint32_t doc() const {
+        return pos < list->docs.size() ? list->docs[pos] : END_DOC;
+    }
+
+    float score() const {
+        return weight * list->values[pos];
+    }
+
+    // 移到第一个文档序号不小于 target 的位置
+    void nextGeq(uint32_t target) {
+        while (block < list->block_last.size() && list->block_last[block] < target) {
+            ++block;
+        }
+        if (block == list->block_last.size()) {
+            pos = list->docs.size();
+            return;
+        }
+        auto begin = list->docs.begin() + std::max(pos, block * BLOCK_SIZE);
+        auto end = list->docs.begin() + std::min(list->docs.size(), (block + 1) * BLOCK_SIZE);
+        pos = std::lower_bound(begin, end, target) - list->docs.begin();
+    }
+
+    // 不移动 pos，返回包含 target 的块对得分的贡献上界，blockEnd 返回该块最后一个文档序号
+    float blockUpper(uint32_t target, uint32_t& blockEnd) {
+        while (block < list->block_last.size() && list->block_last[block] < target) {
+            ++block;
+        }
+        if (block == list->block_last.size()) {
+            blockEnd = END_DOC;
+            return 0;
+        }
+        blockEnd = list->block_last[block];
+        return std::max(0.0f, weight * (weight > 0 ? list->block_max[block] : list->block_min[block]));
+    }
+};
+
+void SparseIndex::insertLocked(const SparseVector& data, uint64_t label) {
+    if (data.indices.size() != data.values.size()) {
+        throw std::invalid_argument("Sparse vector indices and values must have the same size");
+    }
+    removeLocked(label);
+
+    uint32_t doc = static_cast<uint32_t>(doc_labels.size());
+    if (doc == END_DOC) {
+        throw std::runtime_error("Sparse index is full");
+    }
+    doc_labels.push_back(label);
+    deleted.push_back(false);
+    label_to_doc[label] = doc;
+    for (size_t i = 0; i < data.indices.size(); ++i) {
+        if (data.values[i] != 0) {
+            postings[data.indices[i]].append(doc, data.values[i]);
+        }
+    }
+}
+
+void SparseIndex::removeLocked(uint64_t label) {
+    // 倒排链中的旧项保留，检索时跳过，块上界仍然有效
+    auto it = label_to_doc.find(label);
+    if (it != label_to_doc.end()) {
+        deleted[it->second] = true;
+        label_to_doc.erase(it);
+    }
+}
+
+void SparseIndex::insert_vectors(const SparseVector& data, uint64_t label) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    insertLocked(data, label);
+}
+
+void SparseIndex::remove_vectors(const std::vector<long>& ids) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    for (long id : ids) {
+        removeLocked(static_cast<uint64_t>(id));
+    }
+}
+
+std::pair<std::vector<long>, std::vector<float>> SparseIndex::search_vectors(const SparseVector& query, int k, const roaring_bitmap_t* bitmap) {
+    std::vector<long> indices;
+    std::vector<float> distances;
+    if (k <= 0) {
+        return {indices, distances};
+    }
+
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    std::vector<Cursor> cursors;
+    for (size_t i = 0; i < query.indices.size() && i < query.values.size(); ++i) {
+        auto it = postings.find(query.indices[i]);
+        if (it != postings.end() && query.values[i] != 0) {
+            cursors.emplace_back(&it->second, query.values[i]);
+        }
+    }
+
+    // 小顶堆保存当前 top-k，堆顶得分为进入 top-k 的门槛
+    std::priority_queue<std::pair<float, uint32_t>, std::vector<std::pair<float, uint32_t>>, std::greater<std::pair<float, uint32_t>>> top;
+    float threshold = std::numeric_limits<float>::lowest();
+    size_t num = static_cast<size_t>(k);
+    auto byDoc = [](const Cursor& a, const Cursor& b) { return a.doc() < b.doc(); };
+    while (true) {
+        // 按当前文档排序，累加倒排链上界直到超过门槛，得到候选文档 pivot
+        std::sort(cursors.begin(), cursors.end(), byDoc);
+        float upper = 0;
+        size_t p = 0;
+        bool found = false;
+        for (; p < cursors.size() && cursors[p].doc() != END_DOC; ++p) {
+            upper += cursors[p].upper;
+            if (upper > threshold) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        uint32_t pivot = cursors[p].doc();
+        while (p + 1 < cursors.size() && cursors[p + 1].doc() == pivot) {
+            ++p;
+        }
+
+        // 再用 pivot 所在块的上界检查，块上界之和不超过门槛时跳过这些块覆盖的所有文档
+        float block_upper = 0;
+        uint32_t next = p + 1 < cursors.size() ? cursors[p + 1].doc() : END_DOC;
+        for (size_t i = 0; i <= p; ++i) {
+            uint32_t block_end;
+            block_upper += cursors[i].blockUpper(pivot, block_end);
+            next = std::min(next, block_end == END_DOC ? END_DOC : block_end + 1);
+        }
+
+        if (block_upper > threshold) {
+            if (cursors[0].doc() == pivot) {
+                // 前 p + 1 个游标都在 pivot 上，精确计分
+                float score = 0;
+                for (size_t i = 0; i <= p; ++i) {
+                    score += cursors[i].score();
+                }
+                bool allowed = !deleted[pivot] && (bitmap == nullptr || roaring_bitmap_contains(bitmap, static_cast<uint32_t>(doc_labels[pivot])));
+                if (allowed && (top.size() < num || score > threshold)) {
+                    top.emplace(score, pivot);
+                    if (top.size() > num) {
+                        top.pop();
+                    }
+                    if (top.size() == num) {
+                        threshold = top.top().first;
+                    }
+                }
+                for (size_t i = 0; i <= p; ++i) {
+                    cursors[i].nextGeq(pivot + 1);
+                }
+            } else {
+                // pivot 之前的文档不可能进入 top-k
+                for (size_t i = 0; i < p && cursors[i].doc() < pivot; ++i) {
+                    cursors[i].nextGeq(pivot);
+                }
+            }
+        } else {
+            for (size_t i = 0; i <= p; ++i) {
+                cursors[i].nextGeq(next);
+            }
+        }
+    }
+
+    // 与 HNSW 内积索引一致，距离为 1 - 内积，按距离由近到远排列
+    while (!top.empty()) {
+        indices.push_back(static_cast<long>(doc_labels[top.top().second]));
+        distances.push_back(1.0f - top.top().first);
+        top.pop();
+    }
+    std::reverse(indices.begin(), indices.end());
+    std::reverse(distances.begin(), distances.end());
+    return {indices, distances};
+}
+
+void SparseIndex::saveIndex(const std::string& file_path) {
+    // 快照只保存未删除的文档，加载时重新分配文档序号
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    std::vector<uint32_t> remap(doc_labels.size(), END_DOC);
+    std::vector<uint64_t> labels;
+    for (size_t doc = 0; doc < doc_labels.size(); ++doc) {
+        if (!deleted[doc]) {
+            remap[doc] = static_cast<uint32_t>(labels.size());
+            labels.push_back(doc_labels[doc]);
+        }
+    }
+
+    std::ofstream out(file_path, std::ios::binary);
+    writePOD(out, SPARSE_SNAPSHOT_MAGIC);
+    writePOD(out, static_cast<uint64_t>(labels.size()));
+    out.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(uint64_t));
+    writePOD(out, static_cast<uint64_t>(postings.size()));
+    std::vector<uint32_t> docs;
+    std::vector<float> values;
+    for (const auto& entry : postings) {
+        docs.clear();
+        values.clear();
+        for (size_t i = 0; i < entry.second.docs.size(); ++i) {
+            uint32_t doc = remap[entry.second.docs[i]];
+            if (doc != END_DOC) {
+                docs.push_back(doc);
+                values.push_back(entry.second.values[i]);
+            }
+        }
+        writePOD(out, entry.first);
+        writePOD(out, static_cast<uint64_t>(docs.size()));
+        out.write(reinterpret_cast<const char*>(docs.data()), docs.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    }
+}
+
+void SparseIndex::loadIndex(const std::string& file_path) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in.good()) {
+        GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
+        return;
+    }
+    uint64_t magic = 0;
+    readPOD(in, magic);
+    if (magic != SPARSE_SNAPSHOT_MAGIC) {
+        throw std::runtime_error("Invalid sparse index file: " + file_path);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    uint64_t num_docs = 0;
+    readPOD(in, num_docs);
+    doc_labels.assign(num_docs, 0);
+    in.read(reinterpret_cast<char*>(doc_labels.data()), num_docs * sizeof(uint64_t));
+    deleted.assign(num_docs, false);
+    label_to_doc.clear();
+    for (size_t doc = 0; doc < doc_labels.size(); ++doc) {
+        label_to_doc[doc_labels[doc]] = static_cast<uint32_t>(doc);
+    }
+
+    // 按文档序号重新追加，重建块的上界
+    postings.clear();
+    uint64_t num_terms = 0;
+    readPOD(in, num_terms);
+    std::vector<uint32_t> docs;
+    std::vector<float> values;
+    for (uint64_t t = 0; t < num_terms && in.good(); ++t) {
+        uint32_t term = 0;
+        uint64_t size = 0;
+        readPOD(in, term);
+        readPOD(in, size);
+        docs.resize(size);
+        values.resize(size);
+        in.read(reinterpret_cast<char*>(docs.data()), size * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(values.data()), size * sizeof(float));
+        PostingList& list = postings[term];
+        for (size_t i = 0; i < size; ++i) {
+            list.append(docs[i], values[i]);
+        }
+    }
+    if (!in.good()) {
+        throw std::runtime_error("Truncated sparse index file: " + file_path);
+    }
+    GlobalLogger->info("Sparse index loaded with {} documents and {} terms", doc_labels.size(), postings.size());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "roaring/roaring.h"
+#include <vector>
+#include <string>
+#include <shared_mutex>
+#include <unordered_map>
+#include <cstdint>
+
+// 稀疏向量倒排索引，用于 SPLADE、BM25 权重等学习型稀疏向量和关键词召回。
+// 每个维度一条倒排链，按文档序号递增保存 (文档序号, 权重)，每 64 项为一块并记录块内权重的最大值和最小值，
+// 检索使用 Block-Max WAND 计算 top-k 内积：只有各维度得分上界之和能进入 top-k 的文档才精确计分
+class SparseIndex {
+public:
+    struct SparseVector {
+        std::vector<uint32_t> indices;
+        std::vector<float> values;
+    };
+
+    void insert_vectors(const SparseVector& data, uint64_t label); // 已存在的标签先删除旧向量
+    void remove_vectors(const std::vector<long>& ids);
+    std::pair<std::vector<long>, std::vector<float>> search_vectors(const SparseVector& query, int k, const roaring_bitmap_t* bitmap = nullptr); // 距离为 1 - 内积，按距离由近到远，不足 k 个时用 -1 填充
+    void saveIndex(const std::string& file_path);
+    void loadIndex(const std::string& file_path);
+
+private:
+    static const size_t BLOCK_SIZE = 64;
+
+    struct PostingList {
+        std::vector<uint32_t> docs; // 文档序号，递增
+        std::vector<float> values;
+        std::vector<uint32_t> block_last; // 每块最后一个文档序号
+        std::vector<float> block_max; // 每块权重的最大值和最小值，查询权重为负时使用最小值作为上界
+        std::vector<float> block_min;
+        float max_value = 0;
+        float min_value = 0;
+
+        void append(uint32_t doc, float value);
+    };
+
+    struct Cursor; // 检索时在一条倒排链上移动的游标
+
+    void insertLocked(const SparseVector& data, uint64_t label);
+    void removeLocked(uint64_t label);
+
+    std::unordered_map<uint32_t, PostingList> postings; // 维度到倒排链
+    std::vector<uint64_t> doc_labels; // 文档序号到标签，更新时旧序号标记删除，新向量追加到倒排链末尾
+    std::vector<bool> deleted;
+    std::unordered_map<uint64_t, uint32_t> label_to_doc;
+    std::shared_mutex rw_mutex; // 插入独占，检索共享
+};
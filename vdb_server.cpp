@@ -2,6 +2,9 @@
 #include "index_factory.h"
 #include "vector_database.h"
 #include "logger.h"
+#include "constants.h"
+#include "hnswlib_index.h"
+#include "sharded_hnsw_index.h"
 
 std::map<std::string, std::string> readConfigFile(const std::string& filename) {
     std::ifstream file(filename);
@@ -41,14 +44,108 @@ int main(int argc, char* argv[]) {
     set_log_level(spdlog::level::debug); // 设置日志级别为debug
 
     GlobalLogger->info("Global logger initialized");
+    GlobalLogger->info("Distance kernels use {}", hnswlib::simdLevelName(hnswlib::getSimdLevel())); // 启动时按 CPUID 选择的指令集
 
     // 初始化全局IndexFactory实例
-    int dim = 1; // 向量维度
+    int dim = config["dim"].empty() ? 1 : std::stoi(config["dim"]); // 向量维度，二值向量为位数
     int num_data = 100000; // 数据量
+    IndexFactory::DataType data_type = IndexFactory::DataType::FLOAT32; // 向量存储精度，默认 FLOAT32
+    if (config["data_type"] == DATA_TYPE_FLOAT16) {
+        data_type = IndexFactory::DataType::FLOAT16;
+    } else if (config["data_type"] == DATA_TYPE_BFLOAT16) {
+        data_type = IndexFactory::DataType::BFLOAT16;
+    } else if (config["data_type"] == DATA_TYPE_BINARY) { // FLAT 使用 IndexBinaryFlat，HNSW 使用汉明距离空间，faiss_factory 为二值工厂字符串
+        data_type = IndexFactory::DataType::BINARY;
+    }
     IndexFactory* globalIndexFactory = getGlobalIndexFactory();
-    globalIndexFactory->init(IndexFactory::IndexType::FLAT, dim);
-    globalIndexFactory->init(IndexFactory::IndexType::HNSW, dim, num_data);
+    globalIndexFactory->init(IndexFactory::IndexType::FLAT, dim, 0, IndexFactory::MetricType::L2, data_type);
+    globalIndexFactory->init(IndexFactory::IndexType::HNSW, dim, num_data, IndexFactory::MetricType::L2, data_type);
+    if (config["hnsw_mmap_warmup"] == "willneed") { // HNSW 快照 mmap 加载后的预热方式，默认按需缺页
+        static_cast<HNSWLibIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::HNSW))->setMmapWarmup(hnswlib::MMAP_WARMUP_WILLNEED);
+    } else if (config["hnsw_mmap_warmup"] == "populate") {
+        static_cast<HNSWLibIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::HNSW))->setMmapWarmup(hnswlib::MMAP_WARMUP_POPULATE);
+    }
+    hnswlib::MemoryPolicy memory_policy; // 索引内存的大页和 NUMA 策略
+    if (config["huge_pages"] == "transparent") {
+        memory_policy.huge_pages = hnswlib::HUGE_PAGES_TRANSPARENT;
+    } else if (config["huge_pages"] == "explicit") {
+        memory_policy.huge_pages = hnswlib::HUGE_PAGES_EXPLICIT;
+    }
+    if (config["numa"] == "bind") {
+        memory_policy.numa = hnswlib::NUMA_BIND;
+        memory_policy.numa_node = config["numa_node"].empty() ? 0 : std::stoi(config["numa_node"]);
+    } else if (config["numa"] == "interleave") {
+        memory_policy.numa = hnswlib::NUMA_INTERLEAVE;
+    }
+    if (!memory_policy.isDefault()) {
+        static_cast<HNSWLibIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::HNSW))->setMemoryPolicy(memory_policy);
+        static_cast<FaissIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::FLAT))->setMemoryPolicy(memory_policy);
+    }
+    if (config["hnsw_compact_visited"] == "true") { // 大索引时使用紧凑的 visited 列表
+        static_cast<HNSWLibIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::HNSW))->setCompactVisitedLists(true);
+    }
     globalIndexFactory->init(IndexFactory::IndexType::FILTER); // 初始化 FILTER 类型索引
+    if (!config["faiss_factory"].empty()) { // 配置了 faiss 工厂字符串时初始化 FAISS_FACTORY 类型索引
+        globalIndexFactory->init(IndexFactory::IndexType::FAISS_FACTORY, dim, num_data, IndexFactory::MetricType::L2, data_type, config["faiss_factory"]);
+        if (!config["faiss_train_size"].empty()) { // 缓存的向量数达到 faiss_train_size 后在后台自动训练，未配置时只通过 /admin/train 训练
+            static_cast<FaissIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::FAISS_FACTORY))->setTrainThreshold(std::stoul(config["faiss_train_size"]));
+        }
+        if (!config["faiss_ondisk_path"].empty()) { // IVF 倒排表存放在磁盘文件中
+            static_cast<FaissIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::FAISS_FACTORY))->setOnDiskInvlistsPath(config["faiss_ondisk_path"]);
+        }
+        if (!memory_policy.isDefault()) {
+            static_cast<FaissIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::FAISS_FACTORY))->setMemoryPolicy(memory_policy);
+        }
+    }
+    if (!config["disk_graph_path"].empty()) { // 配置了磁盘文件路径时初始化 DISK_GRAPH 类型索引
+        globalIndexFactory->init(IndexFactory::IndexType::DISK_GRAPH, dim, 0, IndexFactory::MetricType::L2, data_type, config["disk_graph_path"]);
+    }
+    if (!config["hnsw_shards"].empty()) { // 配置了分片数时初始化 SHARDED_HNSW 类型索引
+        globalIndexFactory->init(IndexFactory::IndexType::SHARDED_HNSW, dim, num_data, IndexFactory::MetricType::L2, data_type, config["hnsw_shards"]);
+        if (!memory_policy.isDefault()) {
+            static_cast<ShardedHNSWIndex*>(globalIndexFactory->getIndex(IndexFactory::IndexType::SHARDED_HNSW))->setMemoryPolicy(memory_policy);
+        }
+    }
+    if (config["multi_vector"] == "true") { // 多向量文档索引，multi_vector_max_elements 为所有文档的向量总数上限
+        int max_vectors = config["multi_vector_max_elements"].empty() ? num_data : std::stoi(config["multi_vector_max_elements"]);
+        globalIndexFactory->init(IndexFactory::IndexType::MULTI_VECTOR, dim, max_vectors);
+    }
+    // 具名向量字段，格式为 字段名:索引类型:维度:距离类型，多个字段用逗号分隔，例如 title_emb:HNSW:768:IP,image_emb:FLAT:512:L2,keywords:SPARSE
+    if (!config["vector_fields"].empty()) {
+        std::stringstream fields(config["vector_fields"]);
+        std::string field_spec;
+        while (std::getline(fields, field_spec, ',')) {
+            std::stringstream spec(field_spec);
+            std::string field, type, field_dim, metric;
+            std::getline(spec, field, ':');
+            std::getline(spec, type, ':');
+            std::getline(spec, field_dim, ':');
+            std::getline(spec, metric, ':');
+            IndexFactory::IndexType field_type = IndexFactory::IndexType::UNKNOWN;
+            if (type == INDEX_TYPE_FLAT) {
+                field_type = IndexFactory::IndexType::FLAT;
+            } else if (type == INDEX_TYPE_HNSW) {
+                field_type = IndexFactory::IndexType::HNSW;
+            } else if (type == INDEX_TYPE_MULTI_VECTOR) {
+                field_type = IndexFactory::IndexType::MULTI_VECTOR;
+            } else if (type == INDEX_TYPE_SPARSE) { // 稀疏字段不需要维度
+                field_type = IndexFactory::IndexType::SPARSE;
+                field_dim = field_dim.empty() ? "0" : field_dim;
+            }
+            if (field.empty() || field == REQUEST_VECTORS || field == REQUEST_ID || field_type == IndexFactory::IndexType::UNKNOWN || field_dim.empty()) {
+                GlobalLogger->error("Invalid vector field config: {}", field_spec);
+                throw std::runtime_error("Invalid vector field config: " + field_spec);
+            }
+            IndexFactory::MetricType field_metric = metric == "IP" ? IndexFactory::MetricType::IP : IndexFactory::MetricType::L2;
+            globalIndexFactory->initField(field, field_type, std::stoi(field_dim), num_data, field_metric, data_type);
+            GlobalLogger->info("Vector field {} initialized with {} index, dim = {}", field, type, field_dim);
+        }
+    }
+    // 使用压缩存储时额外保存原始向量，支持请求中的 rerank 参数；二值向量的汉明距离是精确的，不需要重排
+    bool needs_vector_store = data_type != IndexFactory::DataType::FLOAT32 || !config["faiss_factory"].empty() || config["vector_store"] == "true";
+    if (needs_vector_store && data_type != IndexFactory::DataType::BINARY) {
+        globalIndexFactory->init(IndexFactory::IndexType::VECTOR_STORE, dim);
+    }
     GlobalLogger->info("Global IndexFactory initialized");
 
     std::string db_path = config["db_path"];
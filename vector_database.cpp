@@ -4,13 +4,43 @@
 #include "index_factory.h"
 #include "faiss_index.h"
 #include "hnswlib_index.h"
+#include "disk_graph_index.h"
+#include "vector_store.h"
+#include "sharded_hnsw_index.h"
+#include "multi_vector_index.h"
+#include "sparse_index.h"
 #include "filter_index.h" // 包含 filter_index.h 以使用 FilterIndex 类
 #include "logger.h" 
 #include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <future>
+#include <exception>
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h> // 包含 rapidjson/stringbuffer.h 以使用 StringBuffer 类
 #include <rapidjson/writer.h> // 包含 rapidjson/writer.h 以使用 Writer 类
 
+namespace {
+    // 稀疏向量的 JSON 格式为 {"indices": [...], "values": [...]}
+    SparseIndex::SparseVector parseSparseVector(const rapidjson::Value& value) {
+        if (!value.IsObject() || !value.HasMember(REQUEST_INDICES) || !value[REQUEST_INDICES].IsArray() ||
+            !value.HasMember(REQUEST_VALUES) || !value[REQUEST_VALUES].IsArray()) {
+            throw std::invalid_argument("Sparse vector must be an object with indices and values arrays");
+        }
+        SparseIndex::SparseVector sparse;
+        for (const auto& index : value[REQUEST_INDICES].GetArray()) {
+            sparse.indices.push_back(index.GetUint());
+        }
+        for (const auto& v : value[REQUEST_VALUES].GetArray()) {
+            sparse.values.push_back(v.GetFloat());
+        }
+        return sparse;
+    }
+}
+
 VectorDatabase::VectorDatabase(const std::string& db_path, const std::string& wal_path) 
     : scalar_storage_(db_path) {
     persistence_.init(wal_path);
@@ -60,7 +90,7 @@ void VectorDatabase::writeWALLogWithID(uint64_t log_id, const std::string& data)
     persistence_.writeWALRawLog(log_id, operation_type, data, version); // 调用 persistence_ 的 writeWALRawLog 方法
 }
 
-IndexFactory::IndexType VectorDatabase::getIndexTypeFromRequest(const rapidjson::Document& json_request) {
+IndexFactory::IndexType VectorDatabase::getIndexTypeFromRequest(const rapidjson::Value& json_request) {
     // 获取请求参数中的索引类型
     if (json_request.HasMember(REQUEST_INDEX_TYPE) && json_request[REQUEST_INDEX_TYPE].IsString()) {
         std::string index_type_str = json_request[REQUEST_INDEX_TYPE].GetString();
@@ -68,11 +98,38 @@ IndexFactory::IndexType VectorDatabase::getIndexTypeFromRequest(const rapidjson:
             return IndexFactory::IndexType::FLAT;
         } else if (index_type_str == INDEX_TYPE_HNSW) {
             return IndexFactory::IndexType::HNSW;
+        } else if (index_type_str == INDEX_TYPE_FAISS_FACTORY) {
+            return IndexFactory::IndexType::FAISS_FACTORY;
+        } else if (index_type_str == INDEX_TYPE_DISK_GRAPH) {
+            return IndexFactory::IndexType::DISK_GRAPH;
+        } else if (index_type_str == INDEX_TYPE_SHARDED_HNSW) {
+            return IndexFactory::IndexType::SHARDED_HNSW;
+        } else if (index_type_str == INDEX_TYPE_MULTI_VECTOR) {
+            return IndexFactory::IndexType::MULTI_VECTOR;
         }
     }
     return IndexFactory::IndexType::UNKNOWN; // 返回UNKNOWN值
 }
 
+void VectorDatabase::checkUpsert(uint64_t id, IndexFactory::IndexType index_type) {
+    if (index_type != IndexFactory::IndexType::FLAT && index_type != IndexFactory::IndexType::FAISS_FACTORY) {
+        return;
+    }
+    FaissIndex* faiss_index = static_cast<FaissIndex*>(getGlobalIndexFactory()->getIndex(index_type));
+    if (faiss_index == nullptr || faiss_index->supports_remove()) {
+        return;
+    }
+    rapidjson::Document existingData;
+    try {
+        existingData = scalar_storage_.get_scalar(id);
+    } catch (const std::runtime_error& e) {
+        return;
+    }
+    if (existingData.IsObject() && existingData.HasMember(REQUEST_VECTORS)) {
+        throw std::invalid_argument("Index does not support updating the vector of an existing id: " + std::to_string(id));
+    }
+}
+
 void VectorDatabase::upsert(uint64_t id, const rapidjson::Document& data, IndexFactory::IndexType index_type) {
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -88,7 +145,8 @@ void VectorDatabase::upsert(uint64_t id, const rapidjson::Document& data, IndexF
     }
 
     // 如果存在现有向量，则从索引中删除它
-    if (existingData.IsObject()) {
+    bool keep_index = false; // 索引无法删除旧向量时保留旧向量，不再插入新向量
+    if (existingData.IsObject() && existingData.HasMember(REQUEST_VECTORS)) {
         GlobalLogger->debug("try remove old index"); // 添加打印信息
         std::vector<float> existingVector(existingData["vectors"].Size());
         for (rapidjson::SizeType i = 0; i < existingData["vectors"].Size(); ++i) {
@@ -97,8 +155,15 @@ void VectorDatabase::upsert(uint64_t id, const rapidjson::Document& data, IndexF
 
         void* index = getGlobalIndexFactory()->getIndex(index_type);
         switch (index_type) {
-            case IndexFactory::IndexType::FLAT: {
+            case IndexFactory::IndexType::FLAT:
+            case IndexFactory::IndexType::FAISS_FACTORY: {
                 FaissIndex* faiss_index = static_cast<FaissIndex*>(index);
+                // 请求已由 checkUpsert 拒绝；应用日志时不能抛出异常，只记录错误
+                if (!faiss_index->supports_remove()) {
+                    GlobalLogger->error("Index does not support updating the vector of an existing id: {}, keeping the old vector", id);
+                    keep_index = true;
+                    break;
+                }
                 faiss_index->remove_vectors({static_cast<long>(id)});
                 break;
             }
@@ -107,33 +172,73 @@ void VectorDatabase::upsert(uint64_t id, const rapidjson::Document& data, IndexF
                 //hnsw_index->remove_vectors({id});
                 break;
             }
+            case IndexFactory::IndexType::DISK_GRAPH: {
+                DiskGraphIndex* disk_index = static_cast<DiskGraphIndex*>(index);
+                disk_index->remove_vectors({static_cast<long>(id)});
+                break;
+            }
             default:
                 break;
         }
     }
 
-    // 将新向量插入索引
-    std::vector<float> newVector(data["vectors"].Size());
-    for (rapidjson::SizeType i = 0; i < data["vectors"].Size(); ++i) {
-        newVector[i] = data["vectors"][i].GetFloat();
+    // 将新向量插入索引，只有具名向量字段的文档没有 vectors
+    std::vector<float> newVector;
+    if (data.HasMember(REQUEST_VECTORS)) {
+        for (const auto& v : data[REQUEST_VECTORS].GetArray()) {
+            newVector.push_back(v.GetFloat());
+        }
     }
 
     GlobalLogger->debug("try add new index"); // 添加打印信息
 
-    void* index = getGlobalIndexFactory()->getIndex(index_type);
-    switch (index_type) {
-        case IndexFactory::IndexType::FLAT: {
-            FaissIndex* faiss_index = static_cast<FaissIndex*>(index);
-            faiss_index->insert_vectors(newVector, id);
-            break;
+    if (!newVector.empty() && !keep_index) {
+        void* index = getGlobalIndexFactory()->getIndex(index_type);
+        switch (index_type) {
+            case IndexFactory::IndexType::FLAT:
+            case IndexFactory::IndexType::FAISS_FACTORY: {
+                FaissIndex* faiss_index = static_cast<FaissIndex*>(index);
+                faiss_index->insert_vectors(newVector, id);
+                break;
+            }
+            case IndexFactory::IndexType::HNSW: {
+                HNSWLibIndex* hnsw_index = static_cast<HNSWLibIndex*>(index);
+                hnsw_index->insert_vectors(newVector, id);
+                break;
+            }
+            case IndexFactory::IndexType::DISK_GRAPH: {
+                DiskGraphIndex* disk_index = static_cast<DiskGraphIndex*>(index);
+                disk_index->insert_vectors(newVector, id);
+                break;
+            }
+            case IndexFactory::IndexType::SHARDED_HNSW: { // 已存在的标签在原分片中原位更新
+                ShardedHNSWIndex* sharded_index = static_cast<ShardedHNSWIndex*>(index);
+                sharded_index->insert_vectors(newVector, id);
+                break;
+            }
+            case IndexFactory::IndexType::MULTI_VECTOR: { // 文档的所有向量整体替换
+                MultiVectorIndex* multi_vector_index = static_cast<MultiVectorIndex*>(index);
+                multi_vector_index->insert_vectors(newVector, id);
+                break;
+            }
+            default:
+                break;
         }
-        case IndexFactory::IndexType::HNSW: {
-            HNSWLibIndex* hnsw_index = static_cast<HNSWLibIndex*>(index);
-            hnsw_index->insert_vectors(newVector, id);
-            break;
+    }
+
+    // 保存原始向量用于精确重排，多向量文档不参与重排
+    VectorStore* vector_store = static_cast<VectorStore*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::VECTOR_STORE));
+    if (vector_store != nullptr && !newVector.empty() && !keep_index && index_type != IndexFactory::IndexType::MULTI_VECTOR) {
+        vector_store->insert_vectors(newVector, id);
+    }
+
+    // 更新文档中的具名向量字段，每个字段写入自己的索引
+    for (const auto& field_entry : getGlobalIndexFactory()->getFieldIndexes()) {
+        const std::string& field = field_entry.first;
+        if (!data.HasMember(field.c_str())) {
+            continue;
         }
-        default:
-            break;
+        insertField(field_entry.second, data[field.c_str()], id, existingData.IsObject() && existingData.HasMember(field.c_str()));
     }
 
     GlobalLogger->debug("try add new filter"); // 添加打印信息
@@ -167,7 +272,12 @@ rapidjson::Document VectorDatabase::query(uint64_t id) { // 添加query函数实
     return scalar_storage_.get_scalar(id);
 }
 
-std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(const rapidjson::Document& json_request) {
+std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(const rapidjson::Document& json_request, std::vector<hnswlib::SearchTerminationStats>* stats) {
+    // 指定了具名向量字段时检索字段的索引
+    if (json_request.HasMember(REQUEST_FIELD) || json_request.HasMember(REQUEST_FIELDS)) {
+        return searchFields(json_request);
+    }
+
     // 从 JSON 请求中获取查询参数
     std::vector<float> query;
     for (const auto& q : json_request[REQUEST_VECTORS].GetArray()) {
@@ -176,54 +286,476 @@ std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(const ra
     int k = json_request[REQUEST_K].GetInt();
 
     // 获取请求参数中的索引类型
-    IndexFactory::IndexType indexType = IndexFactory::IndexType::UNKNOWN;
-    if (json_request.HasMember(REQUEST_INDEX_TYPE) && json_request[REQUEST_INDEX_TYPE].IsString()) {
-        std::string index_type_str = json_request[REQUEST_INDEX_TYPE].GetString();
-        if (index_type_str == INDEX_TYPE_FLAT) {
-            indexType = IndexFactory::IndexType::FLAT;
-        } else if (index_type_str == INDEX_TYPE_HNSW) {
-            indexType = IndexFactory::IndexType::HNSW;
-        }
+    IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+
+    // 获取可选的 nprobe 参数，仅对 IVF 类索引生效
+    int nprobe = 0;
+    if (json_request.HasMember(REQUEST_NPROBE) && json_request[REQUEST_NPROBE].IsInt()) {
+        nprobe = json_request[REQUEST_NPROBE].GetInt();
     }
 
-    // 检查请求中是否包含 filter 参数
-    roaring_bitmap_t* filter_bitmap = nullptr;
-    if (json_request.HasMember("filter") && json_request["filter"].IsObject()) {
-        const auto& filter = json_request["filter"];
-        std::string fieldName = filter["fieldName"].GetString();
-        std::string op_str = filter["op"].GetString();
-        int64_t value = filter["value"].GetInt64();
+    // 获取可选的 searchList 和 beamWidth 参数，仅对 DISK_GRAPH 索引生效
+    int search_list = 100;
+    if (json_request.HasMember(REQUEST_SEARCH_LIST) && json_request[REQUEST_SEARCH_LIST].IsInt()) {
+        search_list = json_request[REQUEST_SEARCH_LIST].GetInt();
+    }
+    int beam_width = 4;
+    if (json_request.HasMember(REQUEST_BEAM_WIDTH) && json_request[REQUEST_BEAM_WIDTH].IsInt()) {
+        beam_width = json_request[REQUEST_BEAM_WIDTH].GetInt();
+    }
 
-        FilterIndex::Operation op = (op_str == "=") ? FilterIndex::Operation::EQUAL : FilterIndex::Operation::NOT_EQUAL;
+    // 获取可选的 rerank 参数，大于 1 时先多取 k * rerank 个候选，再用原始向量精确重排
+    int rerank = 1;
+    if (json_request.HasMember(REQUEST_RERANK) && json_request[REQUEST_RERANK].IsInt()) {
+        rerank = std::max(1, json_request[REQUEST_RERANK].GetInt());
+    }
+    VectorStore* vector_store = static_cast<VectorStore*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::VECTOR_STORE));
+    if (rerank > 1 && vector_store == nullptr) {
+        GlobalLogger->warn("Vector store is not configured, ignoring rerank parameter");
+        rerank = 1;
+    } else if (rerank > 1 && indexType == IndexFactory::IndexType::MULTI_VECTOR) {
+        GlobalLogger->warn("Multi-vector index does not support rerank, ignoring rerank parameter");
+        rerank = 1;
+    }
+    int fetch_k = k * rerank;
+
+    // 获取可选的 ef 参数，仅对 HNSW 类索引生效；未指定 ef 时可以指定 recallTarget，按校准曲线选择 ef
+    // 曲线只适用于校准时的 k，与实际检索的 fetch_k 不同时使用默认 ef
+    int ef_search = 50;
+    if (json_request.HasMember(REQUEST_EF) && json_request[REQUEST_EF].IsInt()) {
+        ef_search = std::max(1, json_request[REQUEST_EF].GetInt());
+    } else if (json_request.HasMember(REQUEST_RECALL_TARGET) && json_request[REQUEST_RECALL_TARGET].IsNumber()) {
+        float recall_target = json_request[REQUEST_RECALL_TARGET].GetFloat();
+        void* hnsw_index = getGlobalIndexFactory()->getIndex(indexType);
+        int calibrated_ef = -1;
+        if (indexType == IndexFactory::IndexType::HNSW && hnsw_index != nullptr) {
+            calibrated_ef = static_cast<HNSWLibIndex*>(hnsw_index)->efForRecall(recall_target, fetch_k);
+        } else if (indexType == IndexFactory::IndexType::SHARDED_HNSW && hnsw_index != nullptr) {
+            calibrated_ef = static_cast<ShardedHNSWIndex*>(hnsw_index)->efForRecall(recall_target, fetch_k);
+        }
+        if (calibrated_ef > 0) {
+            ef_search = calibrated_ef;
+        } else {
+            GlobalLogger->warn("Index is not calibrated for k = {}, ignoring recallTarget parameter", fetch_k);
+        }
+    }
 
-        // 通过 getGlobalIndexFactory 的 getIndex 方法获取 FilterIndex
-        FilterIndex* filter_index = static_cast<FilterIndex*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::FILTER));
+    // 获取可选的 adaptive 和 maxDistanceComputations 参数，仅对 HNSW 类索引生效
+    // adaptive 使用校准时学习到的耐心值，top-k 连续若干跳不变时提前结束；maxDistanceComputations 限制每个查询的距离计算次数
+    size_t patience = 0;
+    if (json_request.HasMember(REQUEST_ADAPTIVE) && json_request[REQUEST_ADAPTIVE].IsBool() && json_request[REQUEST_ADAPTIVE].GetBool()) {
+        void* hnsw_index = getGlobalIndexFactory()->getIndex(indexType);
+        if (indexType == IndexFactory::IndexType::HNSW && hnsw_index != nullptr) {
+            patience = static_cast<HNSWLibIndex*>(hnsw_index)->patienceForEf(ef_search, fetch_k);
+        } else if (indexType == IndexFactory::IndexType::SHARDED_HNSW && hnsw_index != nullptr) {
+            patience = static_cast<ShardedHNSWIndex*>(hnsw_index)->patienceForEf(ef_search, fetch_k);
+        }
+        if (patience == 0) {
+            GlobalLogger->warn("Index is not calibrated for k = {}, ignoring adaptive parameter", fetch_k);
+        }
+    }
+    size_t max_distance_computations = 0;
+    if (json_request.HasMember(REQUEST_MAX_DISTANCE_COMPUTATIONS) && json_request[REQUEST_MAX_DISTANCE_COMPUTATIONS].IsUint()) {
+        max_distance_computations = json_request[REQUEST_MAX_DISTANCE_COMPUTATIONS].GetUint();
+    }
+    if (patience == 0 && max_distance_computations == 0) {
+        stats = nullptr;
+    }
 
-        // 调用 FilterIndex 的 getIntFieldFilterBitmap 方法
-        filter_bitmap = roaring_bitmap_create();
-        filter_index->getIntFieldFilterBitmap(fieldName, op, value, filter_bitmap);
+    // 获取可选的 filterMode 参数，仅对 HNSW 类索引生效
+    bool filtered_traversal = false;
+    if (json_request.HasMember(REQUEST_FILTER_MODE) && json_request[REQUEST_FILTER_MODE].IsString()) {
+        filtered_traversal = std::string(json_request[REQUEST_FILTER_MODE].GetString()) == "acorn";
     }
 
+    // 检查请求中是否包含 filter 参数
+    roaring_bitmap_t* filter_bitmap = createFilterBitmap(json_request);
+
     // 使用全局 IndexFactory 获取索引对象
     void* index = getGlobalIndexFactory()->getIndex(indexType);
 
     // 根据索引类型初始化索引对象并调用 search_vectors 函数
     std::pair<std::vector<long>, std::vector<float>> results;
     switch (indexType) {
-        case IndexFactory::IndexType::FLAT: {
+        case IndexFactory::IndexType::FLAT:
+        case IndexFactory::IndexType::FAISS_FACTORY: {
             FaissIndex* faissIndex = static_cast<FaissIndex*>(index);
-            results = faissIndex->search_vectors(query, k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            try {
+                results = faissIndex->search_vectors(query, fetch_k, filter_bitmap, nprobe); // 将 filter_bitmap 和 nprobe 传递给 search_vectors 方法
+            } catch (...) { // 索引尚未训练时抛出异常，释放过滤位图后交给调用方返回错误
+                if (filter_bitmap != nullptr) {
+                    delete filter_bitmap;
+                }
+                throw;
+            }
             break;
         }
         case IndexFactory::IndexType::HNSW: {
             HNSWLibIndex* hnswIndex = static_cast<HNSWLibIndex*>(index);
-            results = hnswIndex->search_vectors(query, k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            results = hnswIndex->search_vectors(query, fetch_k, filter_bitmap, ef_search, filtered_traversal, patience, max_distance_computations, stats); // 将 filter_bitmap 传递给 search_vectors 方法
+            break;
+        }
+        case IndexFactory::IndexType::DISK_GRAPH: {
+            DiskGraphIndex* diskIndex = static_cast<DiskGraphIndex*>(index);
+            results = diskIndex->search_vectors(query, fetch_k, filter_bitmap, search_list, beam_width);
+            break;
+        }
+        case IndexFactory::IndexType::SHARDED_HNSW: {
+            ShardedHNSWIndex* shardedIndex = static_cast<ShardedHNSWIndex*>(index);
+            results = shardedIndex->search_vectors(query, fetch_k, filter_bitmap, ef_search, filtered_traversal, patience, max_distance_computations, stats);
+            break;
+        }
+        case IndexFactory::IndexType::MULTI_VECTOR: { // 直接返回 k 个不同文档，不需要多取向量再去重
+            MultiVectorIndex* multiVectorIndex = static_cast<MultiVectorIndex*>(index);
+            if (json_request.HasMember(REQUEST_MAX_SIM) && json_request[REQUEST_MAX_SIM].IsBool() && json_request[REQUEST_MAX_SIM].GetBool()) {
+                // 延迟交互检索，在服务端对候选文档精确计算 MaxSim
+                int candidates = k;
+                if (json_request.HasMember(REQUEST_CANDIDATES) && json_request[REQUEST_CANDIDATES].IsInt()) {
+                    candidates = json_request[REQUEST_CANDIDATES].GetInt();
+                }
+                results = multiVectorIndex->maxsim_search(query, k, filter_bitmap, ef_search, candidates);
+            } else {
+                results = multiVectorIndex->search_vectors(query, k, filter_bitmap, ef_search);
+            }
             break;
         }
         // 在此处添加其他索引类型的处理逻辑
         default:
             break;
     }
+    if (rerank > 1) {
+        // 保持各索引自身的结果顺序：faiss 由近到远，其余由远到近
+        bool farthest_first = indexType != IndexFactory::IndexType::FLAT && indexType != IndexFactory::IndexType::FAISS_FACTORY;
+        try {
+            results = vector_store->rerank(query, results.first, k, farthest_first);
+        } catch (...) {
+            if (filter_bitmap != nullptr) {
+                delete filter_bitmap;
+            }
+            throw;
+        }
+    }
+    if (filter_bitmap != nullptr) {
+        delete filter_bitmap;
+    }
+    return results;
+}
+
+std::pair<std::vector<long>, std::vector<float>> VectorDatabase::rangeSearch(const rapidjson::Document& json_request) {
+    // 从 JSON 请求中获取查询向量和半径
+    std::vector<float> query;
+    for (const auto& q : json_request[REQUEST_VECTORS].GetArray()) {
+        query.push_back(q.GetFloat());
+    }
+    float radius = json_request[REQUEST_RADIUS].GetFloat();
+    IndexFactory::IndexType indexType = getIndexTypeFromRequest(json_request);
+
+    // 获取可选的 maxResults、nprobe 和 ef 参数
+    size_t max_results = 1000;
+    if (json_request.HasMember(REQUEST_MAX_RESULTS) && json_request[REQUEST_MAX_RESULTS].IsUint()) {
+        max_results = json_request[REQUEST_MAX_RESULTS].GetUint();
+    }
+    int nprobe = 0;
+    if (json_request.HasMember(REQUEST_NPROBE) && json_request[REQUEST_NPROBE].IsInt()) {
+        nprobe = json_request[REQUEST_NPROBE].GetInt();
+    }
+    int ef_search = 50;
+    if (json_request.HasMember(REQUEST_EF) && json_request[REQUEST_EF].IsInt()) {
+        ef_search = std::max(1, json_request[REQUEST_EF].GetInt());
+    }
+
+    roaring_bitmap_t* filter_bitmap = createFilterBitmap(json_request);
+    void* index = getGlobalIndexFactory()->getIndex(indexType);
+
+    std::pair<std::vector<long>, std::vector<float>> results;
+    try {
+        switch (indexType) {
+            case IndexFactory::IndexType::FLAT:
+            case IndexFactory::IndexType::FAISS_FACTORY: {
+                results = static_cast<FaissIndex*>(index)->range_search(query, radius, filter_bitmap, max_results, nprobe);
+                break;
+            }
+            case IndexFactory::IndexType::HNSW: {
+                results = static_cast<HNSWLibIndex*>(index)->range_search(query, radius, filter_bitmap, max_results, ef_search);
+                break;
+            }
+            case IndexFactory::IndexType::SHARDED_HNSW: {
+                results = static_cast<ShardedHNSWIndex*>(index)->range_search(query, radius, filter_bitmap, max_results, ef_search);
+                break;
+            }
+            default:
+                throw std::runtime_error("Range search is not supported for this index type");
+        }
+    } catch (...) {
+        if (filter_bitmap != nullptr) {
+            delete filter_bitmap;
+        }
+        throw;
+    }
+    if (filter_bitmap != nullptr) {
+        delete filter_bitmap;
+    }
+    return results;
+}
+
+roaring_bitmap_t* VectorDatabase::createFilterBitmap(const rapidjson::Document& json_request) {
+    if (!json_request.HasMember("filter") || !json_request["filter"].IsObject()) {
+        return nullptr;
+    }
+    const auto& filter = json_request["filter"];
+    std::string fieldName = filter["fieldName"].GetString();
+    std::string op_str = filter["op"].GetString();
+    int64_t value = filter["value"].GetInt64();
+
+    FilterIndex::Operation op = (op_str == "=") ? FilterIndex::Operation::EQUAL : FilterIndex::Operation::NOT_EQUAL;
+
+    // 通过 getGlobalIndexFactory 的 getIndex 方法获取 FilterIndex
+    FilterIndex* filter_index = static_cast<FilterIndex*>(getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::FILTER));
+
+    // 调用 FilterIndex 的 getIntFieldFilterBitmap 方法
+    roaring_bitmap_t* filter_bitmap = roaring_bitmap_create();
+    filter_index->getIntFieldFilterBitmap(fieldName, op, value, filter_bitmap);
+    return filter_bitmap;
+}
+
+void VectorDatabase::insertField(const IndexFactory::FieldIndex& field_index, const rapidjson::Value& vectors, uint64_t id, bool exists) {
+    if (field_index.type == IndexFactory::IndexType::SPARSE) { // 已存在的标签在 insert_vectors 中先删除
+        static_cast<SparseIndex*>(field_index.index)->insert_vectors(parseSparseVector(vectors), id);
+        return;
+    }
+    if (!vectors.IsArray()) {
+        throw std::invalid_argument("Dense vector field value must be an array");
+    }
+    std::vector<float> data;
+    for (const auto& v : vectors.GetArray()) {
+        data.push_back(v.GetFloat());
+    }
+
+    switch (field_index.type) {
+        case IndexFactory::IndexType::FLAT: {
+            FaissIndex* faiss_index = static_cast<FaissIndex*>(field_index.index);
+            if (exists) {
+                faiss_index->remove_vectors({static_cast<long>(id)});
+            }
+            faiss_index->insert_vectors(data, id);
+            break;
+        }
+        case IndexFactory::IndexType::HNSW: // 已存在的标签原位更新
+            static_cast<HNSWLibIndex*>(field_index.index)->insert_vectors(data, id);
+            break;
+        case IndexFactory::IndexType::MULTI_VECTOR: // 文档的所有向量整体替换
+            static_cast<MultiVectorIndex*>(field_index.index)->insert_vectors(data, id);
+            break;
+        default:
+            break;
+    }
+}
+
+std::pair<std::vector<long>, std::vector<float>> VectorDatabase::searchField(const IndexFactory::FieldIndex& field_index, const rapidjson::Value& vectors, int k, const roaring_bitmap_t* bitmap, int ef_search, int nprobe) {
+    if (field_index.type == IndexFactory::IndexType::SPARSE) {
+        return static_cast<SparseIndex*>(field_index.index)->search_vectors(parseSparseVector(vectors), k, bitmap);
+    }
+    if (!vectors.IsArray()) {
+        throw std::invalid_argument("Dense vector field query must be an array");
+    }
+    std::vector<float> query;
+    for (const auto& v : vectors.GetArray()) {
+        query.push_back(v.GetFloat());
+    }
+    if (field_index.dim > 0 && query.size() != static_cast<size_t>(field_index.dim)) {
+        throw std::invalid_argument("Query dimension does not match the vector field");
+    }
+    switch (field_index.type) {
+        case IndexFactory::IndexType::FLAT:
+        case IndexFactory::IndexType::FAISS_FACTORY: {
+            FaissIndex* faiss_index = static_cast<FaissIndex*>(field_index.index);
+            auto results = faiss_index->search_vectors(query, k, bitmap, nprobe);
+            // faiss 内积索引返回相似度，越大越近；转换为与 HNSW 内积索引一致的 1 - 内积，融合时各检索器都是越小越近
+            if (field_index.metric == IndexFactory::MetricType::IP && !faiss_index->is_binary()) {
+                for (size_t i = 0; i < results.first.size(); ++i) {
+                    if (results.first[i] != -1) {
+                        results.second[i] = 1.0f - results.second[i];
+                    }
+                }
+            }
+            return results;
+        }
+        case IndexFactory::IndexType::HNSW:
+            return static_cast<HNSWLibIndex*>(field_index.index)->search_vectors(query, k, bitmap, ef_search);
+        case IndexFactory::IndexType::SHARDED_HNSW:
+            return static_cast<ShardedHNSWIndex*>(field_index.index)->search_vectors(query, k, bitmap, ef_search);
+        case IndexFactory::IndexType::DISK_GRAPH:
+            return static_cast<DiskGraphIndex*>(field_index.index)->search_vectors(query, k, bitmap);
+        case IndexFactory::IndexType::MULTI_VECTOR:
+            return static_cast<MultiVectorIndex*>(field_index.index)->search_vectors(query, k, bitmap, ef_search);
+        default:
+            return {};
+    }
+}
+
+std::pair<std::vector<long>, std::vector<float>> VectorDatabase::searchFields(const rapidjson::Document& json_request) {
+    struct FieldQuery {
+        IndexFactory::FieldIndex field_index;
+        const rapidjson::Value* vectors;
+        float weight;
+        int nprobe;
+    };
+
+    // 单个字段为 field + vectors，多个检索器为 fields: {名称: {vectors, weight, indexType, nprobe}}，
+    // 名称为已配置的具名向量字段，或者用 indexType 指定检索 vectors 所在的某个索引
+    // 检索器未指定 nprobe 时使用请求的 nprobe，都未指定时使用 IVF 索引自身的 nprobe
+    int request_nprobe = 0;
+    if (json_request.HasMember(REQUEST_NPROBE) && json_request[REQUEST_NPROBE].IsInt()) {
+        request_nprobe = json_request[REQUEST_NPROBE].GetInt();
+    }
+    std::vector<FieldQuery> field_queries;
+    auto addFieldQuery = [&](const std::string& name, const rapidjson::Value& entry, const rapidjson::Value& vectors, float weight) {
+        int nprobe = request_nprobe;
+        if (entry.IsObject() && entry.HasMember(REQUEST_NPROBE) && entry[REQUEST_NPROBE].IsInt()) {
+            nprobe = entry[REQUEST_NPROBE].GetInt();
+        }
+        const IndexFactory::FieldIndex* field_index = getGlobalIndexFactory()->getFieldIndex(name);
+        if (field_index != nullptr) {
+            field_queries.push_back({*field_index, &vectors, weight, nprobe});
+            return;
+        }
+        if (entry.IsObject() && entry.HasMember(REQUEST_INDEX_TYPE)) {
+            if (entry[REQUEST_INDEX_TYPE].IsString() && std::string(entry[REQUEST_INDEX_TYPE].GetString()) == INDEX_TYPE_SPARSE) {
+                throw std::invalid_argument("Sparse vectors can only be searched through a named vector field: " + name);
+            }
+            // 使用索引初始化时的维度和距离类型，检查查询维度并转换内积得分
+            const IndexFactory::FieldIndex* index_info = getGlobalIndexFactory()->getIndexInfo(getIndexTypeFromRequest(entry));
+            if (index_info != nullptr) {
+                field_queries.push_back({*index_info, &vectors, weight, nprobe});
+                return;
+            }
+        }
+        throw std::invalid_argument("Unknown vector field: " + name);
+    };
+    if (json_request.HasMember(REQUEST_FIELDS) && json_request[REQUEST_FIELDS].IsObject()) {
+        const auto& fields = json_request[REQUEST_FIELDS];
+        for (auto it = fields.MemberBegin(); it != fields.MemberEnd(); ++it) {
+            if (!it->value.IsObject() || !it->value.HasMember(REQUEST_VECTORS)) {
+                throw std::invalid_argument(std::string("Missing vectors for vector field: ") + it->name.GetString());
+            }
+            float weight = 1.0f;
+            if (it->value.HasMember(REQUEST_WEIGHT) && it->value[REQUEST_WEIGHT].IsNumber()) {
+                weight = it->value[REQUEST_WEIGHT].GetFloat();
+            }
+            addFieldQuery(it->name.GetString(), it->value, it->value[REQUEST_VECTORS], weight);
+        }
+    } else if (json_request.HasMember(REQUEST_FIELD) && json_request[REQUEST_FIELD].IsString() && json_request.HasMember(REQUEST_VECTORS)) {
+        addFieldQuery(json_request[REQUEST_FIELD].GetString(), json_request, json_request[REQUEST_VECTORS], 1.0f);
+    }
+    if (field_queries.empty()) {
+        throw std::invalid_argument("No vector field to search");
+    }
+
+    int k = json_request[REQUEST_K].GetInt();
+    int ef_search = 50;
+    if (json_request.HasMember(REQUEST_EF) && json_request[REQUEST_EF].IsInt()) {
+        ef_search = std::max(1, json_request[REQUEST_EF].GetInt());
+    }
+    int candidates = k * 4; // 每个检索器多取一些候选，减少只在部分检索器中排名靠前的文档被漏掉
+    if (json_request.HasMember(REQUEST_CANDIDATES) && json_request[REQUEST_CANDIDATES].IsInt()) {
+        candidates = std::max(k, json_request[REQUEST_CANDIDATES].GetInt());
+    }
+    // 融合方式：weighted 为归一化距离的加权平均，rrf 为倒数排名融合
+    bool rrf = json_request.HasMember(REQUEST_FUSION) && json_request[REQUEST_FUSION].IsString() && std::string(json_request[REQUEST_FUSION].GetString()) == FUSION_RRF;
+    float rrf_k = 60;
+    if (json_request.HasMember(REQUEST_RRF_K) && json_request[REQUEST_RRF_K].IsNumber()) {
+        rrf_k = std::max(0.0f, json_request[REQUEST_RRF_K].GetFloat());
+    }
+
+    roaring_bitmap_t* filter_bitmap = createFilterBitmap(json_request);
+    std::pair<std::vector<long>, std::vector<float>> results;
+    try {
+        if (field_queries.size() == 1) {
+            results = searchField(field_queries[0].field_index, *field_queries[0].vectors, k, filter_bitmap, ef_search, field_queries[0].nprobe);
+        } else {
+            // 各检索器并行检索，调用线程检索第一个，其余交给异步任务
+            std::vector<std::future<std::pair<std::vector<long>, std::vector<float>>>> futures;
+            for (size_t f = 1; f < field_queries.size(); ++f) {
+                futures.push_back(std::async(std::launch::async, [&, f]() {
+                    return searchField(field_queries[f].field_index, *field_queries[f].vectors, candidates, filter_bitmap, ef_search, field_queries[f].nprobe);
+                }));
+            }
+            std::vector<std::pair<std::vector<long>, std::vector<float>>> field_results(field_queries.size());
+            std::exception_ptr error;
+            try {
+                field_results[0] = searchField(field_queries[0].field_index, *field_queries[0].vectors, candidates, filter_bitmap, ef_search, field_queries[0].nprobe);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            for (size_t f = 1; f < field_queries.size(); ++f) { // 等待所有任务结束后再释放位图
+                try {
+                    field_results[f] = futures[f - 1].get();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            // 每个检索器的候选按距离由近到远排列，得到排名
+            std::vector<std::vector<std::pair<float, long>>> ranked_fields(field_queries.size());
+            for (size_t f = 0; f < field_queries.size(); ++f) {
+                for (size_t i = 0; i < field_results[f].first.size(); ++i) {
+                    if (field_results[f].first[i] != -1) {
+                        ranked_fields[f].emplace_back(field_results[f].second[i], field_results[f].first[i]);
+                    }
+                }
+                std::sort(ranked_fields[f].begin(), ranked_fields[f].end());
+            }
+
+            std::unordered_set<long> docs; // 所有检索器候选的并集
+            std::vector<std::unordered_map<long, float>> field_scores(field_queries.size());
+            for (size_t f = 0; f < field_queries.size(); ++f) {
+                const auto& ranked = ranked_fields[f];
+                for (size_t i = 0; i < ranked.size(); ++i) {
+                    if (rrf) { // 排名从 1 开始
+                        field_scores[f][ranked[i].second] = 1.0f / (rrf_k + i + 1);
+                    } else {
+                        // 各检索器的距离含义和范围不同，在候选内归一化到 [0, 1]，0 为该检索器最近的候选
+                        float range = ranked.back().first - ranked.front().first;
+                        field_scores[f][ranked[i].second] = range > 0 ? (ranked[i].first - ranked.front().first) / range : 0;
+                    }
+                    docs.insert(ranked[i].second);
+                }
+            }
+
+            float total_weight = 0;
+            for (const auto& field_query : field_queries) {
+                total_weight += field_query.weight;
+            }
+            std::vector<std::pair<float, long>> ranked;
+            for (long doc : docs) {
+                float distance = 0;
+                for (size_t f = 0; f < field_queries.size(); ++f) {
+                    auto it = field_scores[f].find(doc);
+                    if (rrf) { // RRF 得分取负作为距离，文档不在某个检索器的候选中时该检索器不贡献得分
+                        distance -= it == field_scores[f].end() ? 0 : field_queries[f].weight * it->second;
+                    } else { // 文档不在某个检索器的候选中时按最远距离 1 计算
+                        distance += field_queries[f].weight * (it == field_scores[f].end() ? 1.0f : it->second);
+                    }
+                }
+                ranked.emplace_back(!rrf && total_weight > 0 ? distance / total_weight : distance, doc);
+            }
+            // 融合结果按距离由近到远
+            size_t num = std::min(ranked.size(), static_cast<size_t>(std::max(k, 0)));
+            std::partial_sort(ranked.begin(), ranked.begin() + num, ranked.end());
+            for (size_t i = 0; i < num; ++i) {
+                results.first.push_back(ranked[i].second);
+                results.second.push_back(ranked[i].first);
+            }
+        }
+    } catch (...) {
+        if (filter_bitmap != nullptr) {
+            delete filter_bitmap;
+        }
+        throw;
+    }
     if (filter_bitmap != nullptr) {
         delete filter_bitmap;
     }
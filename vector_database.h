@@ -3,6 +3,8 @@
 #include "scalar_storage.h"
 #include "index_factory.h"
 #include "persistence.h" // 包含 persistence.h 以使用 Persistence 类
+#include "hnswlib/hnswlib.h"
+#include "roaring/roaring.h"
 #include <string>
 #include <vector>
 #include <rapidjson/document.h>
@@ -14,16 +16,24 @@ public:
 
     // 插入或更新向量
     void upsert(uint64_t id, const rapidjson::Document& data, IndexFactory::IndexType index_type);
+    void checkUpsert(uint64_t id, IndexFactory::IndexType index_type); // 追加 Raft 日志前检查，索引无法更新已存在的 ID 时抛出 std::invalid_argument
     rapidjson::Document query(uint64_t id); // 添加query接口
-    std::pair<std::vector<long>, std::vector<float>> search(const rapidjson::Document& json_request); // 添加 search 方法声明
+    std::pair<std::vector<long>, std::vector<float>> search(const rapidjson::Document& json_request, std::vector<hnswlib::SearchTerminationStats>* stats = nullptr); // stats 非空且请求启用了提前终止时记录每个查询的终止统计
+    std::pair<std::vector<long>, std::vector<float>> rangeSearch(const rapidjson::Document& json_request); // 返回与查询向量距离在 radius 内的所有向量，不支持的索引类型抛出异常
     void reloadDatabase(); // 添加 reloadDatabase 方法声明
     void writeWALLog(const std::string& operation_type, const rapidjson::Document& json_data); // 添加 writeWALLog 方法声明
     void writeWALLogWithID(uint64_t log_id, const std::string& data); // 添加 writeWALLogWithID 函数声明
     void takeSnapshot(); // 添加 takeSnapshot 方法声明
-    IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Document& json_request); // 将 getIndexTypeFromRequest 方法设为 public
+    IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Value& json_request); // 将 getIndexTypeFromRequest 方法设为 public，也用于解析多检索器请求中每个检索器的 indexType
     int64_t getStartIndexID() const; // 添加 getStartIndexID 函数声明
 
 private:
+    roaring_bitmap_t* createFilterBitmap(const rapidjson::Document& json_request); // 按请求中的 filter 参数生成位图，没有 filter 时返回 nullptr
+    // 写入具名向量字段的索引，exists 表示文档原来已有该字段；稠密字段的值为数组，SPARSE 字段的值为 {indices, values}
+    void insertField(const IndexFactory::FieldIndex& field_index, const rapidjson::Value& vectors, uint64_t id, bool exists);
+    std::pair<std::vector<long>, std::vector<float>> searchField(const IndexFactory::FieldIndex& field_index, const rapidjson::Value& vectors, int k, const roaring_bitmap_t* bitmap, int ef_search, int nprobe = 0); // 检索一个字段或索引，距离都是越小越近，内积为 1 - 内积；nprobe 仅对 IVF 类索引生效
+    std::pair<std::vector<long>, std::vector<float>> searchFields(const rapidjson::Document& json_request); // 检索一个具名向量字段，或并行检索多个字段和索引后按归一化距离加权或倒数排名融合
+
     ScalarStorage scalar_storage_;
     Persistence persistence_; // 添加 Persistence 对象
 };
\ No newline at end of file
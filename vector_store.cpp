@@ -0,0 +1,120 @@
+#include "vector_store.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+VectorStore::VectorStore(int dim, IndexFactory::MetricType metric) : dim(dim) {
+    if (metric == IndexFactory::MetricType::L2) {
+        space = new hnswlib::L2Space(dim);
+    } else {
+        space = new hnswlib::InnerProductSpace(dim);
+    }
+}
+
+VectorStore::~VectorStore() {
+    delete space;
+}
+
+void VectorStore::insert_vectors(const std::vector<float>& data, uint64_t label) {
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    auto it = label_to_slot.find(label);
+    if (it != label_to_slot.end()) {
+        std::copy(data.begin(), data.end(), vectors.begin() + it->second * dim);
+        return;
+    }
+    label_to_slot[label] = labels.size();
+    labels.push_back(label);
+    vectors.insert(vectors.end(), data.begin(), data.end());
+}
+
+bool VectorStore::get_vector(uint64_t label, std::vector<float>& data) const {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    auto it = label_to_slot.find(label);
+    if (it == label_to_slot.end()) {
+        return false;
+    }
+    data.assign(vectors.begin() + it->second * dim, vectors.begin() + (it->second + 1) * dim);
+    return true;
+}
+
+std::pair<std::vector<long>, std::vector<float>> VectorStore::rerank(const std::vector<float>& query, const std::vector<long>& candidates, int k, bool farthest_first) const {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    hnswlib::DISTFUNC<float> dist_func = space->get_dist_func();
+    void* dist_func_param = space->get_dist_func_param();
+
+    size_t num_queries = query.size() / dim;
+    if (num_queries == 0 || candidates.size() % num_queries != 0) {
+        throw std::invalid_argument("Rerank candidates do not match the number of queries");
+    }
+    size_t stride = candidates.size() / num_queries;
+
+    std::vector<long> indices;
+    std::vector<float> distances;
+    for (size_t q = 0; q < num_queries; ++q) {
+        const float* q_vec = query.data() + q * dim;
+        std::vector<std::pair<float, long>> scored;
+        scored.reserve(stride);
+        for (size_t i = q * stride; i < (q + 1) * stride; ++i) {
+            long id = candidates[i];
+            if (id == -1) {
+                continue;
+            }
+            auto it = label_to_slot.find(static_cast<uint64_t>(id));
+            if (it == label_to_slot.end()) {
+                GlobalLogger->warn("Vector {} not found in vector store, skipping rerank", id);
+                continue;
+            }
+            scored.emplace_back(dist_func(q_vec, vectors.data() + it->second * dim, dist_func_param), id);
+        }
+
+        // 候选可能重复（例如多次 upsert），去重后保留前 k 个
+        std::sort(scored.begin(), scored.end());
+        scored.erase(std::unique(scored.begin(), scored.end()), scored.end());
+        scored.resize(std::min(scored.size(), static_cast<size_t>(k)));
+        if (farthest_first) {
+            std::reverse(scored.begin(), scored.end());
+        }
+        for (const auto& item : scored) {
+            indices.push_back(item.second);
+            distances.push_back(item.first);
+        }
+        if (num_queries > 1) { // 与批量检索一致，每个查询占 k 个位置
+            indices.resize((q + 1) * k, -1);
+            distances.resize((q + 1) * k, 0);
+        }
+    }
+    return {indices, distances};
+}
+
+void VectorStore::saveIndex(const std::string& file_path) {
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    std::ofstream out(file_path, std::ios::binary);
+    if (!out) {
+        GlobalLogger->error("Failed to open file for writing: {}", file_path);
+        return;
+    }
+    uint64_t n = labels.size();
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char*>(labels.data()), n * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(vectors.data()), vectors.size() * sizeof(float));
+}
+
+void VectorStore::loadIndex(const std::string& file_path) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in.good()) {
+        GlobalLogger->warn("File not found: {}. Skipping loading index.", file_path);
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    uint64_t n = 0;
+    in.read(reinterpret_cast<char*>(&n), sizeof(n));
+    labels.resize(n);
+    vectors.resize(n * dim);
+    in.read(reinterpret_cast<char*>(labels.data()), n * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(vectors.data()), vectors.size() * sizeof(float));
+    label_to_slot.clear();
+    for (size_t i = 0; i < n; ++i) {
+        label_to_slot[labels[i]] = i;
+    }
+}
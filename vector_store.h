@@ -0,0 +1,31 @@
+#pragma once
+
+#include "hnswlib/hnswlib.h"
+#include "index_factory.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+
+// 连续存放的 float32 原始向量，用于压缩索引检索后的精确重排
+class VectorStore {
+public:
+    VectorStore(int dim, IndexFactory::MetricType metric);
+    ~VectorStore();
+
+    void insert_vectors(const std::vector<float>& data, uint64_t label); // 已存在的标签原位覆盖
+    bool get_vector(uint64_t label, std::vector<float>& data) const;
+    // 使用精确距离对候选重排，每个查询返回距离最近的 k 个结果，顺序与检索索引一致（farthest_first 为 true 时由远到近）
+    // 多个查询时 candidates 按查询等长分段，结果每个查询占 k 个位置，不足时以 -1 补齐
+    std::pair<std::vector<long>, std::vector<float>> rerank(const std::vector<float>& query, const std::vector<long>& candidates, int k, bool farthest_first) const;
+    void saveIndex(const std::string& file_path);
+    void loadIndex(const std::string& file_path);
+
+private:
+    int dim;
+    hnswlib::SpaceInterface<float>* space;
+    std::vector<float> vectors; // 第 i 个槽位的向量位于 vectors[i * dim]
+    std::vector<uint64_t> labels; // 槽位 -> 标签
+    std::unordered_map<uint64_t, size_t> label_to_slot;
+    mutable std::shared_mutex rw_mutex;
+};